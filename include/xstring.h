@@ -19,6 +19,7 @@ extern string_t *string_clear(string_t *s);
 extern void string_free(string_t *s);
 extern string_t *string_append(string_t *dst, char *s);
 extern string_t *string_append_char(string_t *dst, char c);
+extern string_t *string_append_len(string_t *dst, const char *s, int slen);
 extern string_t *string_append_str(string_t *dst, string_t *s);
 extern string_t *string_dup(string_t *dst);
 
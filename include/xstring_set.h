@@ -5,24 +5,44 @@
 #include <string.h>
 #include "xstring.h"
 
-#define STRING_SET_HASHSIZE   (101)
+#define STRING_SET_INITSIZE   (256)     // must be a power of 2.
+#define STRING_SET_LOADFACTOR (70)      // percent of entries to grow a table.
+#define STRING_SET_BLOCKSIZE  (64 * 1024)
 
-typedef struct string_set_node_t_ {
-    struct string_set_node_t_ *left;
-    struct string_set_node_t_ *right;
-    struct string_set_node_t_ *parent;
-    string_t *key;
-} string_set_node_t;
+/* FNV-1a, which can be also calculated incrementally by a caller like a lexer. */
+#define STRING_SET_HASH_INIT    (2166136261u)
+#define STRING_SET_HASH_STEP(h, c) (((h) ^ (unsigned char)(c)) * 16777619u)
+
+/*
+    Interned strings in an open addressing hash table with linear probing.
+    A returned string_t is stable until string_set_free_all(), so that
+    interned strings can be compared by a pointer.
+    The string_t and its characters are allocated together from blocks owned by the set,
+    so an interned string must not be modified nor freed by string_free().
+*/
+typedef struct string_set_block_t_ {
+    struct string_set_block_t_ *next;
+    size_t used;
+    size_t size;
+} string_set_block_t;
+
+typedef struct string_set_entry_t_ {
+    unsigned hash;
+    string_t *key;                      // NULL means an empty entry.
+} string_set_entry_t;
 
 typedef struct string_set_t_ {
-    string_set_node_t *hashtable[STRING_SET_HASHSIZE];
+    string_set_block_t *block;          // current block, older blocks are linked from it.
+    string_set_entry_t *table;
+    int size;                           // number of entries, a power of 2.
     int count;
 } string_set_t;
 
-extern void string_set_dump(int indent, string_set_node_t *p);
-extern void string_set_free_node(string_set_node_t *p);
+extern void string_set_dump(string_set_t *sset);
 extern void string_set_free_all(string_set_t *sset);
 extern string_t *string_set_search(string_set_t *sset, string_t *s);
 extern string_t *string_set_insert(string_set_t *sset, string_t *s);
+extern string_t *string_set_insert_len(string_set_t *sset, const char *p, int len);
+extern string_t *string_set_insert_hash(string_set_t *sset, const char *p, int len, unsigned hash);
 
 #endif /* KISS_STRING_SET_H */
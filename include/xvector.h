@@ -0,0 +1,28 @@
+#ifndef KISS_VECTOR_H
+#define KISS_VECTOR_H
+
+#include <stdlib.h>
+
+#define VECTOR_UNIT (8)
+
+typedef struct vectoritem_ {
+    void *item;
+    void (*free)(void *item);
+} vectoritem_t;
+
+typedef struct vector_ {
+    vectoritem_t *items;
+    int count;
+    int cap;
+} vector_t;
+
+extern vector_t *vector_new(void);
+extern void vector_free(vector_t *vec);
+/* returns NULL without adding the item when the items cannot grow. */
+extern vector_t *vector_push(vector_t *vec, void *item, void (*free)(void *item));
+extern vector_t *vector_pop(vector_t *vec);
+extern vector_t *vector_clear(vector_t *vec);
+
+#define vector_get(vec, index) ((vec)->items[index].item)
+
+#endif /* KISS_VECTOR_H */
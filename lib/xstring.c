@@ -78,6 +78,22 @@ string_t *string_append_char(string_t *dst, char c)
     return dst;
 }
 
+string_t *string_append_len(string_t *dst, const char *s, int slen)
+{
+    int len = dst->len + slen;
+    if (dst->cap <= len) {
+        int cap = (((len * 2) / STRING_UNIT) + 1) * STRING_UNIT;
+        char *np = (char *)realloc(dst->p, cap);
+        // np == NULL then error?
+        dst->p = np;
+        dst->cap = cap;
+    }
+    memcpy(dst->p + dst->len, s, slen);
+    dst->p[len] = 0;
+    dst->len = len;
+    return dst;
+}
+
 string_t *string_append_str(string_t *dst, string_t *s)
 {
     int len = dst->len + s->len;
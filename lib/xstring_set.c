@@ -1,106 +1,148 @@
 #include "xstring_set.h"
-#include <limits.h>
+#include <stdio.h>
 
-static int string_set_hash(char *s)
+static unsigned string_set_hash(const char *s, int len)
 {
-    unsigned v;
-    for (v = 0; *s != '\0'; s++) {
-        v = ((v << CHAR_BIT) + *s) % STRING_SET_HASHSIZE;
+    unsigned v = STRING_SET_HASH_INIT;
+    for (int i = 0; i < len; i++) {
+        v = STRING_SET_HASH_STEP(v, s[i]);
     }
-    return (int)v;
+    return v;
 }
 
-void string_set_dump(int indent, string_set_node_t *p)
+void string_set_dump(string_set_t *sset)
 {
-    if (!p) return;
-    for (int i = 0; i < indent; ++i) printf("  ");
-    printf("%s\n", p->key->p);
-    string_set_dump(indent + 1, p->left);
-    string_set_dump(indent + 1, p->right);
+    for (int i = 0; i < sset->size; i++) {
+        string_set_entry_t *e = &(sset->table[i]);
+        if (e->key) {
+            printf("[%5d] %08x: %s\n", i, e->hash, e->key->p);
+        }
+    }
 }
 
-void string_set_free_node(string_set_node_t *p)
+void string_set_free_all(string_set_t *sset)
 {
-    if (!p) return;
-    string_set_free_node(p->left);
-    string_set_free_node(p->right);
-    free(p->key);
-    free(p);
+    string_set_block_t *b = sset->block;
+    while (b) {
+        string_set_block_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    sset->block = NULL;
+    free(sset->table);
+    sset->table = NULL;
+    sset->size = 0;
+    sset->count = 0;
 }
 
-void string_set_free_all(string_set_t *sset)
+static string_t *string_set_new_key(string_set_t *sset, const char *s, int len)
 {
-    for (int i = 0; i < STRING_SET_HASHSIZE; i++) {
-        if (sset->hashtable[i]) {
-            string_set_free_node(sset->hashtable[i]);
+    size_t size = (sizeof(string_t) + len + 1 + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+    string_set_block_t *b = sset->block;
+    if (!b || b->size < b->used + size) {
+        size_t bsize = size < STRING_SET_BLOCKSIZE ? STRING_SET_BLOCKSIZE : size;
+        string_set_block_t *nb = (string_set_block_t *)malloc(sizeof(string_set_block_t) + bsize);
+        if (!nb) {
+            exit(1);
+        }
+        nb->used = 0;
+        nb->size = bsize;
+        if (b && b->size - b->used > bsize - size) {
+            /* keep the current block since it has more free space. */
+            nb->next = b->next;
+            b->next = nb;
+        } else {
+            nb->next = b;
+            sset->block = nb;
         }
+        b = nb;
     }
+    string_t *key = (string_t *)((char *)(b + 1) + b->used);
+    b->used += size;
+    key->p = (char *)(key + 1);
+    memcpy(key->p, s, len);
+    key->p[len] = 0;
+    key->len = len;
+    key->cap = 0;
+    return key;
 }
 
-static char *string_set_search_str(string_set_t *sset, char *s)
+static void string_set_grow(string_set_t *sset)
 {
-    int cmp;
-    string_set_node_t **p;
-    string_set_node_t *q;
-
-    p = &(sset->hashtable[string_set_hash(s)]);
-    while (*p && (*p)->key && (cmp = strcmp(s, (*p)->key->p)) != 0) {
-        if (cmp < 0) {
-            p = &((*p)->left);
-        } else {
-            p = &((*p)->right);
-        }
+    int size = sset->size ? sset->size * 2 : STRING_SET_INITSIZE;
+    string_set_entry_t *table = (string_set_entry_t *)calloc(size, sizeof(string_set_entry_t));
+    if (!table) {
+        exit(1);
     }
-    if (*p) {
-        return (*p)->key->p;
+    unsigned mask = (unsigned)size - 1;
+    for (int i = 0; i < sset->size; i++) {
+        string_set_entry_t *e = &(sset->table[i]);
+        if (e->key) {
+            unsigned j = e->hash & mask;
+            while (table[j].key) {
+                j = (j + 1) & mask;
+            }
+            table[j] = *e;
+        }
     }
-    return NULL;
+    free(sset->table);
+    sset->table = table;
+    sset->size = size;
 }
 
-static string_t *string_set_search_impl(string_set_t *sset, string_t *s, int insert)
+static string_t *string_set_search_impl(string_set_t *sset, const char *s, int len, unsigned hash, int insert)
 {
-    int cmp;
-    string_set_node_t **p;
-    string_set_node_t *q;
-
-    p = &(sset->hashtable[string_set_hash(s->p)]);
-    while (*p && (cmp = strcmp(s->p, (*p)->key->p)) != 0) {
-        if (cmp < 0) {
-            p = &((*p)->left);
-        } else {
-            p = &((*p)->right);
+    if (sset->size == 0) {
+        if (!insert) {
+            return NULL;
         }
+        string_set_grow(sset);
     }
-    if (*p) {
-        return (*p)->key;
+
+    unsigned mask = (unsigned)sset->size - 1;
+    unsigned i = hash & mask;
+    string_set_entry_t *e;
+    while ((e = &(sset->table[i]))->key) {
+        if (e->hash == hash && e->key->len == len && !memcmp(e->key->p, s, len)) {
+            return e->key;
+        }
+        i = (i + 1) & mask;
     }
     if (!insert) {
         return NULL;
     }
 
-    sset->count++;
-    if ((q = malloc(sizeof *q)) == NULL) {
-        exit(1);
+    e->hash = hash;
+    e->key = string_set_new_key(sset, s, len);
+    string_t *key = e->key;
+    if ((++sset->count) * 100 > sset->size * STRING_SET_LOADFACTOR) {
+        string_set_grow(sset);
     }
-    q->key = string_dup(s);
-    q->left = NULL;
-    q->right = *p;
-    *p = q;
-    return q->key;
+    return key;
 }
 
 string_t *string_set_search(string_set_t *sset, string_t *s)
 {
-    return string_set_search_impl(sset, s, 0);
+    return string_set_search_impl(sset, s->p, s->len, string_set_hash(s->p, s->len), 0);
 }
 
 string_t *string_set_insert(string_set_t *sset, string_t *s)
 {
-    return string_set_search_impl(sset, s, 1);
+    return string_set_search_impl(sset, s->p, s->len, string_set_hash(s->p, s->len), 1);
+}
+
+string_t *string_set_insert_len(string_set_t *sset, const char *p, int len)
+{
+    return string_set_search_impl(sset, p, len, string_set_hash(p, len), 1);
+}
+
+string_t *string_set_insert_hash(string_set_t *sset, const char *p, int len, unsigned hash)
+{
+    return string_set_search_impl(sset, p, len, hash, 1);
 }
 
 #ifdef XSTRING_SET_DEBUG
-#include <stdio.h>
+#include <ctype.h>
 
 string_set_t sset = {0};
 string_t word = {0};
@@ -120,22 +162,104 @@ void getword(void)
 
 int main(void)
 {
-    int i;
-
-    for (i = 0; i < STRING_SET_HASHSIZE; i++) sset.hashtable[i] = NULL;
     while (getword(), word.len > 0) {
-        string_set_insert(&sset, string_dup(&word));
-        char *str = string_set_search_str(&sset, word.p);
-        if (str) printf("Found: %s\n", str);
+        string_set_insert(&sset, &word);
+        string_t *str = string_set_search(&sset, &word);
+        if (str) printf("Found: %s\n", str->p);
         else     printf("NOT Found: %s\n", word.p);
     }
-    printf("hold %lu different words\n", sset.count);
-    for (i = 0; i < STRING_SET_HASHSIZE; i++) {
-        if (sset.hashtable[i]) {
-            printf("hashtable[%d]\n", i);
-            string_set_dump(1, sset.hashtable[i]);
-        }
+    printf("hold %d different words\n", sset.count);
+    string_set_dump(&sset);
+    string_set_free_all(&sset);
+    return 0;
+}
+#endif
+
+#ifdef XSTRING_SET_BENCH
+/*
+    Micro-benchmark against the previous implementation,
+    which was a fixed 101 buckets of unbalanced binary trees.
+*/
+#include <time.h>
+
+#define BST_HASHSIZE (101)
+
+typedef struct bst_node_t_ {
+    struct bst_node_t_ *left;
+    struct bst_node_t_ *right;
+    string_t *key;
+} bst_node_t;
+
+static bst_node_t *bst_table[BST_HASHSIZE];
+
+static int bst_hash(const char *s)
+{
+    unsigned v;
+    for (v = 0; *s != '\0'; s++) {
+        v = ((v << 8) + *s) % BST_HASHSIZE;
+    }
+    return (int)v;
+}
+
+static string_t *bst_insert(string_t *s)
+{
+    int cmp;
+    bst_node_t **p = &(bst_table[bst_hash(s->p)]);
+    while (*p && (cmp = strcmp(s->p, (*p)->key->p)) != 0) {
+        p = cmp < 0 ? &((*p)->left) : &((*p)->right);
+    }
+    if (*p) {
+        return (*p)->key;
+    }
+    bst_node_t *q = (bst_node_t *)calloc(1, sizeof(bst_node_t));
+    q->key = string_dup(s);
+    *p = q;
+    return q->key;
+}
+
+static void bst_free(bst_node_t *p)
+{
+    if (!p) return;
+    bst_free(p->left);
+    bst_free(p->right);
+    string_free(p->key);
+    free(p);
+}
+
+int main(int ac, char **av)
+{
+    int distinct = ac > 1 ? atoi(av[1]) : 20000;
+    int lookups = ac > 2 ? atoi(av[2]) : 2000000;
+    string_t **words = (string_t **)calloc(distinct, sizeof(string_t *));
+    char buf[64];
+    for (int i = 0; i < distinct; i++) {
+        sprintf(buf, "identifier_%d_%x", i, (unsigned)(i * 2654435761u));
+        words[i] = string_new(buf);
+    }
+
+    clock_t t0 = clock();
+    for (int i = 0; i < lookups; i++) {
+        bst_insert(words[(unsigned)i * 7919u % (unsigned)distinct]);
+    }
+    clock_t t1 = clock();
+    string_set_t set = {0};
+    for (int i = 0; i < lookups; i++) {
+        string_set_insert(&set, words[(unsigned)i * 7919u % (unsigned)distinct]);
+    }
+    clock_t t2 = clock();
+
+    printf("%d distinct, %d lookups\n", distinct, lookups);
+    printf("  binary tree buckets : %8.3f sec\n", (double)(t1 - t0) / CLOCKS_PER_SEC);
+    printf("  open addressing     : %8.3f sec (size %d, count %d)\n", (double)(t2 - t1) / CLOCKS_PER_SEC, set.size, set.count);
+
+    for (int i = 0; i < BST_HASHSIZE; i++) {
+        bst_free(bst_table[i]);
+    }
+    string_set_free_all(&set);
+    for (int i = 0; i < distinct; i++) {
+        string_free(words[i]);
     }
+    free(words);
     return 0;
 }
 #endif
@@ -0,0 +1,55 @@
+#include "xvector.h"
+
+static void vectoritem_free(vectoritem_t *v)
+{
+    if (v->free) {
+        v->free(v->item);
+    }
+}
+
+vector_t *vector_new(void)
+{
+    return (vector_t *)calloc(1, sizeof(vector_t));
+}
+
+void vector_free(vector_t *vec)
+{
+    vector_clear(vec);
+    free(vec->items);
+    free(vec);
+}
+
+vector_t *vector_push(vector_t *vec, void *item, void (*free)(void *item))
+{
+    if (vec->count == vec->cap) {
+        int cap = vec->cap ? vec->cap * 2 : VECTOR_UNIT;
+        vectoritem_t *np = (vectoritem_t *)realloc(vec->items, cap * sizeof(vectoritem_t));
+        if (!np) {
+            /* the old items are still valid and the item is not added. */
+            return NULL;
+        }
+        vec->items = np;
+        vec->cap = cap;
+    }
+    vectoritem_t *v = &(vec->items[vec->count++]);
+    v->item = item;
+    v->free = free;
+    return vec;
+}
+
+vector_t *vector_pop(vector_t *vec)
+{
+    if (vec->count > 0) {
+        vectoritem_free(&(vec->items[--vec->count]));
+    }
+    return vec;
+}
+
+vector_t *vector_clear(vector_t *vec)
+{
+    for (int i = 0; i < vec->count; ++i) {
+        vectoritem_free(&(vec->items[i]));
+    }
+    vec->count = 0;
+    return vec;
+}
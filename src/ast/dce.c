@@ -0,0 +1,391 @@
+#include <string.h>
+#include "dce.h"
+#include "walk.h"
+#include "../kiss.tab.h"
+
+/*
+    Dead code elimination on the typed tree. A name refers to the symbol given by the typer,
+    and a set of symbols is those whose mark is the current epoch of the context.
+    A variable not in the set is marked dead by the negative epoch.
+*/
+enum dce_scan {
+    DCE_SCAN_REFS,          // symbols referred, except in nested functions.
+    DCE_SCAN_READS,         // symbols read, where a variable assigned by `=` is not read.
+    DCE_SCAN_NAMES,         // all symbols referred.
+    DCE_SCAN_PURE,          // whether nothing is called, assigned, or divided by a variable.
+    DCE_SCAN_DECLS,         // variables declared.
+};
+
+typedef struct ast_dce_context_ {
+    ast_dce_stats_t *stats;
+    int epoch;              // a symbol is in the current set if its mark is this.
+    ast_walker_t walker;
+} ast_dce_context_t;
+
+#define IS_ASSIGN_OP(op) ((op) == '=' || (op) == ADDEQ || (op) == SUBEQ || (op) == MULEQ || (op) == DIVEQ || (op) == MODEQ)
+#define IS_NONZERO_INT(node) ((node)->ntype == EXPR_INT && (node)->n.ivalue != 0)
+#define IS_SAFE_DIVISOR(node) (IS_NONZERO_INT(node) && (node)->n.ivalue != -1)
+#define IS_DEAD(c, sym) ((sym) && (sym)->mark == -(c)->epoch)
+
+/*
+    Walks a node and its descendants, but not its next siblings. A frame keeps in `indent`
+    whether it is in a nested function, where every name counts as read.
+    Symbols found are marked by the current epoch, and newly marked ones are pushed to refs if given.
+    Symbols declared are pushed to refs for DCE_SCAN_DECLS.
+    Returns 0 if an impure node is found for DCE_SCAN_PURE.
+*/
+static int dce_scan(ast_dce_context_t *c, node_t *node, enum dce_scan mode, vector_t *refs)
+{
+    ast_walker_t *w = &(c->walker);
+    int base = w->count;
+    ast_walker_push(w, node, 0);
+
+    while (w->count > base) {
+        ast_frame_t *f = ast_walker_top(w);
+        node = f->node;
+        if (!node) {
+            ast_walker_pop(w);
+            continue;
+        }
+
+        int skip = 0;
+        if (f->state == 0) {
+            f->state = 1;
+            switch (node->ntype) {
+            case EXPR_VAR: {
+                symbol_t *sym = node->n.e.var.sym;
+                if (mode <= DCE_SCAN_NAMES && sym && sym->mark != c->epoch) {
+                    sym->mark = c->epoch;
+                    if (refs) {
+                        vector_push(refs, (void*)sym, NULL);
+                    }
+                }
+                break;
+            }
+            case EXPR_DECL:
+                if (mode == DCE_SCAN_DECLS) {
+                    vector_push(refs, (void*)node->n.e.decl.sym, NULL);
+                }
+                break;
+            case EXPR_CALL:
+                if (mode == DCE_SCAN_PURE) {
+                    w->count = base;
+                    return 0;
+                }
+                break;
+            case EXPR_BINARY: {
+                int op = node->n.e.binary.op;
+                if (mode == DCE_SCAN_PURE &&
+                        (IS_ASSIGN_OP(op) || ((op == '/' || op == '%') && !IS_SAFE_DIVISOR(node->n.e.binary.rhs)))) {
+                    w->count = base;
+                    return 0;
+                }
+                if (mode == DCE_SCAN_READS && op == '=' && !f->indent && node->n.e.binary.lhs->ntype == EXPR_VAR) {
+                    f->state = 2;   // the variable assigned is not read.
+                }
+                break;
+            }
+            case STMT_FUNC:
+                skip = (mode == DCE_SCAN_REFS);
+                break;
+            default:
+                ;
+            }
+        }
+
+        node_t **slot;
+        while (!skip && (slot = ast_child_slot(node, f->state - 1)) != NULL) {
+            ++f->state;
+            if (*slot) {
+                int nested = f->indent || node->ntype == STMT_FUNC;
+                ast_walker_push(w, *slot, nested);
+                goto NEXT;
+            }
+        }
+        if (node->next && w->count - 1 > base) {
+            f->node = node->next;
+            f->state = 0;
+            continue;
+        }
+        ast_walker_pop(w);
+NEXT:;
+    }
+    return 1;
+}
+
+/* Statements nest only as deep as the parser allows, so they are handled recursively. */
+static int dce_prune_list(ast_dce_context_t *c, node_t *list);
+
+/* Returns 1 if the statement never completes, there is no break in the language. */
+static int dce_prune_statement(ast_dce_context_t *c, node_t *node)
+{
+    switch (node->ntype) {
+    case STMT_RET:
+        return 1;
+    case STMT_BLOCK:
+        return dce_prune_list(c, node->n.s.block.stmt);
+    case STMT_BRANCH: {
+        int t = dce_prune_list(c, node->n.s.branch.then_cloause);
+        int e = dce_prune_list(c, node->n.s.branch.else_cloause);
+        return t && e;
+    }
+    case STMT_PRELOOP:
+    case STMT_PSTLOOP:
+        dce_prune_list(c, node->n.s.loop.then_cloause);
+        return !node->n.s.loop.e2 || IS_NONZERO_INT(node->n.s.loop.e2);
+    default:
+        ;
+    }
+    return 0;
+}
+
+/* Statements after one which never completes are dropped, but functions declared there are kept. */
+static int dce_prune_list(ast_dce_context_t *c, node_t *list)
+{
+    for (node_t *s = list; s; s = s->next) {
+        if (!dce_prune_statement(c, s)) {
+            continue;
+        }
+        node_t *last = s;
+        node_t *next = NULL;
+        for (node_t *t = s->next; t; t = next) {
+            next = t->next;
+            if (t->ntype == STMT_FUNC) {
+                last->next = t;
+                last = t;
+            } else {
+                ++c->stats->statements;
+            }
+        }
+        last->next = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+    Dead variables are marked. Without decls, a statement assigning a pure value to a dead variable
+    is removed. With decls, a declaration of a dead variable is removed if its initializer is pure.
+    Returns 1 if the statement has become empty.
+*/
+static int dce_sweep_expression(ast_dce_context_t *c, node_t *stmt, int decls, int *changed)
+{
+    node_t *expr = stmt->n.s.expr;
+    if (!expr) {
+        return 0;
+    }
+    if (expr->ntype == EXPR_DECL) {
+        if (!decls) {
+            return 0;
+        }
+        node_t **slot = &(stmt->n.s.expr);
+        while (*slot) {
+            node_t *decl = *slot;
+            node_t *init = decl->n.e.decl.initializer;
+            if (IS_DEAD(c, decl->n.e.decl.sym) && (!init || dce_scan(c, init, DCE_SCAN_PURE, NULL))) {
+                *slot = decl->next;
+                ++c->stats->variables;
+                *changed = 1;
+                continue;
+            }
+            slot = &(decl->next);
+        }
+        return stmt->n.s.expr == NULL;
+    }
+
+    if (!decls && expr->ntype == EXPR_BINARY && expr->n.e.binary.op == '=' && expr->n.e.binary.lhs->ntype == EXPR_VAR &&
+            IS_DEAD(c, expr->n.e.binary.lhs->n.e.var.sym) && dce_scan(c, expr->n.e.binary.rhs, DCE_SCAN_PURE, NULL)) {
+        ++c->stats->stores;
+        *changed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+static void dce_sweep_list(ast_dce_context_t *c, node_t **slot, int decls, int *changed);
+
+/* Nested functions are swept by themselves, and only statements in a list can be removed. */
+static void dce_sweep_statement(ast_dce_context_t *c, node_t *node, int decls, int *changed)
+{
+    if (!node) {
+        return;
+    }
+    switch (node->ntype) {
+    case STMT_BLOCK:
+        dce_sweep_list(c, &(node->n.s.block.stmt), decls, changed);
+        break;
+    case STMT_BRANCH:
+        dce_sweep_statement(c, node->n.s.branch.then_cloause, decls, changed);
+        dce_sweep_statement(c, node->n.s.branch.else_cloause, decls, changed);
+        break;
+    case STMT_PRELOOP:
+    case STMT_PSTLOOP:
+        dce_sweep_statement(c, node->n.s.loop.then_cloause, decls, changed);
+        break;
+    default:
+        ;
+    }
+}
+
+static void dce_sweep_list(ast_dce_context_t *c, node_t **slot, int decls, int *changed)
+{
+    while (*slot) {
+        node_t *s = *slot;
+        if (s->ntype == STMT_EXPR && dce_sweep_expression(c, s, decls, changed)) {
+            *slot = s->next;
+            continue;
+        }
+        dce_sweep_statement(c, s, decls, changed);
+        slot = &(s->next);
+    }
+}
+
+/* Variables declared in the code swept and not in the current set. */
+static void dce_mark_dead(ast_dce_context_t *c, vector_t *locals)
+{
+    for (int i = 0; i < locals->count; ++i) {
+        symbol_t *sym = (symbol_t *)vector_get(locals, i);
+        if (sym && sym->mark != c->epoch) {
+            sym->mark = -c->epoch;
+        }
+    }
+}
+
+/*
+    Stores to variables never read are removed first, and then declarations of variables
+    no longer referred, until nothing changes. Only variables declared in the body or args
+    can be dead, so a store from a function to a global is kept.
+*/
+static void dce_locals(ast_dce_context_t *c, node_t *args, node_t *body)
+{
+    vector_t *locals = vector_new();
+    for (node_t *arg = args; arg; arg = arg->next) {
+        vector_push(locals, (void*)arg->n.e.decl.sym, NULL);
+    }
+    dce_scan(c, body, DCE_SCAN_DECLS, locals);
+
+    int changed;
+    do {
+        changed = 0;
+        ++c->epoch;
+        dce_scan(c, body, DCE_SCAN_READS, NULL);
+        dce_mark_dead(c, locals);
+        dce_sweep_statement(c, body, 0, &changed);
+
+        ++c->epoch;
+        dce_scan(c, body, DCE_SCAN_NAMES, NULL);
+        dce_mark_dead(c, locals);
+        dce_sweep_statement(c, body, 1, &changed);
+    } while (changed);
+    vector_free(locals);
+}
+
+/* Functions by name, where a function is reached by a symbol of it. */
+typedef struct dce_graph_ {
+    vector_t *funcs;
+    symbol_table_t *byname; // slot is the first function of the name, plus one.
+    int *same;              // the next function of the same name, plus one.
+    char *reached;
+    int *stack;
+    int sp;
+} dce_graph_t;
+
+/* All functions of the name if sym is NULL. */
+static void dce_reach(dce_graph_t *g, string_t *name, symbol_t *sym)
+{
+    symbol_t *first = symbol_search_one(g->byname, name);
+    for (int i = first ? first->slot : 0; i > 0; i = g->same[i - 1]) {
+        node_t *func = (node_t *)vector_get(g->funcs, i - 1);
+        if (!g->reached[i - 1] && (!sym || func->n.s.func.sym == sym)) {
+            g->reached[i - 1] = 1;
+            g->stack[g->sp++] = i - 1;
+        }
+    }
+}
+
+/*
+    A call graph from the top level code and exported functions. A function reached by no name
+    loses its body, as one not reachable in the lazy mode, so no backend emits it.
+*/
+static void dce_functions(ast_dce_context_t *c, vector_t *funcs, node_t *root, vector_t *exports)
+{
+    int n = funcs->count;
+    dce_graph_t g = {
+        .funcs = funcs, .byname = symbol_table_new(NULL), .same = (int *)calloc(n + 1, sizeof(int)),
+        .reached = (char *)calloc(n + 1, 1), .stack = (int *)calloc(n + 1, sizeof(int)),
+    };
+    for (int i = n - 1; i >= 0; --i) {
+        node_t *func = (node_t *)vector_get(funcs, i);
+        if (func->n.s.func.block) {
+            symbol_t *sym = symbol_add(g.byname, func->n.s.func.name, VALTYPE_UNKNOWN);
+            g.same[i] = sym->slot;
+            sym->slot = i + 1;
+        }
+    }
+
+    ++c->epoch;
+    vector_t *refs = vector_new();
+    dce_scan(c, root, DCE_SCAN_REFS, refs);
+    for (int i = 0; exports && i < exports->count; ++i) {
+        dce_reach(&g, (string_t *)vector_get(exports, i), NULL);
+    }
+    for (int k = 0; ; ) {
+        for ( ; k < refs->count; ++k) {
+            symbol_t *sym = (symbol_t *)vector_get(refs, k);
+            dce_reach(&g, sym->name, sym);
+        }
+        if (g.sp == 0) {
+            break;
+        }
+        node_t *func = (node_t *)vector_get(funcs, g.stack[--g.sp]);
+        dce_scan(c, func->n.s.func.block, DCE_SCAN_REFS, refs);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        node_t *func = (node_t *)vector_get(funcs, i);
+        if (func->n.s.func.block && !g.reached[i]) {
+            func->n.s.func.block = NULL;
+            func->n.s.func.state = FUNC_BODY_SKIPPED;
+            ++c->stats->functions;
+            vector_push(c->stats->names, (void*)func->n.s.func.name, NULL);
+        }
+    }
+
+    vector_free(refs);
+    symbol_table_free(g.byname);
+    free(g.stack);
+    free(g.reached);
+    free(g.same);
+}
+
+void ast_dce(vector_t *funcs, node_t *root, vector_t *exports, ast_dce_stats_t *stats)
+{
+    ast_dce_context_t ctx = { .stats = stats };
+    memset(stats, 0, sizeof(ast_dce_stats_t));
+    stats->names = vector_new();
+
+    dce_prune_statement(&ctx, root);
+    for (int i = 0; i < funcs->count; ++i) {
+        node_t *func = (node_t *)vector_get(funcs, i);
+        if (func->n.s.func.block) {
+            dce_prune_statement(&ctx, func->n.s.func.block);
+        }
+    }
+
+    dce_locals(&ctx, NULL, root);
+    for (int i = 0; i < funcs->count; ++i) {
+        node_t *func = (node_t *)vector_get(funcs, i);
+        if (func->n.s.func.block) {
+            dce_locals(&ctx, func->n.s.func.args, func->n.s.func.block);
+        }
+    }
+
+    dce_functions(&ctx, funcs, root, exports);
+    ast_walker_free(&(ctx.walker));
+}
+
+void ast_dce_stats_free(ast_dce_stats_t *stats)
+{
+    vector_free(stats->names);
+    stats->names = NULL;
+}
@@ -0,0 +1,19 @@
+#ifndef KISS_DCE_H
+#define KISS_DCE_H
+
+#include "xvector.h"
+#include "node.h"
+
+/* What was dropped by ast_dce(), names are those of removed functions. */
+typedef struct ast_dce_stats_ {
+    int functions;
+    int statements;         // statements after one which never completes.
+    int variables;          // declarations of locals never referred.
+    int stores;             // assignments of a pure value to locals never read.
+    vector_t *names;
+} ast_dce_stats_t;
+
+extern void ast_dce(vector_t *funcs, node_t *root, vector_t *exports, ast_dce_stats_t *stats);
+extern void ast_dce_stats_free(ast_dce_stats_t *stats);
+
+#endif /* KISS_DCE_H */
@@ -1,4 +1,5 @@
 #include "node.h"
+#include "walk.h"
 #include "../kiss.tab.h"
 
 static const char *get_type_name(int vtype)
@@ -33,42 +34,44 @@ static const char *get_operator_name(int op)
     return b;
 }
 
-static void print_argument_list(list_t *argtypes)
+static const char *get_vtype_name(type_table_t *types, int type)
+{
+    return get_type_name(type_get(types, type)->vtype);
+}
+
+static void print_argument_list(type_table_t *types, type_t *ftype)
 {
     printf(" (");
-    for (int i = 0; ; ++i) {
-        types_t type = list_get_argtype(argtypes, i);
-        if (type.vtype == 0 && type.rtype == 0) {
-            break;
-        }
+    for (int i = 0; i < ftype->argc; ++i) {
+        type_t *type = type_get(types, ftype->args[i]);
         if (i > 0) printf(", ");
-        if (type.rtype) {
-            printf("%s->%s", get_type_name(type.vtype), get_type_name(type.rtype));
-            if (type.argtypes) {
-                print_argument_list(type.argtypes);
-            }
+        if (type->rtype) {
+            printf("%s->%s", get_type_name(type->vtype), get_vtype_name(types, type->rtype));
+            print_argument_list(types, type);
         } else {
-            printf("%s", get_type_name(type.vtype));
+            printf("%s", get_type_name(type->vtype));
         }
     }
     printf(")");
 }
 
-static void print_symbol_table(symbol_table_t *symtbl)
+static void print_symbol_table(type_table_t *types, symbol_table_t *symtbl)
 {
+    if (!symtbl) {
+        return;     // not typed.
+    }
     symbol_t *sym = symtbl->symbol;
     if (!sym) {
         return;
     }
     printf("======== Symbol Table ========\n");
     while (sym) {
-        if (sym->type.rtype) {
-            printf(" * %s:%s -> %s", sym->name->p, get_type_name(sym->type.vtype), get_type_name(sym->type.rtype));
+        type_t *type = type_get(types, sym->type);
+        if (type->rtype) {
+            printf(" * %s:%s -> %s", sym->name->p, get_type_name(type->vtype), get_vtype_name(types, type->rtype));
+            print_argument_list(types, type);
         } else {
-            printf(" * %s:%s", sym->name->p, get_type_name(sym->type.vtype));
-        }
-        if (sym->argtypes) {
-            print_argument_list(sym->argtypes);
+            printf(" * %s:%s", sym->name->p, get_type_name(type->vtype));
         }
         printf("\n");
         sym = sym->next;
@@ -76,149 +79,216 @@ static void print_symbol_table(symbol_table_t *symtbl)
     printf("------------------------------\n");
 }
 
-static void ast_dump_item(int indent, node_t *node)
+static void ast_dump_item(type_table_t *types, int indent, node_t *root)
 {
-    if (!node) {
-        return;
-    }
+    ast_walker_t walker = {0};
+    ast_walker_t *w = &walker;
+    ast_walker_push(w, root, indent);
 
-TOP:;
-    SHOW_INDENT(indent);
+    while (w->count > 0) {
+        ast_frame_t *f = ast_walker_top(w);
+        node_t *node = f->node;
+        if (!node) {
+            ast_walker_pop(w);
+            continue;
+        }
+        indent = f->indent;
+        if (f->state == 0) {
+            SHOW_INDENT(indent);
+        }
 
-    switch (node->ntype) {
-    /* dump expression. */
-    case EXPR_INT: {
-        printf("%lld: int\n", node->n.ivalue);
-        break;
-    }
-    case EXPR_DBL: {
-        printf("%f: dbl\n", node->n.dvalue);
-        break;
-    }
-    case EXPR_STR: {
-        printf("\"%s\": str\n", node->n.svalue->p);
-        break;
-    }
-    case EXPR_VAR: {
-        printf("%s: %s\n", node->n.name->p, get_type_name(node->vtype.vtype));
-        break;
-    }
-    case EXPR_CALL: {
-        printf("[call]: %s\n", get_type_name(node->vtype.vtype));
-        ast_dump_item(indent + 1, node->n.e.call.func);
-        SHOW_INDENT(indent + 1);
-        printf("[args]\n");
-        ast_dump_item(indent + 2, node->n.e.call.args);
-        node_t *next = node->n.e.call.args->next;
-        while (next) {
-            ast_dump_item(indent + 2, next);
-            next = next->next;
-        }
-        break;
-    }
-    case EXPR_BINARY: {
-        printf("%s: %s\n", get_operator_name(node->n.e.binary.op), get_type_name(node->vtype.vtype));
-        ast_dump_item(indent + 1, node->n.e.binary.lhs);
-        ast_dump_item(indent + 1, node->n.e.binary.rhs);
-        break;
-    }
-    case EXPR_DECL: {
-        printf("[declaration]\n");
-        SHOW_INDENT(indent + 1);
-        printf("%s: %s\n", node->n.e.decl.name->p, get_type_name(node->vtype.vtype));
-        ast_dump_item(indent + 2, node->n.e.decl.initializer);
-        if (node->next) {
-            ast_dump_item(indent, node->next);
-        }
-        break;
-    }
+        switch (node->ntype) {
+        /* dump expression. */
+        case EXPR_INT: {
+            printf("%lld: int\n", node->n.ivalue);
+            break;
+        }
+        case EXPR_DBL: {
+            printf("%f: dbl\n", node->n.dvalue);
+            break;
+        }
+        case EXPR_STR: {
+            printf("\"%s\": str\n", node->n.svalue->p);
+            break;
+        }
+        case EXPR_VAR: {
+            printf("%s: %s\n", node->n.e.var.name->p, get_vtype_name(types, node->type));
+            break;
+        }
+        case EXPR_CALL: {
+            switch (f->state) {
+            case 0:
+                printf("[call]: %s\n", get_vtype_name(types, node->type));
+                WALK(1, node->n.e.call.func, indent + 1);
+            case 1:
+                SHOW_INDENT(indent + 1);
+                printf("[args]\n");
+                WALK(2, node->n.e.call.args, indent + 2);
+            case 2:
+                f->saved = node->n.e.call.args->next;
+                /* fallthrough */
+            default:
+                if (f->saved) {
+                    node_t *arg = (node_t *)f->saved;
+                    f->saved = arg->next;
+                    WALK(3, arg, indent + 2);
+                }
+            }
+            break;
+        }
+        case EXPR_BINARY: {
+            switch (f->state) {
+            case 0:
+                printf("%s: %s\n", get_operator_name(node->n.e.binary.op), get_vtype_name(types, node->type));
+                WALK(1, node->n.e.binary.lhs, indent + 1);
+            case 1:
+                WALK(2, node->n.e.binary.rhs, indent + 1);
+            default:
+                ;
+            }
+            break;
+        }
+        case EXPR_DECL: {
+            if (f->state == 0) {
+                printf("[declaration]\n");
+                SHOW_INDENT(indent + 1);
+                printf("%s: %s\n", node->n.e.decl.name->p, get_vtype_name(types, node->type));
+                WALK(1, node->n.e.decl.initializer, indent + 2);
+            }
+            WALKNEXT(node);
+            break;
+        }
 
-    /* dump statement, note that a statement can have a next statement. */
-    case STMT_EXPR: {
-        printf("[expression]\n");
-        ast_dump_item(indent + 1, node->n.s.expr);
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_BLOCK: {
-        printf("[block]\n");
-        print_symbol_table(node->symtbl);
-        ast_dump_item(indent + 1, node->n.s.block);
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_BRANCH: {
-        printf("[branch]\n");
-        SHOW_INDENT(indent + 1);
-        printf("[condtion]\n");
-        ast_dump_item(indent + 2, node->n.s.branch.expr);
-        SHOW_INDENT(indent + 1);
-        printf("[then]\n");
-        ast_dump_item(indent + 2, node->n.s.branch.then_cloause);
-        if (node->n.s.branch.else_cloause) {
-            SHOW_INDENT(indent + 1);
-            printf("[else]\n");
-            ast_dump_item(indent + 2, node->n.s.branch.else_cloause);
-        }
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_PRELOOP: {
-        printf("[pre-condition-loop]\n");
-        if (node->n.s.loop.e1) {
-            SHOW_INDENT(indent + 1);
-            printf("[initializer]\n");
-            ast_dump_item(indent + 2, node->n.s.loop.e1);
-        }
-        if (node->n.s.loop.e2) {
-            SHOW_INDENT(indent + 1);
-            printf("[condition]\n");
-            ast_dump_item(indent + 2, node->n.s.loop.e2);
-        }
-        SHOW_INDENT(indent + 1);
-        printf("[then]\n");
-        ast_dump_item(indent + 2, node->n.s.loop.then_cloause);
-        if (node->n.s.loop.e3) {
-            SHOW_INDENT(indent + 1);
-            printf("[update]\n");
-            ast_dump_item(indent + 2, node->n.s.loop.e3);
-        }
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_PSTLOOP: {
-        printf("[post-condition-loop]\n");
-        SHOW_INDENT(indent + 1);
-        printf("[then]\n");
-        ast_dump_item(indent + 2, node->n.s.loop.e2);
-        if (node->n.s.loop.e2) {
-            SHOW_INDENT(indent + 1);
-            printf("[condition]\n");
-            ast_dump_item(indent + 2, node->n.s.loop.e2);
-        }
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_RET: {
-        printf("[return]\n");
-        ast_dump_item(indent + 1, node->n.s.ret.expr);
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_FUNC: {
-        printf("[function-definition] %s -> %s\n", node->n.s.func.name->p, get_type_name(node->vtype.rtype));
-        print_symbol_table(node->symtbl);
-        ast_dump_item(indent + 1, node->n.s.func.args);
-        ast_dump_item(indent + 1, node->n.s.func.block);
-        CHECKNEXT(node);
-        break;
-    }
-    default:
-        ;
+        /* dump statement, note that a statement can have a next statement. */
+        case STMT_EXPR: {
+            if (f->state == 0) {
+                printf("[expression]\n");
+                WALK(1, node->n.s.expr, indent + 1);
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_BLOCK: {
+            if (f->state == 0) {
+                printf("[block]\n");
+                print_symbol_table(types, node->n.s.block.symtbl);
+                WALK(1, node->n.s.block.stmt, indent + 1);
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_BRANCH: {
+            switch (f->state) {
+            case 0:
+                printf("[branch]\n");
+                SHOW_INDENT(indent + 1);
+                printf("[condtion]\n");
+                WALK(1, node->n.s.branch.expr, indent + 2);
+            case 1:
+                SHOW_INDENT(indent + 1);
+                printf("[then]\n");
+                WALK(2, node->n.s.branch.then_cloause, indent + 2);
+            case 2:
+                if (node->n.s.branch.else_cloause) {
+                    SHOW_INDENT(indent + 1);
+                    printf("[else]\n");
+                    WALK(3, node->n.s.branch.else_cloause, indent + 2);
+                }
+                /* fallthrough */
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_PRELOOP: {
+            switch (f->state) {
+            case 0:
+                printf("[pre-condition-loop]\n");
+                if (node->n.s.loop.e1) {
+                    SHOW_INDENT(indent + 1);
+                    printf("[initializer]\n");
+                    WALK(1, node->n.s.loop.e1, indent + 2);
+                }
+                /* fallthrough */
+            case 1:
+                if (node->n.s.loop.e2) {
+                    SHOW_INDENT(indent + 1);
+                    printf("[condition]\n");
+                    WALK(2, node->n.s.loop.e2, indent + 2);
+                }
+                /* fallthrough */
+            case 2:
+                SHOW_INDENT(indent + 1);
+                printf("[then]\n");
+                WALK(3, node->n.s.loop.then_cloause, indent + 2);
+            case 3:
+                if (node->n.s.loop.e3) {
+                    SHOW_INDENT(indent + 1);
+                    printf("[update]\n");
+                    WALK(4, node->n.s.loop.e3, indent + 2);
+                }
+                /* fallthrough */
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_PSTLOOP: {
+            switch (f->state) {
+            case 0:
+                printf("[post-condition-loop]\n");
+                SHOW_INDENT(indent + 1);
+                printf("[then]\n");
+                WALK(1, node->n.s.loop.e2, indent + 2);
+            case 1:
+                if (node->n.s.loop.e2) {
+                    SHOW_INDENT(indent + 1);
+                    printf("[condition]\n");
+                    WALK(2, node->n.s.loop.e2, indent + 2);
+                }
+                /* fallthrough */
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_RET: {
+            if (f->state == 0) {
+                printf("[return]\n");
+                WALK(1, node->n.s.ret.expr, indent + 1);
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_FUNC: {
+            switch (f->state) {
+            case 0:
+                printf("[function-definition] %s -> %s\n", node->n.s.func.name->p, get_type_name(node->n.s.func.rtype));
+                print_symbol_table(types, node->n.s.func.symtbl);
+                WALK(1, node->n.s.func.args, indent + 1);
+            case 1:
+                WALK(2, node->n.s.func.block, indent + 1);
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
+        }
+        default:
+            ;
+        }
+
+        ast_walker_pop(w);
+NEXT:;
     }
+
+    ast_walker_free(w);
 }
 
-void ast_dump(node_t *root)
+void ast_dump(type_table_t *types, node_t *root)
 {
-    ast_dump_item(0, root);
+    ast_dump_item(types, 0, root);
 }
@@ -3,6 +3,6 @@
 
 #include "node.h"
 
-extern void ast_dump(node_t *root);
+extern void ast_dump(type_table_t *types, node_t *root);
 
 #endif /* KISS_DUMP_H */
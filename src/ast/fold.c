@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include "fold.h"
+#include "../kiss.tab.h"
+
+/* The same as the generated C on int64_t, returns 0 for an operation which is undefined in C. */
+static int fold_int(int op, int64_t a, int64_t b, int64_t *r)
+{
+    uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+    switch (op) {
+    case '+': *r = (int64_t)(ua + ub); return 1;
+    case '-': *r = (int64_t)(ua - ub); return 1;
+    case '*': *r = (int64_t)(ua * ub); return 1;
+    case '/':
+    case '%':
+        if (b == 0 || (a == INT64_MIN && b == -1)) {
+            return 0;
+        }
+        *r = (op == '/') ? a / b : a % b;
+        return 1;
+    case EQEQ: *r = a == b; return 1;
+    case NEQ:  *r = a != b; return 1;
+    case '<':  *r = a < b; return 1;
+    case LEQ:  *r = a <= b; return 1;
+    case '>':  *r = a > b; return 1;
+    case GEQ:  *r = a >= b; return 1;
+    default:
+        ;
+    }
+    return 0;
+}
+
+static void ast_fold_begin(void *arg)
+{
+    ((ast_fold_t *)arg)->folded = 0;
+}
+
+/* Children are visited first, so a nested expression of literals is folded from the bottom. */
+static node_t *ast_fold_visit(void *arg, node_t *node)
+{
+    ast_fold_t *fold = (ast_fold_t *)arg;
+    node_t *lhs = node->n.e.binary.lhs;
+    node_t *rhs = node->n.e.binary.rhs;
+    int64_t r;
+    if (lhs->ntype != EXPR_INT || rhs->ntype != EXPR_INT ||
+            !fold_int(node->n.e.binary.op, lhs->n.ivalue, rhs->n.ivalue, &r)) {
+        return node;
+    }
+    ++fold->folded;
+    return ast_value_int(fold->mgr, r);
+}
+
+static int ast_fold_end(void *arg)
+{
+    fprintf(stderr, "fold: %d operations folded\n", ((ast_fold_t *)arg)->folded);
+    return 0;
+}
+
+ast_pass_t ast_fold_pass(ast_fold_t *fold, node_manager_t *mgr)
+{
+    fold->mgr = mgr;
+    ast_pass_t pass = {
+        .name = "fold",
+        .kinds = AST_PASS_KIND(EXPR_BINARY),
+        .requires = AST_ANALYSIS_TYPES,
+        .invalidates = AST_ANALYSIS_IR,
+        .begin = ast_fold_begin,
+        .visit = ast_fold_visit,
+        .end = ast_fold_end,
+        .arg = fold,
+    };
+    return pass;
+}
@@ -0,0 +1,14 @@
+#ifndef KISS_FOLD_H
+#define KISS_FOLD_H
+
+#include "pass.h"
+
+/* Folds binary operations of int literals into a literal, the count is printed to stderr at the end of the pass. */
+typedef struct ast_fold_ {
+    node_manager_t *mgr;
+    int folded;
+} ast_fold_t;
+
+extern ast_pass_t ast_fold_pass(ast_fold_t *fold, node_manager_t *mgr);
+
+#endif /* KISS_FOLD_H */
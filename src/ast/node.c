@@ -4,38 +4,87 @@
 /*
     Management of nodes
 */
-static node_manager_t *node_manager_new(void)
+static node_chunk_t *node_chunk_new(node_chunk_t *next)
 {
-    return (node_manager_t *)calloc(1, sizeof(node_manager_t));
+    node_chunk_t *c = (node_chunk_t *)calloc(1, sizeof(node_chunk_t));
+    c->next = next;
+    return c;
 }
 
-static node_t *node_new(node_manager_t *mgr)
+#define NODE_SIZEOF(variant) (offsetof(node_t, n) + sizeof(((node_t *)0)->n.variant))
+
+static size_t node_size(enum node_type ntype)
+{
+    switch (ntype) {
+    case EXPR_INT:      return NODE_SIZEOF(ivalue);
+    case EXPR_DBL:      return NODE_SIZEOF(dvalue);
+    case EXPR_STR:      return NODE_SIZEOF(svalue);
+    case EXPR_VAR:      return NODE_SIZEOF(e.var);
+    case EXPR_CALL:     return NODE_SIZEOF(e.call);
+    case EXPR_UNARY:    return NODE_SIZEOF(e.unary);
+    case EXPR_BINARY:   return NODE_SIZEOF(e.binary);
+    case EXPR_DECL:     return NODE_SIZEOF(e.decl);
+    case STMT_EXPR:     return NODE_SIZEOF(s.expr);
+    case STMT_BLOCK:    return NODE_SIZEOF(s.block);
+    case STMT_BRANCH:   return NODE_SIZEOF(s.branch);
+    case STMT_PRELOOP:  return NODE_SIZEOF(s.loop);
+    case STMT_PSTLOOP:  return NODE_SIZEOF(s.loop);
+    case STMT_RET:      return NODE_SIZEOF(s.ret);
+    case STMT_FUNC:     return NODE_SIZEOF(s.func);
+    default:
+        ;
+    }
+    return sizeof(node_t);
+}
+
+static void node_own(node_manager_t *mgr, node_t *n)
+{
+    if (mgr->owned_count == mgr->owned_cap) {
+        mgr->owned_cap = mgr->owned_cap ? mgr->owned_cap * 2 : 64;
+        mgr->owned = (node_t **)realloc(mgr->owned, mgr->owned_cap * sizeof(node_t *));
+    }
+    mgr->owned[mgr->owned_count++] = n;
+}
+
+static node_t *node_new(node_manager_t *mgr, enum node_type ntype)
 {
-    node_t *n = (node_t *)calloc(1, sizeof(node_t));
-    node_manager_t *m = node_manager_new();
-    m->node = n;
-    m->head = mgr->head;
-    mgr->head = m;
+    int words = (int)((node_size(ntype) + sizeof(int64_t) - 1) / sizeof(int64_t));
+    node_chunk_t *c = mgr->chunk;
+    if (!c || NODE_CHUNK_WORDS < c->used + words) {
+        c = mgr->chunk = node_chunk_new(c);
+    }
+    node_t *n = (node_t *)&(c->word[c->used]);
+    c->used += words;
+    n->ntype = ntype;
+    if (ntype == STMT_BLOCK || ntype == STMT_FUNC) {
+        node_own(mgr, n);
+    }
     return n;
 }
 
 void node_free_all(node_manager_t *mgr)
 {
-    node_manager_t *m = mgr->head;
-    while (m) {
-        node_manager_t *next = m->head;
-        if (m->node) {
-            if (m->node->symtbl) {
-                symbol_table_free(m->node->symtbl);
-            }
-            if (m->node->vtype.argtypes) {
-                list_free(m->node->vtype.argtypes);
-            }
-            free(m->node);
+    for (int i = 0; i < mgr->owned_count; ++i) {
+        node_t *n = mgr->owned[i];
+        if (n->ntype == STMT_BLOCK && n->n.s.block.symtbl) {
+            symbol_table_free(n->n.s.block.symtbl);
+        }
+        if (n->ntype == STMT_FUNC && n->n.s.func.symtbl) {
+            symbol_table_free(n->n.s.func.symtbl);
         }
-        free(m);
-        m = next;
     }
+    free(mgr->owned);
+    mgr->owned = NULL;
+    mgr->owned_count = mgr->owned_cap = 0;
+
+    node_chunk_t *c = mgr->chunk;
+    while (c) {
+        node_chunk_t *next = c->next;
+        free(c);
+        c = next;
+    }
+    mgr->chunk = NULL;
+    mgr->root = NULL;
 }
 
 node_t *node_connect(node_t *prev, node_t *next)
@@ -63,45 +112,41 @@ node_t *ast_set_root(node_manager_t *mgr, node_t *root)
 */
 node_t *ast_value_int(node_manager_t *mgr, int64_t ivalue)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_INT;
-    n->vtype = (types_t) { .vtype = VALTYPE_INT };
+    node_t *n = node_new(mgr, EXPR_INT);
+    n->type = VALTYPE_INT;
     n->n.ivalue = ivalue;
     return n;
 }
 
 node_t *ast_value_dbl(node_manager_t *mgr, double dvalue)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_DBL;
-    n->vtype = (types_t) { .vtype = VALTYPE_DBL };
+    node_t *n = node_new(mgr, EXPR_DBL);
+    n->type = VALTYPE_DBL;
     n->n.dvalue = dvalue;
     return n;
 }
 
 node_t *ast_value_str(node_manager_t *mgr, string_t *svalue)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_STR;
-    n->vtype = (types_t) { .vtype = VALTYPE_STR };
+    node_t *n = node_new(mgr, EXPR_STR);
+    n->type = VALTYPE_STR;
     n->n.svalue = svalue;
     return n;
 }
 
 node_t *ast_variable(node_manager_t *mgr, string_t *name)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_VAR;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
-    n->n.name = name;
+    node_t *n = node_new(mgr, EXPR_VAR);
+    n->type = VALTYPE_UNKNOWN;
+    n->n.e.var.name = name;
+    n->n.e.var.sym = NULL;
     return n;
 }
 
 node_t *ast_call(node_manager_t *mgr, node_t *func, node_t *args)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_CALL;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, EXPR_CALL);
+    n->type = VALTYPE_UNKNOWN;
     n->n.e.call.func = func;
     n->n.e.call.args = args;
     return n;
@@ -109,36 +154,48 @@ node_t *ast_call(node_manager_t *mgr, node_t *func, node_t *args)
 
 node_t *ast_binary(node_manager_t *mgr, int op, node_t *lhs, node_t *rhs)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_BINARY;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, EXPR_BINARY);
+    n->type = VALTYPE_UNKNOWN;
     n->n.e.binary.op = op;
     n->n.e.binary.lhs = lhs;
     n->n.e.binary.rhs = rhs;
+    n->n.e.binary.spine = NULL;
     return n;
 }
 
+/*
+    The new node is inserted at the end of the right spine of lhs. The root of lhs remembers
+    the last binary node of the spine, so that a chain of assignments does not walk the spine again.
+*/
 node_t *ast_binary_right(node_manager_t *mgr, int op, node_t *lhs, node_t *rhs)
 {
     node_t **p = &lhs;
-    while ((*p)->n.e.binary.rhs) {
+    if (lhs->ntype == EXPR_BINARY && lhs->n.e.binary.spine) {
+        p = &(lhs->n.e.binary.spine->n.e.binary.rhs);
+    }
+    while ((*p)->ntype == EXPR_BINARY && (*p)->n.e.binary.rhs) {
         p = &((*p)->n.e.binary.rhs);
     }
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_BINARY;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, EXPR_BINARY);
+    n->type = VALTYPE_UNKNOWN;
     n->n.e.binary.op = op;
     n->n.e.binary.lhs = *p;
     n->n.e.binary.rhs = rhs;
+    n->n.e.binary.spine = NULL;
     *p = n;
+
+    node_t *last = n;
+    while (last->n.e.binary.rhs->ntype == EXPR_BINARY && last->n.e.binary.rhs->n.e.binary.rhs) {
+        last = last->n.e.binary.rhs;
+    }
+    lhs->n.e.binary.spine = last;
     return lhs;
 }
 
-node_t *ast_decl_expression(node_manager_t *mgr, string_t *name, int vtype, node_t *initializer)
+node_t *ast_decl_expression(node_manager_t *mgr, string_t *name, int type, node_t *initializer)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_DECL;
-    n->vtype = (types_t) { .vtype = vtype };
+    node_t *n = node_new(mgr, EXPR_DECL);
+    n->type = type;
     n->n.e.decl.name = name;
     n->n.e.decl.initializer = initializer;
     return n;
@@ -149,9 +206,8 @@ node_t *ast_decl_expression(node_manager_t *mgr, string_t *name, int vtype, node
 */
 node_t *ast_expr_statement(node_manager_t *mgr, node_t *expr)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_EXPR;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, STMT_EXPR);
+    n->type = VALTYPE_UNKNOWN;
     n->n.s.expr = expr;
     return n;
 }
@@ -167,18 +223,16 @@ node_t *ast_block_statement(node_manager_t *mgr, node_t *stmt)
         return stmt;
     }
 
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_BLOCK;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
-    n->n.s.block = stmt;
+    node_t *n = node_new(mgr, STMT_BLOCK);
+    n->type = VALTYPE_UNKNOWN;
+    n->n.s.block.stmt = stmt;
     return n;
 }
 
 node_t *ast_branch_statement(node_manager_t *mgr, node_t *expr, node_t *then_clause, node_t *else_clause)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_BRANCH;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, STMT_BRANCH);
+    n->type = VALTYPE_UNKNOWN;
     n->n.s.branch.expr = expr;
     n->n.s.branch.then_cloause = ast_block_statement(mgr, then_clause);
     n->n.s.branch.else_cloause = ast_block_statement(mgr, else_clause);
@@ -187,9 +241,8 @@ node_t *ast_branch_statement(node_manager_t *mgr, node_t *expr, node_t *then_cla
 
 node_t *ast_for_loop_statement(node_manager_t *mgr, node_t *expr1, node_t *expr2, node_t *expr3, node_t *then_clause)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_PRELOOP;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, STMT_PRELOOP);
+    n->type = VALTYPE_UNKNOWN;
     n->n.s.loop.e1 = expr1;
     n->n.s.loop.e2 = expr2;
     n->n.s.loop.e3 = expr3;
@@ -199,9 +252,8 @@ node_t *ast_for_loop_statement(node_manager_t *mgr, node_t *expr1, node_t *expr2
 
 node_t *ast_precond_loop_statement(node_manager_t *mgr, node_t *expr, node_t *then_clause)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_PRELOOP;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, STMT_PRELOOP);
+    n->type = VALTYPE_UNKNOWN;
     n->n.s.loop.e2 = expr;
     n->n.s.loop.then_cloause = ast_block_statement(mgr, then_clause);
     return n;
@@ -209,9 +261,8 @@ node_t *ast_precond_loop_statement(node_manager_t *mgr, node_t *expr, node_t *th
 
 node_t *ast_postcond_loop_statement(node_manager_t *mgr, node_t *expr, node_t *then_clause)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_PSTLOOP;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, STMT_PSTLOOP);
+    n->type = VALTYPE_UNKNOWN;
     n->n.s.loop.e2 = expr;
     n->n.s.loop.then_cloause = ast_block_statement(mgr, then_clause);
     return n;
@@ -219,9 +270,8 @@ node_t *ast_postcond_loop_statement(node_manager_t *mgr, node_t *expr, node_t *t
 
 node_t *ast_return_statement(node_manager_t *mgr, node_t *expr, node_t *if_modifier_expr)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_RET;
-    n->vtype = (types_t) { .vtype = VALTYPE_UNKNOWN };
+    node_t *n = node_new(mgr, STMT_RET);
+    n->type = VALTYPE_UNKNOWN;
     n->n.s.ret.expr = expr;
     if (if_modifier_expr) {
         return ast_branch_statement(mgr, if_modifier_expr, n, NULL);
@@ -229,23 +279,30 @@ node_t *ast_return_statement(node_manager_t *mgr, node_t *expr, node_t *if_modif
     return n;
 }
 
-node_t *ast_function_statement(node_manager_t *mgr, int64_t rtype, string_t *name, node_t *args, node_t *block)
+node_t *ast_function_statement(node_manager_t *mgr, int rtype, string_t *name, node_t *args, node_t *block)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = STMT_FUNC;
-    n->vtype = (types_t) { .vtype = VALTYPE_FUNC, .rtype = rtype };
+    node_t *n = node_new(mgr, STMT_FUNC);
+    n->type = VALTYPE_FUNC;
     n->n.s.func.name = name;
+    n->n.s.func.rtype = rtype;
     n->n.s.func.args = args;
     n->n.s.func.block = block;
     return n;
 }
 
+/* A function whose body is skipped, and will be parsed from the position if it is used. */
+node_t *ast_lazy_function_statement(node_manager_t *mgr, int rtype, string_t *name, node_t *args, size_t body)
+{
+    node_t *n = ast_function_statement(mgr, rtype, name, args, NULL);
+    n->n.s.func.state = FUNC_BODY_SKIPPED;
+    n->n.s.func.body = body;
+    return n;
+}
+
 node_t *ast_builtin_function(node_manager_t *mgr, const char *name)
 {
-    node_t *n = node_new(mgr);
-    n->ntype = EXPR_VAR;
-    n->vtype = (types_t) { .vtype = VALTYPE_INT, .argtypes = list_new() };
-    list_add_argtype(n->vtype.argtypes, (types_t) { .vtype = VALTYPE_VA });
-    n->n.name = string_new(name);
+    node_t *n = node_new(mgr, EXPR_VAR);
+    n->type = type_function(mgr->types, VALTYPE_INT, 1, (int[]){ VALTYPE_VA });
+    n->n.e.var.name = string_new(name);
     return n;
 }
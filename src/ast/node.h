@@ -2,6 +2,7 @@
 #define KISS_NODE_H
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "xstring.h"
 #include "symbol.h"
@@ -28,27 +29,46 @@ enum node_type {
     STMT_FUNC,
 };
 
+#define NODE_CHUNK_WORDS (8 * 1024)
+
+/* States of a function body, which can be parsed on demand. */
+enum func_body_state {
+    FUNC_BODY_PARSED,
+    FUNC_BODY_SKIPPED,              // only the position is recorded.
+    FUNC_BODY_REQUESTED,            // reachable, and to be parsed.
+};
+
 struct node_t_;
+struct node_chunk_t_;
 typedef struct node_manager_t_ {
-    struct node_t_ *node;
+    struct node_chunk_t_ *chunk;    // current chunk, older chunks are linked from it.
+    struct node_t_ **owned;         // side table of nodes which hold resources to be released.
+    int owned_count;
+    int owned_cap;
     struct node_t_ *root;
-    struct node_manager_t_ *head;
+    type_table_t *types;
 } node_manager_t;
 
+/*
+    A node is allocated only with the size of its own variant in the union,
+    so fields must not be accessed through a variant of another node type.
+*/
 typedef struct node_t_ {
-    node_manager_t *mgr;            // reference to an allocation manager.
     struct node_t_ *next;           // for statement or expression list.
     struct node_t_ *last;           // for statement or expression list.
 
     enum node_type ntype;
-    types_t vtype;                  // type of value.
+    int type;                       // type id of value.
 
     union {
         int64_t ivalue;             // EXPR_INT
         double dvalue;              // EXPR_DBL
         string_t *svalue;           // EXPR_STR
-        string_t *name;             // EXPR_VAR
         union {
+            struct {                // EXPR_VAR
+                string_t *name;
+                symbol_t *sym;      // resolved by the typer, NULL if not found.
+            } var;
             struct {                // EXPR_UNARY
                 int op;
                 struct node_t_ *expr;
@@ -57,6 +77,7 @@ typedef struct node_t_ {
                 int op;
                 struct node_t_ *lhs;
                 struct node_t_ *rhs;
+                struct node_t_ *spine;  // the last binary node of the right spine, see ast_binary_right().
             } binary;
             struct {                // EXPR_CALL
                 struct node_t_ *func;
@@ -65,10 +86,14 @@ typedef struct node_t_ {
             struct {                // EXPR_DECL
                 string_t *name;     // variable name.
                 struct node_t_ *initializer;
+                symbol_t *sym;      // declared by the typer.
             } decl;
         } e;
         union {
-            struct node_t_ *block;  // STMT_BLOCK
+            struct stmt_block {     // STMT_BLOCK
+                struct node_t_ *stmt;
+                symbol_table_t *symtbl;
+            } block;
             struct node_t_ *expr;   // STMT_EXPR, STMT_DECL
             struct {                // STMT_BRANCH
                 struct node_t_ *expr;
@@ -86,16 +111,25 @@ typedef struct node_t_ {
             } ret;
             struct stmt_func {      // STMT_FUNC
                 string_t *name;     // function name.
+                int rtype;          // type id of a returned value.
                 struct node_t_ *args;
                 struct node_t_ *block;
+                symbol_t *sym;
+                symbol_table_t *symtbl;
+                enum func_body_state state;
+                size_t body;        // position of a skipped body.
             } func;
         } s;
     } n;
-
-    symbol_t *sym;
-    symbol_table_t *symtbl;
 } node_t;
 
+/* Nodes are allocated from chunks by bumping an index, and released at once. */
+typedef struct node_chunk_t_ {
+    struct node_chunk_t_ *next;
+    int used;                       // in words.
+    int64_t word[NODE_CHUNK_WORDS];
+} node_chunk_t;
+
 extern void node_free_all(node_manager_t *mgr);
 extern node_t *node_connect(node_t *prev, node_t *next);
 
@@ -117,8 +151,9 @@ extern node_t *ast_for_loop_statement(node_manager_t *mgr, node_t *expr1, node_t
 extern node_t *ast_precond_loop_statement(node_manager_t *mgr, node_t *expr, node_t *then_clause);
 extern node_t *ast_postcond_loop_statement(node_manager_t *mgr, node_t *expr, node_t *then_clause);
 extern node_t *ast_return_statement(node_manager_t *mgr, node_t *expr, node_t *if_modifier);
-extern node_t *ast_function_statement(node_manager_t *mgr, int64_t type, string_t *name, node_t *args, node_t *block);
+extern node_t *ast_function_statement(node_manager_t *mgr, int rtype, string_t *name, node_t *args, node_t *block);
 
+extern node_t *ast_lazy_function_statement(node_manager_t *mgr, int rtype, string_t *name, node_t *args, size_t body);
 extern node_t *ast_builtin_function(node_manager_t *mgr, const char *name);
 
 #define SHOW_INDENT(indent) for (int i = 0; i < indent; i++) printf("  ")
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <string.h>
+#include "pass.h"
+
+void ast_pass_manager_init(ast_pass_manager_t *pm, node_t **root)
+{
+    memset(pm, 0, sizeof(ast_pass_manager_t));
+    pm->root = root;
+}
+
+void ast_pass_manager_free(ast_pass_manager_t *pm)
+{
+    free(pm->pass);
+    ast_walker_free(&(pm->walker));
+    memset(pm, 0, sizeof(ast_pass_manager_t));
+}
+
+void ast_pass_add(ast_pass_manager_t *pm, const ast_pass_t *pass)
+{
+    if (pm->count == pm->cap) {
+        pm->cap = pm->cap ? pm->cap * 2 : 8;
+        pm->pass = (ast_pass_t *)realloc(pm->pass, pm->cap * sizeof(ast_pass_t));
+    }
+    pm->pass[pm->count++] = *pass;
+}
+
+static node_t *ast_pass_visit(ast_pass_t *group, int count, node_t *node)
+{
+    unsigned kind = AST_PASS_KIND(node->ntype);
+    for (int i = 0; node && i < count; ++i) {
+        if (group[i].kinds & kind) {
+            node = group[i].visit(group[i].arg, node);
+            kind = node ? AST_PASS_KIND(node->ntype) : 0;
+        }
+    }
+    return node;
+}
+
+/* One post-order walk for all visitors in a group, a frame keeps the slot which points to its node. */
+static void ast_pass_walk(ast_pass_manager_t *pm, ast_pass_t *group, int count)
+{
+    unsigned kinds = 0;
+    for (int i = 0; i < count; ++i) {
+        kinds |= group[i].kinds;
+    }
+
+    ast_walker_t *w = &(pm->walker);
+    ast_walker_push(w, *(pm->root), 0);
+    ast_walker_top(w)->saved = pm->root;
+
+    while (w->count > 0) {
+        ast_frame_t *f = ast_walker_top(w);
+        node_t *node = f->node;
+        if (!node) {
+            ast_walker_pop(w);
+            continue;
+        }
+
+        node_t **slot;
+        while ((slot = ast_child_slot(node, f->state)) != NULL) {
+            ++f->state;
+            if (*slot) {
+                ast_walker_push(w, *slot, 0);
+                ast_walker_top(w)->saved = slot;
+                goto NEXT;
+            }
+        }
+
+        slot = (node_t **)f->saved;
+        if (kinds & AST_PASS_KIND(node->ntype)) {
+            node_t *r = ast_pass_visit(group, count, node);
+            if (r != node) {
+                if (r) {
+                    r->next = node->next;
+                    *slot = r;
+                } else {
+                    *slot = node->next;
+                    f->node = node->next;
+                    f->state = 0;
+                    continue;
+                }
+                node = r;
+            }
+        }
+        if (node->next) {
+            f->node = node->next;
+            f->saved = &(node->next);
+            f->state = 0;
+            continue;
+        }
+        ast_walker_pop(w);
+NEXT:;
+    }
+    ++pm->walks;
+}
+
+static int ast_pass_check(ast_pass_manager_t *pm, ast_pass_t *pass)
+{
+    if (pass->requires & ~pm->valid) {
+        fprintf(stderr, "pass %s: a required analysis is not valid\n", pass->name);
+        return 0;
+    }
+    return 1;
+}
+
+static void ast_pass_update(ast_pass_manager_t *pm, ast_pass_t *pass)
+{
+    pm->valid &= ~pass->invalidates;
+    pm->valid |= pass->provides;
+}
+
+int ast_pass_run(ast_pass_manager_t *pm)
+{
+    int i = 0;
+    while (i < pm->count) {
+        ast_pass_t *pass = &(pm->pass[i]);
+        if (!ast_pass_check(pm, pass)) {
+            return 1;
+        }
+        if (!pass->kinds) {
+            int r = pass->run(pass->arg);
+            if (r != 0) {
+                return r;
+            }
+            ast_pass_update(pm, pass);
+            ++i;
+            continue;
+        }
+
+        /*
+            A visitor joins the group if what it requires is valid before the walk and not broken
+            by the group, and if it does not break what the group requires.
+        */
+        unsigned requires = pass->requires;
+        unsigned invalidates = pass->invalidates;
+        int j = i + 1;
+        while (j < pm->count) {
+            ast_pass_t *next = &(pm->pass[j]);
+            if (!next->kinds || (next->requires & ~pm->valid) || (next->requires & invalidates) ||
+                    (next->invalidates & requires)) {
+                break;
+            }
+            requires |= next->requires;
+            invalidates |= next->invalidates;
+            ++j;
+        }
+
+        for (int k = i; k < j; ++k) {
+            if (pm->pass[k].begin) {
+                pm->pass[k].begin(pm->pass[k].arg);
+            }
+        }
+        ast_pass_walk(pm, &(pm->pass[i]), j - i);
+        for (int k = i; k < j; ++k) {
+            if (pm->pass[k].end) {
+                int r = pm->pass[k].end(pm->pass[k].arg);
+                if (r != 0) {
+                    return r;
+                }
+            }
+            ast_pass_update(pm, &(pm->pass[k]));
+        }
+        i = j;
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+#ifndef KISS_PASS_H
+#define KISS_PASS_H
+
+#include "node.h"
+#include "walk.h"
+
+/*
+    Pass manager, passes run in the order of registration.
+    A visitor pass declares node types to visit, and consecutive visitor passes are fused
+    into one walk of the tree as long as one does not break an analysis another one requires.
+    A pass with run() walks by itself, and it is a boundary of fusion.
+*/
+enum ast_analysis {
+    AST_ANALYSIS_TYPES = 1 << 0,    // node types, symbol tables and the list of functions.
+    AST_ANALYSIS_IR = 1 << 1,       // the SSA IR lowered from the tree.
+};
+
+#define AST_PASS_KIND(ntype) (1u << (ntype))
+#define AST_PASS_EXPR_KINDS \
+    (AST_PASS_KIND(EXPR_INT) | AST_PASS_KIND(EXPR_DBL) | AST_PASS_KIND(EXPR_STR) | AST_PASS_KIND(EXPR_VAR) | \
+     AST_PASS_KIND(EXPR_CALL) | AST_PASS_KIND(EXPR_UNARY) | AST_PASS_KIND(EXPR_BINARY) | AST_PASS_KIND(EXPR_DECL) | \
+     AST_PASS_KIND(EXPR_CAST))
+#define AST_PASS_STMT_KINDS \
+    (AST_PASS_KIND(STMT_EXPR) | AST_PASS_KIND(STMT_BLOCK) | AST_PASS_KIND(STMT_BRANCH) | AST_PASS_KIND(STMT_PRELOOP) | \
+     AST_PASS_KIND(STMT_PSTLOOP) | AST_PASS_KIND(STMT_RET) | AST_PASS_KIND(STMT_FUNC))
+
+typedef struct ast_pass_ {
+    const char *name;
+    unsigned kinds;                 // node types to visit, 0 for a pass with run().
+    unsigned requires;              // analyses which must be valid before the pass.
+    unsigned provides;              // analyses made valid by the pass.
+    unsigned invalidates;           // analyses broken by the pass.
+
+    int (*run)(void *arg);
+    void (*begin)(void *arg);
+    /*
+        A node is visited after its children. A visitor returns a node to be placed instead of it,
+        which takes over the next sibling, or NULL to remove it from a list.
+        Passes later in the same walk visit the replacement.
+    */
+    node_t *(*visit)(void *arg, node_t *node);
+    int (*end)(void *arg);
+    void *arg;
+} ast_pass_t;
+
+typedef struct ast_pass_manager_ {
+    ast_pass_t *pass;
+    int count;
+    int cap;
+    node_t **root;                  // a pass can replace the root.
+    unsigned valid;                 // analyses valid now.
+    int walks;                      // the number of walks done by the manager.
+    ast_walker_t walker;
+} ast_pass_manager_t;
+
+extern void ast_pass_manager_init(ast_pass_manager_t *pm, node_t **root);
+extern void ast_pass_manager_free(ast_pass_manager_t *pm);
+extern void ast_pass_add(ast_pass_manager_t *pm, const ast_pass_t *pass);
+extern int ast_pass_run(ast_pass_manager_t *pm);
+
+#endif /* KISS_PASS_H */
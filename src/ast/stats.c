@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <string.h>
+#include "stats.h"
+
+static const char *get_node_type_name(int ntype)
+{
+    switch (ntype) {
+    case EXPR_INT: return "int";
+    case EXPR_DBL: return "dbl";
+    case EXPR_STR: return "str";
+    case EXPR_VAR: return "variable";
+    case EXPR_CALL: return "call";
+    case EXPR_UNARY: return "unary";
+    case EXPR_BINARY: return "binary";
+    case EXPR_DECL: return "declaration";
+    case EXPR_CAST: return "cast";
+    case STMT_EXPR: return "expression";
+    case STMT_BLOCK: return "block";
+    case STMT_BRANCH: return "branch";
+    case STMT_PRELOOP: return "pre-condition-loop";
+    case STMT_PSTLOOP: return "post-condition-loop";
+    case STMT_RET: return "return";
+    case STMT_FUNC: return "function";
+    default:
+        ;
+    }
+    return "((unknown))";
+}
+
+static void ast_stats_begin(void *arg)
+{
+    memset(arg, 0, sizeof(ast_stats_t));
+}
+
+static node_t *ast_stats_visit(void *arg, node_t *node)
+{
+    ast_stats_t *stats = (ast_stats_t *)arg;
+    ++stats->count[node->ntype];
+    ++stats->total;
+    return node;
+}
+
+static int ast_stats_end(void *arg)
+{
+    ast_stats_t *stats = (ast_stats_t *)arg;
+    fprintf(stderr, "nodes: %d\n", stats->total);
+    for (int i = 0; i <= STMT_FUNC; ++i) {
+        if (stats->count[i] > 0) {
+            fprintf(stderr, "  %-20s %d\n", get_node_type_name(i), stats->count[i]);
+        }
+    }
+    return 0;
+}
+
+ast_pass_t ast_stats_pass(ast_stats_t *stats)
+{
+    ast_pass_t pass = {
+        .name = "stats",
+        .kinds = AST_PASS_EXPR_KINDS | AST_PASS_STMT_KINDS,
+        .begin = ast_stats_begin,
+        .visit = ast_stats_visit,
+        .end = ast_stats_end,
+        .arg = stats,
+    };
+    return pass;
+}
@@ -0,0 +1,14 @@
+#ifndef KISS_STATS_H
+#define KISS_STATS_H
+
+#include "pass.h"
+
+/* Counts of nodes by node types, which are printed to stderr at the end of the pass. */
+typedef struct ast_stats_ {
+    int count[STMT_FUNC + 1];
+    int total;
+} ast_stats_t;
+
+extern ast_pass_t ast_stats_pass(ast_stats_t *stats);
+
+#endif /* KISS_STATS_H */
@@ -1,23 +1,16 @@
 #include "symbol.h"
 #include "node.h"
 
-static symbol_t *symbol_new(const char *name, types_t type)
+static symbol_t *symbol_new(string_t *name, int type)
 {
     symbol_t *sym = (symbol_t *)calloc(1, sizeof(symbol_t));
-    sym->name = string_new(name);
+    sym->name = name;
     sym->type = type;
     return sym;
 }
 
 static void symbol_free(symbol_t *sym)
 {
-    if (sym->argtypes) {
-        list_free(sym->argtypes);
-    }
-    if (sym->type.argtypes) {
-        list_free(sym->type.argtypes);
-    }
-    string_free(sym->name);
     free(sym);
 }
 
@@ -36,25 +29,66 @@ void symbol_table_free(symbol_table_t *symtbl)
         symbol_free(sym);
         sym = next;
     }
+    free(symtbl->hash);
+    free(symtbl);
 }
 
-static symbol_t *symbol_search_one(symbol_table_t *symtbl, const char *name)
+static unsigned symbol_hash(string_t *name)
 {
-    symbol_t *sym = symtbl->symbol;
-    while (sym) {
-        if (!strcmp(sym->name->p, name)) {
+    return (unsigned)(((uintptr_t)name >> 3) * 2654435761u);
+}
+
+static void symbol_hash_insert(symbol_table_t *symtbl, symbol_t *sym)
+{
+    unsigned mask = (unsigned)symtbl->hsize - 1;
+    unsigned i = symbol_hash(sym->name) & mask;
+    while (symtbl->hash[i]) {
+        i = (i + 1) & mask;
+    }
+    symtbl->hash[i] = sym;
+}
+
+static void symbol_hash_rebuild(symbol_table_t *symtbl)
+{
+    free(symtbl->hash);
+    symtbl->hsize = symtbl->hsize ? symtbl->hsize * 2 : SYMBOL_TABLE_LINEAR_MAX * 4;
+    symtbl->hash = (symbol_t **)calloc(symtbl->hsize, sizeof(symbol_t *));
+    for (symbol_t *sym = symtbl->symbol; sym; sym = sym->next) {
+        symbol_hash_insert(symtbl, sym);
+    }
+}
+
+/* Only in the scope, not in parents. */
+symbol_t *symbol_search_one(symbol_table_t *symtbl, string_t *name)
+{
+    if (!symtbl->hash) {
+        symbol_t *sym = symtbl->symbol;
+        while (sym) {
+            if (sym->name == name) {
+                return sym;
+            }
+            sym = sym->next;
+        }
+        return NULL;
+    }
+
+    unsigned mask = (unsigned)symtbl->hsize - 1;
+    unsigned i = symbol_hash(name) & mask;
+    symbol_t *sym;
+    while ((sym = symtbl->hash[i]) != NULL) {
+        if (sym->name == name) {
             return sym;
         }
-        sym = sym->next;
+        i = (i + 1) & mask;
     }
     return NULL;
 }
 
-symbol_t *symbol_add(symbol_table_t *symtbl, const char *name, types_t type)
+symbol_t *symbol_add(symbol_table_t *symtbl, string_t *name, int type)
 {
     symbol_t *sym = symbol_search_one(symtbl, name);
     if (sym) {
-        if (sym->type.vtype != VALTYPE_UNKNOWN && sym->type.vtype != type.vtype) {
+        if (sym->type != VALTYPE_UNKNOWN && sym->type != type) {
             // TODO: error.
             ;
         }
@@ -64,10 +98,16 @@ symbol_t *symbol_add(symbol_table_t *symtbl, const char *name, types_t type)
     sym = symbol_new(name, type);
     sym->next = symtbl->symbol;
     symtbl->symbol = sym;
+    ++symtbl->count;
+    if (symtbl->hash && symtbl->count * 2 <= symtbl->hsize) {
+        symbol_hash_insert(symtbl, sym);
+    } else if (symtbl->count > SYMBOL_TABLE_LINEAR_MAX) {
+        symbol_hash_rebuild(symtbl);
+    }
     return sym;
 }
 
-symbol_t *symbol_search(symbol_table_t *symtbl, const char *name)
+symbol_t *symbol_search(symbol_table_t *symtbl, string_t *name)
 {
     symbol_t *sym = symbol_search_one(symtbl, name);
     while (!sym) {
@@ -79,59 +119,3 @@ symbol_t *symbol_search(symbol_table_t *symtbl, const char *name)
     }
     return sym;
 }
-
-int symbol_get_argcount(symbol_t *sym)
-{
-    if (!sym->argtypes) {
-        return 0;
-    }
-    int count = 0;
-    listitem_t *l = sym->argtypes->head;
-    while (l) {
-        ++count;
-        l = l->next;
-    }
-    return count;
-}
-
-types_t list_get_argtype(list_t *argtypes, int index)
-{
-    if (!argtypes) {
-        return (types_t){0};
-    }
-
-    listitem_t *l1 = list_get(argtypes, index);
-    if (!l1) {
-        return (types_t){0};
-    }
-
-    return *(types_t*)(l1->item);
-}
-
-void free_hook(void *p)
-{
-    free(p);
-}
-
-list_t *list_add_argtype(list_t *argtypes, types_t type)
-{
-    if (!argtypes) {
-        return NULL;
-    }
-
-    types_t *typep = (types_t *)calloc(1, sizeof(types_t));
-    memcpy(typep, &type, sizeof(types_t));
-    list_push(argtypes, typep, free_hook);
-    return argtypes;
-}
-
-symbol_t *symbol_add_argtype(symbol_t *sym, types_t type)
-{
-    if (!sym->argtypes) {
-        sym->argtypes = list_new();
-    }
-    types_t *typep = (types_t *)calloc(1, sizeof(types_t));
-    memcpy(typep, &type, sizeof(types_t));
-    list_push(sym->argtypes, typep, free_hook);
-    return sym;
-}
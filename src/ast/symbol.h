@@ -3,42 +3,35 @@
 
 #include <stdint.h>
 #include "xstring.h"
-#include "xlist.h"
-
-enum value_type {
-    VALTYPE_UNKNOWN,
-    VALTYPE_INT,
-    VALTYPE_DBL,
-    VALTYPE_STR,
-    VALTYPE_FUNC,
-    VALTYPE_VA,
-};
-
-typedef struct vtypes_ {
-    enum value_type vtype;
-    enum value_type rtype;
-    list_t *argtypes;   // TODO: to be copyable.
-} types_t;
+#include "types.h"
 
 typedef struct symbol_ {
     struct symbol_ *next;
     string_t *name;
-    types_t type;
-    list_t *argtypes;
+    int type;               // type id.
+    struct node_t_ *func;   // definition if it is a function.
+    int slot;               // index given by a backend, 0 while not given.
+    int mark;               // used by analyses.
 } symbol_t;
 
+/*
+    Symbols are keyed by an interned name, so names are compared by a pointer.
+    A scope is searched linearly while it is small, and by a hash table after that.
+*/
+#define SYMBOL_TABLE_LINEAR_MAX (8)
+
 typedef struct symbol_table_ {
     struct symbol_table_ *parent;
-    symbol_t *symbol;
+    symbol_t *symbol;       // all symbols, the latest one first.
+    int count;
+    symbol_t **hash;        // open addressing by a name pointer, NULL while small.
+    int hsize;
 } symbol_table_t;
 
 extern symbol_table_t *symbol_table_new(symbol_table_t *parent);
 extern void symbol_table_free(symbol_table_t *symtbl);
-extern symbol_t *symbol_add(symbol_table_t *symtbl, const char *name, types_t type);
-extern symbol_t *symbol_search(symbol_table_t *symtbl, const char *name);
-
-extern symbol_t *symbol_add_argtype(symbol_t *sym, types_t type);
-extern list_t *list_add_argtype(list_t *argtypes, types_t type);
-extern types_t list_get_argtype(list_t *argtypes, int index);
+extern symbol_t *symbol_add(symbol_table_t *symtbl, string_t *name, int type);
+extern symbol_t *symbol_search(symbol_table_t *symtbl, string_t *name);
+extern symbol_t *symbol_search_one(symbol_table_t *symtbl, string_t *name);
 
 #endif /* KISS_SYMBOL_H */
@@ -1,166 +1,345 @@
 #include "typep.h"
-
-#define CHECKNEXT(node) if (node->next) { node = node->next; goto TOP; }
+#include "walk.h"
 
 typedef struct ast_type_context_ {
     symbol_t *funcdecl;
     symbol_table_t *symtbl;
-    list_t *funcs;
+    vector_t *funcs;
+    type_table_t *types;
+    int *args;              // argument types of the function being declared.
+    int argc;
+    int argcap;
+    symbol_table_t *fscope; // scope of arguments of the function being typed, NULL at the top level.
+    vector_t *late;         // names not found when typed, and their fscope, see resolve_late().
+
+    /* only for the lazy mode. */
+    int (*load)(void *arg, node_t *func);
+    void *arg;
+    vector_t *requested;    // functions whose bodies are to be parsed.
+    symbol_table_t *unresolved; // names used before the definition.
+
+    ast_walker_t walker;
 } ast_type_context_t;
 
-static symbol_t *add_symbol_to_table(ast_type_context_t *ctx, const char *name, types_t type)
+static symbol_t *add_symbol_to_table(ast_type_context_t *ctx, string_t *name, int type)
 {
     return symbol_add(ctx->symtbl, name, type);
 }
 
-static types_t get_type_from_symbol_table(ast_type_context_t *ctx, const char *name)
+static void add_argument_type(ast_type_context_t *ctx, int type)
 {
-    symbol_table_t *symtbl = ctx->symtbl;
-    symbol_t *sym = symbol_search(symtbl, name);
-    if (sym) {
-        return sym->type;
+    if (ctx->argc == ctx->argcap) {
+        ctx->argcap = ctx->argcap ? ctx->argcap * 2 : 8;
+        ctx->args = (int *)realloc(ctx->args, ctx->argcap * sizeof(int));
     }
-    return (types_t){0};
+    ctx->args[ctx->argc++] = type;
 }
 
-static types_t ast_type_item(node_t *node, ast_type_context_t *ctx)
+static void request_function(ast_type_context_t *ctx, node_t *func)
 {
-    types_t type = {0};
-    if (!node) {
-        return type;
+    if (func && func->n.s.func.state == FUNC_BODY_SKIPPED) {
+        func->n.s.func.state = FUNC_BODY_REQUESTED;
+        vector_push(ctx->requested, (void*)func, NULL);
     }
+}
 
-TOP:;
-    switch (node->ntype) {
-    /* dump expression. */
-    case EXPR_INT: {
-        type = (types_t){ .vtype = VALTYPE_INT };
-        break;
-    }
-    case EXPR_DBL: {
-        type = (types_t){ .vtype = VALTYPE_DBL };
-        break;
-    }
-    case EXPR_STR: {
-        type = (types_t){ .vtype = VALTYPE_STR };
-        break;
-    }
-    case EXPR_VAR: {
-        if (!node->vtype.argtypes) {
-            node->vtype = get_type_from_symbol_table(ctx, node->n.name->p);
+static void resolve_variable(ast_type_context_t *ctx, node_t *node)
+{
+    symbol_t *sym = symbol_search(ctx->symtbl, node->n.e.var.name);
+    node->n.e.var.sym = sym;
+    if (sym) {
+        node->type = sym->type;
+        if (ctx->load) {
+            request_function(ctx, sym->func);
         }
-        type = (types_t){ .vtype = node->vtype.vtype, .rtype = node->vtype.rtype };
-        break;
+        return;
     }
-    case EXPR_CALL: {
-        type = ast_type_item(node->n.e.call.func, ctx);
-        if (type.vtype == VALTYPE_FUNC) {
-            type = node->vtype = (types_t) { .vtype = type.rtype };
-        } else {
-            node->vtype = type;
-        }
-        (void)ast_type_item(node->n.e.call.args, ctx);
-        node_t *next = node->n.e.call.args->next;
-        while (next) {
-            ast_type_item(next, ctx);
-            next = next->next;
-        }
-        break;
+    vector_push(ctx->late, (void*)node, NULL);
+    vector_push(ctx->late, (void*)ctx->fscope, NULL);
+    if (ctx->load) {
+        symbol_add(ctx->unresolved, node->n.e.var.name, VALTYPE_UNKNOWN);
     }
-    case EXPR_BINARY: {
-        types_t ltype = ast_type_item(node->n.e.binary.lhs, ctx);
-        types_t rtype = ast_type_item(node->n.e.binary.rhs, ctx);
-        if (ltype.vtype == rtype.vtype) {
-            node->vtype = type = ltype;
-        } else {
-            // TODO: cast.
-        }
-        break;
+}
+
+/*
+    A name used before its declaration refers to a global or a function declared later,
+    as the lowering does, so it is looked up from the scope out of its function.
+    A local of the function declared later is not visible there. Only the symbol is given,
+    and the type is left unknown.
+*/
+static void resolve_late(ast_type_context_t *ctx, symbol_table_t *global)
+{
+    for (int i = 0; i < ctx->late->count; i += 2) {
+        node_t *node = (node_t *)vector_get(ctx->late, i);
+        symbol_table_t *fscope = (symbol_table_t *)vector_get(ctx->late, i + 1);
+        symbol_table_t *scope = fscope ? fscope->parent : global;
+        node->n.e.var.sym = scope ? symbol_search(scope, node->n.e.var.name) : NULL;
     }
-    case EXPR_DECL: {
-        symbol_t *sym = add_symbol_to_table(ctx, node->n.e.decl.name->p, node->vtype);
-        if (ctx->funcdecl) {
-            symbol_add_argtype(ctx->funcdecl, node->vtype);
+}
+
+static int ast_type_item(node_t *root, ast_type_context_t *ctx)
+{
+    ast_walker_t *w = &(ctx->walker);
+    int base = w->count;
+    int type = VALTYPE_UNKNOWN;     // a type of the last finished node.
+    ast_walker_push(w, root, 0);
+
+    while (w->count > base) {
+        ast_frame_t *f = ast_walker_top(w);
+        node_t *node = f->node;
+        type = VALTYPE_UNKNOWN;
+        if (!node) {
+            ast_walker_finish(w, type);
+            continue;
         }
-        ast_type_item(node->n.e.decl.initializer, ctx);
-        if (node->next) {
-            ast_type_item(node->next, ctx);
+
+        switch (node->ntype) {
+        /* type expression. */
+        case EXPR_INT: {
+            type = VALTYPE_INT;
+            break;
+        }
+        case EXPR_DBL: {
+            type = VALTYPE_DBL;
+            break;
+        }
+        case EXPR_STR: {
+            type = VALTYPE_STR;
+            break;
+        }
+        case EXPR_VAR: {
+            if (node->type == VALTYPE_UNKNOWN) {
+                resolve_variable(ctx, node);
+            }
+            type = node->type;
+            break;
+        }
+        case EXPR_CALL: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.e.call.func, 0);
+            case 1: {
+                int ftype = ast_walker_last(w);
+                type_t *t = type_get(ctx->types, ftype);
+                node->type = f->value = (t->vtype == VALTYPE_FUNC) ? t->rtype : ftype;
+                f->saved = node->n.e.call.args;
+            }
+                /* fallthrough */
+            default:
+                if (f->saved) {
+                    node_t *arg = (node_t *)f->saved;
+                    f->saved = arg->next;
+                    WALK(2, arg, 0);
+                }
+                type = f->value;
+            }
+            break;
+        }
+        case EXPR_BINARY: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.e.binary.lhs, 0);
+            case 1:
+                f->value = ast_walker_last(w);
+                WALK(2, node->n.e.binary.rhs, 0);
+            default:
+                if (f->value == ast_walker_last(w)) {
+                    node->type = type = f->value;
+                } else {
+                    // TODO: cast.
+                }
+            }
+            break;
+        }
+        case EXPR_DECL: {
+            /* the initializer is typed first, where the name refers to an outer one. */
+            if (f->state == 0) {
+                WALK(1, node->n.e.decl.initializer, 0);
+            }
+            node->n.e.decl.sym = add_symbol_to_table(ctx, node->n.e.decl.name, node->type);
+            if (ctx->funcdecl) {
+                add_argument_type(ctx, node->type);
+            }
+            WALKNEXT(node);
+            break;
         }
-        break;
-    }
 
-    /* dump statement, note that a statement can have a next statement. */
-    case STMT_EXPR: {
-        ast_type_item(node->n.s.expr, ctx);
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_BLOCK: {
-        ctx->symtbl = node->symtbl = symbol_table_new(ctx->symtbl);
-        ast_type_item(node->n.s.block, ctx);
-        ctx->symtbl = ctx->symtbl->parent;
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_BRANCH: {
-        ast_type_item(node->n.s.branch.expr, ctx);
-        ast_type_item(node->n.s.branch.then_cloause, ctx);
-        if (node->n.s.branch.else_cloause) {
-            ast_type_item(node->n.s.branch.else_cloause, ctx);
-        }
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_PRELOOP: {
-        if (node->n.s.loop.e1) {
-            ast_type_item(node->n.s.loop.e1, ctx);
+        /* type statement, note that a statement can have a next statement. */
+        case STMT_EXPR: {
+            if (f->state == 0) {
+                WALK(1, node->n.s.expr, 0);
+            }
+            WALKNEXT(node);
+            break;
         }
-        if (node->n.s.loop.e2) {
-            ast_type_item(node->n.s.loop.e2, ctx);
+        case STMT_BLOCK: {
+            if (f->state == 0) {
+                ctx->symtbl = node->n.s.block.symtbl = symbol_table_new(ctx->symtbl);
+                WALK(1, node->n.s.block.stmt, 0);
+            }
+            ctx->symtbl = ctx->symtbl->parent;
+            WALKNEXT(node);
+            break;
         }
-        ast_type_item(node->n.s.loop.e2, ctx);
-        if (node->n.s.loop.e3) {
-            ast_type_item(node->n.s.loop.e3, ctx);
+        case STMT_BRANCH: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.s.branch.expr, 0);
+            case 1:
+                WALK(2, node->n.s.branch.then_cloause, 0);
+            case 2:
+                WALK(3, node->n.s.branch.else_cloause, 0);
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
         }
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_PSTLOOP: {
-        ast_type_item(node->n.s.loop.e2, ctx);
-        if (node->n.s.loop.e2) {
-            ast_type_item(node->n.s.loop.e2, ctx);
+        case STMT_PRELOOP: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.s.loop.e1, 0);
+            case 1:
+                WALK(2, node->n.s.loop.e2, 0);
+            case 2:
+                WALK(3, node->n.s.loop.then_cloause, 0);
+            case 3:
+                WALK(4, node->n.s.loop.e3, 0);
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
         }
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_RET: {
-        ast_type_item(node->n.s.ret.expr, ctx);
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_FUNC: {
-        list_push(ctx->funcs, (void*)node, NULL);
-        node->sym = add_symbol_to_table(ctx, node->n.s.func.name->p, node->vtype);
-        ctx->symtbl = node->symtbl = symbol_table_new(ctx->symtbl);
-        symbol_t *fsym = ctx->funcdecl;
-        ctx->funcdecl = node->sym;
-        ast_type_item(node->n.s.func.args, ctx);
-        ctx->funcdecl = fsym;
-        ast_type_item(node->n.s.func.block, ctx);
-        ctx->symtbl = ctx->symtbl->parent;
-        CHECKNEXT(node);
-        break;
+        case STMT_PSTLOOP: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.s.loop.then_cloause, 0);
+            case 1:
+                WALK(2, node->n.s.loop.e2, 0);
+            default:
+                ;
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_RET: {
+            if (f->state == 0) {
+                WALK(1, node->n.s.ret.expr, 0);
+            }
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_FUNC: {
+            switch (f->state) {
+            case 0: {
+                vector_push(ctx->funcs, (void*)node, NULL);
+                symbol_t *sym = node->n.s.func.sym = add_symbol_to_table(ctx, node->n.s.func.name, node->type);
+                if (!sym->func) {
+                    sym->func = node;
+                }
+                ctx->symtbl = node->n.s.func.symtbl = symbol_table_new(ctx->symtbl);
+                f->saved = ctx->funcdecl;
+                ctx->funcdecl = sym;
+                ctx->argc = 0;
+                WALK(1, node->n.s.func.args, 0);
+            }
+            case 1: {
+                symbol_t *sym = node->n.s.func.sym;
+                ctx->funcdecl = (symbol_t *)f->saved;
+                if (sym->type == VALTYPE_FUNC) {
+                    node->type = sym->type = type_function(ctx->types, node->n.s.func.rtype, ctx->argc, ctx->args);
+                }
+                f->saved = ctx->fscope;
+                ctx->fscope = node->n.s.func.symtbl;
+                WALK(2, node->n.s.func.block, 0);
+            }
+            default:
+                ctx->fscope = (symbol_table_t *)f->saved;
+            }
+            ctx->symtbl = ctx->symtbl->parent;
+            WALKNEXT(node);
+            break;
+        }
+        default:
+            ;
+        }
+
+        ast_walker_finish(w, type);
+NEXT:;
     }
-    default:
-        ;
+
+    return ast_walker_last(w);
+}
+
+/*
+    Functions used by the code typed so far are parsed and typed, until no more function is found.
+    A name not found in a scope may be a function defined after it, so it is also looked up
+    among the skipped functions.
+*/
+static void ast_type_requested(ast_type_context_t *ctx)
+{
+    for ( ; ; ) {
+        if (ctx->unresolved->count > 0) {
+            for (int i = 0; i < ctx->funcs->count; ++i) {
+                node_t *func = (node_t *)vector_get(ctx->funcs, i);
+                if (func->n.s.func.state == FUNC_BODY_SKIPPED && symbol_search(ctx->unresolved, func->n.s.func.name)) {
+                    request_function(ctx, func);
+                }
+            }
+            symbol_table_free(ctx->unresolved);
+            ctx->unresolved = symbol_table_new(NULL);
+        }
+        if (ctx->requested->count == 0) {
+            break;
+        }
+
+        node_t *func = (node_t *)vector_get(ctx->requested, ctx->requested->count - 1);
+        vector_pop(ctx->requested);
+        if (ctx->load(ctx->arg, func) != 0) {
+            continue;
+        }
+        symbol_table_t *symtbl = ctx->symtbl;
+        ctx->symtbl = ctx->fscope = func->n.s.func.symtbl;
+        ast_type_item(func->n.s.func.block, ctx);
+        ctx->symtbl = symtbl;
+        ctx->fscope = NULL;
     }
+}
 
-    return type;
+vector_t *ast_type(type_table_t *types, node_t *root)
+{
+    ast_type_context_t ctx = { .funcdecl = NULL, .symtbl = NULL, .funcs = vector_new(), .types = types, .late = vector_new() };
+    ast_type_item(root, &ctx);
+    resolve_late(&ctx, root->n.s.block.symtbl);
+    vector_free(ctx.late);
+    ast_walker_free(&(ctx.walker));
+    free(ctx.args);
+    return ctx.funcs;
 }
 
-list_t *ast_type(node_t *root)
+/*
+    Only the top level code, exported functions and functions reachable from them are typed.
+    A function is reached by a name anywhere in typed code, including conditions and bodies of loops,
+    so the typer must walk every child of a statement or a function called there is not emitted.
+    Skipped bodies are parsed by load(), and a function not reachable keeps FUNC_BODY_SKIPPED.
+*/
+vector_t *ast_type_lazy(type_table_t *types, node_t *root, vector_t *exports, int (*load)(void *arg, node_t *func), void *arg)
 {
-    ast_type_context_t ctx = { .funcdecl = NULL, .symtbl = NULL, .funcs = list_new() };
+    ast_type_context_t ctx = {
+        .funcdecl = NULL, .symtbl = NULL, .funcs = vector_new(), .types = types,
+        .load = load, .arg = arg, .requested = vector_new(), .unresolved = symbol_table_new(NULL), .late = vector_new(),
+    };
+    for (int i = 0; exports && i < exports->count; ++i) {
+        symbol_add(ctx.unresolved, (string_t *)vector_get(exports, i), VALTYPE_UNKNOWN);
+    }
     ast_type_item(root, &ctx);
+    ast_type_requested(&ctx);
+    resolve_late(&ctx, root->n.s.block.symtbl);
+    vector_free(ctx.late);
+    symbol_table_free(ctx.unresolved);
+    vector_free(ctx.requested);
+    ast_walker_free(&(ctx.walker));
+    free(ctx.args);
     return ctx.funcs;
 }
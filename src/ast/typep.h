@@ -1,10 +1,11 @@
 #ifndef KISS_TYPE_H
 #define KISS_TYPE_H
 
-#include "xlist.h"
+#include "xvector.h"
 #include "symbol.h"
 #include "node.h"
 
-extern list_t *ast_type(node_t *root);
+extern vector_t *ast_type(type_table_t *types, node_t *root);
+extern vector_t *ast_type_lazy(type_table_t *types, node_t *root, vector_t *exports, int (*load)(void *arg, node_t *func), void *arg);
 
 #endif /* KISS_TYPE_H */
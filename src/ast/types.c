@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include "types.h"
+
+static unsigned type_hash(enum value_type vtype, int rtype, int argc, const int *args)
+{
+    unsigned h = 2166136261u;
+    h = (h ^ (unsigned)vtype) * 16777619u;
+    h = (h ^ (unsigned)rtype) * 16777619u;
+    h = (h ^ (unsigned)argc) * 16777619u;
+    for (int i = 0; i < argc; ++i) {
+        h = (h ^ (unsigned)args[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void type_hash_insert(type_table_t *types, int id)
+{
+    unsigned mask = (unsigned)types->hsize - 1;
+    unsigned i = types->type[id].hash & mask;
+    while (types->hash[i]) {
+        i = (i + 1) & mask;
+    }
+    types->hash[i] = id + 1;
+}
+
+static int type_register(type_table_t *types, enum value_type vtype, int rtype, int argc, const int *args, unsigned hash)
+{
+    if (types->count == types->cap) {
+        types->cap = types->cap ? types->cap * 2 : TYPE_TABLE_UNIT;
+        types->type = (type_t *)realloc(types->type, types->cap * sizeof(type_t));
+    }
+    if ((types->count + 1) * 2 > types->hsize) {
+        free(types->hash);
+        types->hsize = types->hsize ? types->hsize * 2 : TYPE_TABLE_UNIT * 2;
+        types->hash = (int *)calloc(types->hsize, sizeof(int));
+        for (int i = 0; i < types->count; ++i) {
+            type_hash_insert(types, i);
+        }
+    }
+
+    int id = types->count++;
+    type_t *t = &(types->type[id]);
+    t->vtype = vtype;
+    t->rtype = rtype;
+    t->argc = argc;
+    t->args = NULL;
+    if (argc > 0) {
+        t->args = (int *)malloc(argc * sizeof(int));
+        memcpy(t->args, args, argc * sizeof(int));
+    }
+    t->hash = hash;
+    type_hash_insert(types, id);
+    return id;
+}
+
+static int type_intern(type_table_t *types, enum value_type vtype, int rtype, int argc, const int *args)
+{
+    unsigned hash = type_hash(vtype, rtype, argc, args);
+    if (types->hsize > 0) {
+        unsigned mask = (unsigned)types->hsize - 1;
+        unsigned i = hash & mask;
+        while (types->hash[i]) {
+            type_t *t = &(types->type[types->hash[i] - 1]);
+            if (t->hash == hash && t->vtype == vtype && t->rtype == rtype && t->argc == argc &&
+                    (argc == 0 || !memcmp(t->args, args, argc * sizeof(int)))) {
+                return types->hash[i] - 1;
+            }
+            i = (i + 1) & mask;
+        }
+    }
+    return type_register(types, vtype, rtype, argc, args, hash);
+}
+
+void type_table_init(type_table_t *types)
+{
+    for (int vtype = VALTYPE_UNKNOWN; vtype <= VALTYPE_VA; ++vtype) {
+        type_intern(types, (enum value_type)vtype, 0, 0, NULL);
+    }
+}
+
+void type_table_free(type_table_t *types)
+{
+    for (int i = 0; i < types->count; ++i) {
+        free(types->type[i].args);
+    }
+    free(types->type);
+    free(types->hash);
+    memset(types, 0, sizeof(type_table_t));
+}
+
+int type_function(type_table_t *types, int rtype, int argc, const int *args)
+{
+    return type_intern(types, VALTYPE_FUNC, rtype, argc, args);
+}
@@ -0,0 +1,43 @@
+#ifndef KISS_TYPES_H
+#define KISS_TYPES_H
+
+enum value_type {
+    VALTYPE_UNKNOWN,
+    VALTYPE_INT,
+    VALTYPE_DBL,
+    VALTYPE_STR,
+    VALTYPE_FUNC,
+    VALTYPE_VA,
+};
+
+/*
+    Canonical types, every distinct type has only one immutable entry and is referred by its id.
+    Scalar types are registered first, so the id of a scalar type is the same as its value_type,
+    and VALTYPE_FUNC itself means a function whose signature is not known yet.
+*/
+#define TYPE_TABLE_UNIT (64)
+
+typedef struct type_ {
+    enum value_type vtype;
+    int rtype;                  // type id of a returned value.
+    int argc;
+    int *args;                  // type ids of arguments.
+    unsigned hash;
+} type_t;
+
+typedef struct type_table_ {
+    type_t *type;
+    int count;
+    int cap;
+    int *hash;                  // open addressing of (type id + 1).
+    int hsize;
+} type_table_t;
+
+extern void type_table_init(type_table_t *types);
+extern void type_table_free(type_table_t *types);
+extern int type_function(type_table_t *types, int rtype, int argc, const int *args);
+
+/* Note that a pointer to an entry is valid only until the next type is registered. */
+#define type_get(types, id) (&((types)->type[id]))
+
+#endif /* KISS_TYPES_H */
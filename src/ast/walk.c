@@ -0,0 +1,71 @@
+#include "walk.h"
+
+void ast_walker_grow(ast_walker_t *w)
+{
+    w->cap = w->cap ? w->cap * 2 : AST_WALK_UNIT;
+    w->frame = (ast_frame_t *)realloc(w->frame, w->cap * sizeof(ast_frame_t));
+}
+
+void ast_walker_free(ast_walker_t *w)
+{
+    free(w->frame);
+    w->frame = NULL;
+    w->count = w->cap = 0;
+}
+
+/*
+    The address of the i-th child of a node, or NULL if there are no more children.
+    A child can be NULL, and the next sibling of a child is not a child of the node.
+*/
+node_t **ast_child_slot(node_t *node, int i)
+{
+    switch (node->ntype) {
+    case EXPR_CALL:
+        switch (i) {
+        case 0: return &(node->n.e.call.func);
+        case 1: return &(node->n.e.call.args);
+        }
+        break;
+    case EXPR_UNARY:
+        return i == 0 ? &(node->n.e.unary.expr) : NULL;
+    case EXPR_BINARY:
+        switch (i) {
+        case 0: return &(node->n.e.binary.lhs);
+        case 1: return &(node->n.e.binary.rhs);
+        }
+        break;
+    case EXPR_DECL:
+        return i == 0 ? &(node->n.e.decl.initializer) : NULL;
+    case STMT_EXPR:
+        return i == 0 ? &(node->n.s.expr) : NULL;
+    case STMT_BLOCK:
+        return i == 0 ? &(node->n.s.block.stmt) : NULL;
+    case STMT_BRANCH:
+        switch (i) {
+        case 0: return &(node->n.s.branch.expr);
+        case 1: return &(node->n.s.branch.then_cloause);
+        case 2: return &(node->n.s.branch.else_cloause);
+        }
+        break;
+    case STMT_PRELOOP:
+    case STMT_PSTLOOP:
+        switch (i) {
+        case 0: return &(node->n.s.loop.e1);
+        case 1: return &(node->n.s.loop.e2);
+        case 2: return &(node->n.s.loop.then_cloause);
+        case 3: return &(node->n.s.loop.e3);
+        }
+        break;
+    case STMT_RET:
+        return i == 0 ? &(node->n.s.ret.expr) : NULL;
+    case STMT_FUNC:
+        switch (i) {
+        case 0: return &(node->n.s.func.args);
+        case 1: return &(node->n.s.func.block);
+        }
+        break;
+    default:
+        ;
+    }
+    return NULL;
+}
@@ -0,0 +1,49 @@
+#ifndef KISS_WALK_H
+#define KISS_WALK_H
+
+#include "node.h"
+
+/*
+    Explicit stack to walk a tree without recursion, the depth of a tree is bounded only by heap.
+    A walker function loops over the top frame and switches by a node type and a state of the frame,
+    a frame is resumed at the state given to WALK() after the child has been finished.
+*/
+#define AST_WALK_UNIT (256)
+
+typedef struct ast_frame_ {
+    node_t *node;
+    int state;                      // where to resume visiting the node.
+    int indent;
+    int value;                      // a value kept while visiting children.
+    void *saved;                    // a pointer kept while visiting children.
+} ast_frame_t;
+
+typedef struct ast_walker_ {
+    ast_frame_t *frame;
+    int count;
+    int cap;
+    int last;                       // a value of the last finished frame.
+} ast_walker_t;
+
+extern void ast_walker_grow(ast_walker_t *w);
+extern void ast_walker_free(ast_walker_t *w);
+extern node_t **ast_child_slot(node_t *node, int i);
+
+/* Note that a pointer to a frame is invalidated by pushing a frame. */
+#define ast_walker_push(w, n, ind) do { \
+    if ((w)->count == (w)->cap) ast_walker_grow(w); \
+    ast_frame_t *f_ = &((w)->frame[(w)->count++]); \
+    f_->node = (n); \
+    f_->state = 0; \
+    f_->indent = (ind); \
+} while (0)
+#define ast_walker_top(w) (&((w)->frame[(w)->count - 1]))
+#define ast_walker_pop(w) (--(w)->count)
+#define ast_walker_finish(w, v) ((w)->last = (v), --(w)->count)
+#define ast_walker_last(w) ((w)->last)
+
+/* These are used in a walker loop, which has `w`, `f` for the top frame and the label NEXT. */
+#define WALK(s, child, ind) { f->state = (s); ast_walker_push(w, (child), (ind)); goto NEXT; }
+#define WALKNEXT(node) if ((node)->next) { f->node = (node)->next; f->state = 0; goto NEXT; }
+
+#endif /* KISS_WALK_H */
@@ -1,9 +1,12 @@
+#include <stdio.h>
 #include <stdarg.h>
 #include "out_c.h"
+#include "../ast/walk.h"
 #include "../kiss.tab.h"
 
 typedef struct ast_output_context_ {
     int in_arglist;
+    ast_walker_t walker;
 } ast_output_context_t;
 
 static const char *get_operator_name(int op)
@@ -54,212 +57,244 @@ static void print_indent(int indent, const char *fmt, ...)
     va_end(ap);
 }
 
-static void ast_output_c(int indent, node_t *node, ast_output_context_t *outctx)
+static void ast_output_c(int indent, node_t *root, ast_output_context_t *outctx)
 {
-    if (!node) {
-        return;
-    }
+    ast_walker_t *w = &(outctx->walker);
+    int base = w->count;
+    ast_walker_push(w, root, indent);
 
-TOP:;
-    switch (node->ntype) {
-    /* dump expression. */
-    case EXPR_INT: {
-        print_factor("%lld", node->n.ivalue);
-        break;
-    }
-    case EXPR_DBL: {
-        print_factor("%f", node->n.dvalue);
-        break;
-    }
-    case EXPR_STR: {
-        print_factor("\"%s\"", node->n.svalue->p);
-        break;
-    }
-    case EXPR_VAR: {
-        print_factor("%s", node->n.name->p);
-        break;
-    }
-    case EXPR_CALL: {
-        ast_output_c(indent, node->n.e.call.func, outctx);
-        print_factor("(");
-        ast_output_c(indent, node->n.e.call.args, outctx);
-        node_t *next = node->n.e.call.args->next;
-        while (next) {
-            print_factor(", ");
-            ast_output_c(indent, next, outctx);
-            next = next->next;
-        }
-        print_factor(")");
-        break;
-    }
-    case EXPR_BINARY: {
-        ast_output_c(indent, node->n.e.binary.lhs, outctx);
-        print_factor(" %s ", get_operator_name(node->n.e.binary.op));
-        ast_output_c(indent, node->n.e.binary.rhs, outctx);
-        break;
-    }
-    case EXPR_DECL: {
-        print_factor("%s %s", get_type_name(node->vtype.vtype), node->n.e.decl.name->p);
-        if (outctx->in_arglist) {
-            if (node->next) {
-                print_factor(", ");
-                ast_output_c(indent, node->next, outctx);
+    while (w->count > base) {
+        ast_frame_t *f = ast_walker_top(w);
+        node_t *node = f->node;
+        if (!node) {
+            ast_walker_pop(w);
+            continue;
+        }
+        indent = f->indent;
+
+        switch (node->ntype) {
+        /* output expression. */
+        case EXPR_INT: {
+            print_factor("%lld", node->n.ivalue);
+            break;
+        }
+        case EXPR_DBL: {
+            print_factor("%f", node->n.dvalue);
+            break;
+        }
+        case EXPR_STR: {
+            print_factor("\"%s\"", node->n.svalue->p);
+            break;
+        }
+        case EXPR_VAR: {
+            print_factor("%s", node->n.e.var.name->p);
+            break;
+        }
+        case EXPR_CALL: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.e.call.func, indent);
+            case 1:
+                print_factor("(");
+                WALK(2, node->n.e.call.args, indent);
+            case 2:
+                f->saved = node->n.e.call.args->next;
+                /* fallthrough */
+            default:
+                if (f->saved) {
+                    node_t *arg = (node_t *)f->saved;
+                    f->saved = arg->next;
+                    print_factor(", ");
+                    WALK(3, arg, indent);
+                }
+                print_factor(")");
             }
-        } else {
-            if (node->n.e.decl.initializer) {
-                print_factor(" = ");
-                ast_output_c(indent, node->n.e.decl.initializer, outctx);
+            break;
+        }
+        case EXPR_BINARY: {
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.e.binary.lhs, indent);
+            case 1:
+                print_factor(" %s ", get_operator_name(node->n.e.binary.op));
+                WALK(2, node->n.e.binary.rhs, indent);
+            default:
+                ;
+            }
+            break;
+        }
+        case EXPR_DECL: {
+            if (f->state == 0) {
+                print_factor("%s %s", get_type_name(node->type), node->n.e.decl.name->p);
+                if (outctx->in_arglist) {
+                    if (node->next) {
+                        print_factor(", ");
+                    }
+                    WALKNEXT(node);
+                    break;
+                }
+                if (node->n.e.decl.initializer) {
+                    print_factor(" = ");
+                    WALK(1, node->n.e.decl.initializer, indent);
+                }
             }
             if (node->next) {
                 print_factor(";\n");
-                ast_output_c(indent, node->next, outctx);
             }
+            WALKNEXT(node);
+            break;
         }
-        break;
-    }
 
-    /* dump statement, note that a statement can have a next statement. */
-    case STMT_EXPR: {
-        print_indent(indent, "");
-        ast_output_c(indent, node->n.s.expr, outctx);
-        print_factor(";\n");
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_BLOCK: {
-        print_indent(indent, "{\n");
-        ++indent;
-        ast_output_c(indent, node->n.s.block, outctx);
-        --indent;
-        print_indent(indent, "}\n");
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_BRANCH: {
-        print_indent(indent, "if (");
-        ast_output_c(indent, node->n.s.branch.expr, outctx);
-        print_factor(")\n");
-        ast_output_c(indent, node->n.s.branch.then_cloause, outctx);
-        if (node->n.s.branch.else_cloause) {
-            print_indent(indent, "else\n");
-            ast_output_c(indent, node->n.s.branch.else_cloause, outctx);
-        }
-        print_indent(indent, "\n");
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_PRELOOP: {
-        print_indent(indent, "{\n");
-        ++indent;
-        if (node->n.s.loop.e1) {
-            ast_output_c(indent, node->n.s.loop.e1, outctx);
+        /* output statement, note that a statement can have a next statement. */
+        case STMT_EXPR: {
+            if (f->state == 0) {
+                print_indent(indent, "");
+                WALK(1, node->n.s.expr, indent);
+            }
             print_factor(";\n");
+            WALKNEXT(node);
+            break;
         }
-        print_indent(indent, "while (");
-        if (node->n.s.loop.e2) {
-            ast_output_c(indent, node->n.s.loop.e2, outctx);
+        case STMT_BLOCK: {
+            if (f->state == 0) {
+                print_indent(indent, "{\n");
+                WALK(1, node->n.s.block.stmt, indent + 1);
+            }
+            print_indent(indent, "}\n");
+            WALKNEXT(node);
+            break;
         }
-        print_factor(")\n");
-        ++indent;
-        ast_output_c(indent, node->n.s.loop.then_cloause, outctx);
-        --indent;
-        print_indent(indent, "\n");
-        if (node->n.s.loop.e3) {
-            ast_output_c(indent, node->n.s.loop.e3, outctx);
+        case STMT_BRANCH: {
+            switch (f->state) {
+            case 0:
+                print_indent(indent, "if (");
+                WALK(1, node->n.s.branch.expr, indent);
+            case 1:
+                print_factor(")\n");
+                WALK(2, node->n.s.branch.then_cloause, indent);
+            case 2:
+                if (node->n.s.branch.else_cloause) {
+                    print_indent(indent, "else\n");
+                    WALK(3, node->n.s.branch.else_cloause, indent);
+                }
+                /* fallthrough */
+            default:
+                ;
+            }
+            print_indent(indent, "\n");
+            WALKNEXT(node);
+            break;
         }
-        --indent;
-        print_indent(indent, "}\n");
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_PSTLOOP: {
-        print_indent(indent, "do {\n");
-        ++indent;
-        ast_output_c(indent, node->n.s.loop.e2, outctx);
-        --indent;
-        print_indent(indent, "} while (\n");
-        if (node->n.s.loop.e2) {
-            ast_output_c(indent, node->n.s.loop.e2, outctx);
-        }
-        print_factor(");\n");
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_RET: {
-        print_indent(indent, "return ");
-        ast_output_c(indent, node->n.s.ret.expr, outctx);
-        print_factor(";\n");
-        CHECKNEXT(node);
-        break;
-    }
-    case STMT_FUNC: {
-        CHECKNEXT(node);
-        break;
-    }
-    default:
-        ;
+        case STMT_PRELOOP: {
+            switch (f->state) {
+            case 0:
+                print_indent(indent, "{\n");
+                if (node->n.s.loop.e1) {
+                    WALK(1, node->n.s.loop.e1, indent + 1);
+                }
+                /* fallthrough */
+            case 1:
+                if (node->n.s.loop.e1) {
+                    print_factor(";\n");
+                }
+                print_indent(indent + 1, "while (");
+                WALK(2, node->n.s.loop.e2, indent + 1);
+            case 2:
+                print_factor(")\n");
+                WALK(3, node->n.s.loop.then_cloause, indent + 2);
+            case 3:
+                print_indent(indent + 1, "\n");
+                WALK(4, node->n.s.loop.e3, indent + 1);
+            default:
+                ;
+            }
+            print_indent(indent, "}\n");
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_PSTLOOP: {
+            switch (f->state) {
+            case 0:
+                print_indent(indent, "do {\n");
+                WALK(1, node->n.s.loop.e2, indent + 1);
+            case 1:
+                print_indent(indent, "} while (\n");
+                WALK(2, node->n.s.loop.e2, indent);
+            default:
+                ;
+            }
+            print_factor(");\n");
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_RET: {
+            if (f->state == 0) {
+                print_indent(indent, "return ");
+                WALK(1, node->n.s.ret.expr, indent);
+            }
+            print_factor(";\n");
+            WALKNEXT(node);
+            break;
+        }
+        case STMT_FUNC: {
+            WALKNEXT(node);
+            break;
+        }
+        default:
+            ;
+        }
+
+        ast_walker_pop(w);
+NEXT:;
     }
 }
 
-static void print_arglist(list_t *argtypes)
+static void print_arglist(type_table_t *types, type_t *ftype)
 {
-    for (int i = 0; ; ++i) {
-        types_t type = list_get_argtype(argtypes, i);
-        if (type.vtype == 0 && type.rtype == 0) {
-            break;
-        }
+    for (int i = 0; i < ftype->argc; ++i) {
+        type_t *type = type_get(types, ftype->args[i]);
         if (i > 0) printf(", ");
-        if (type.rtype) {
-            printf("%s (*)(", get_type_name(type.rtype));
-            if (type.argtypes) {
-                print_arglist(type.argtypes);
-            }
+        if (type->rtype) {
+            printf("%s (*)(", get_type_name(type->rtype));
+            print_arglist(types, type);
             printf(")");
         } else {
-            printf("%s", get_type_name(type.vtype));
+            printf("%s", get_type_name(type->vtype));
         }
     }
 }
 
-static void print_prototype(symbol_t *sym)
+static void print_prototype(type_table_t *types, symbol_t *sym)
 {
-    if (sym->type.rtype) {
-        printf("%s %s", get_type_name(sym->type.rtype), sym->name->p);
+    type_t *type = type_get(types, sym->type);
+    if (type->rtype) {
+        printf("%s %s", get_type_name(type->rtype), sym->name->p);
     } else {
         printf("int %s", sym->name->p);
     }
     printf("(");
-    if (sym->argtypes) {
-        print_arglist(sym->argtypes);
-    }
+    print_arglist(types, type);
     printf(");\n");
 }
 
-static void ast_output_function(list_t *funcs, node_t *node)
+static void ast_output_function(type_table_t *types, vector_t *funcs, node_t *node)
 {
     ast_output_context_t outctx = {0};
 
-    int index = 0;
-    while (1) {
-        listitem_t *head = list_get(funcs, index++);
-        if (!head) {
-            break;
-        }
-        node_t *func = (node_t *)(head->item);
-        if (func->sym) {
-            print_prototype(func->sym);
+    for (int i = 0; i < funcs->count; ++i) {
+        node_t *func = (node_t *)vector_get(funcs, i);
+        if (func->n.s.func.sym && func->n.s.func.block) {
+            print_prototype(types, func->n.s.func.sym);
         }
     }
     print_indent(0, "\n");
 
-    index = 0;
-    while (1) {
-        listitem_t *head = list_get(funcs, index++);
-        if (!head) {
-            break;
+    for (int i = 0; i < funcs->count; ++i) {
+        node_t *func = (node_t *)vector_get(funcs, i);
+        if (!func->n.s.func.block) {
+            continue;   // not reachable in the lazy mode.
         }
-        node_t *func = (node_t *)(head->item);
-        print_indent(0, "%s %s(", get_type_name(func->vtype.rtype), func->n.s.func.name->p);
+        print_indent(0, "%s %s(", get_type_name(func->n.s.func.rtype), func->n.s.func.name->p);
         outctx.in_arglist = 1;
         ast_output_c(0, func->n.s.func.args, &outctx);
         outctx.in_arglist = 0;
@@ -271,10 +306,377 @@ static void ast_output_function(list_t *funcs, node_t *node)
     print_indent(0, "int main(void)\n");
     ast_output_c(0, node, &outctx);
     print_indent(0, "\n");
+    ast_walker_free(&(outctx.walker));
 }
 
-void ast_output_c_code(list_t *funcs, node_t *root)
+void ast_output_c_code(type_table_t *types, vector_t *funcs, node_t *root)
 {
     print_indent(0, "typedef signed long long int int64_t;\n\n");
-    ast_output_function(funcs, root);
+    ast_output_function(types, funcs, root);
+}
+
+/*
+    Output from the SSA IR. A value is a local variable of C, and a block is a label.
+    Phis are assigned on each edge into the block, through temporaries when there are some
+    of them, since they are assigned at once.
+*/
+static const char *ir_c_type(type_table_t *types, int type)
+{
+    switch (type_get(types, type)->vtype) {
+    case VALTYPE_DBL: return "double";
+    case VALTYPE_STR: return "const char *";
+    case VALTYPE_FUNC: return "void *";
+    default:
+        ;
+    }
+    return "int64_t";
+}
+
+static void ir_c_operand(ir_value_t *v)
+{
+    switch (v->op) {
+    case IR_CONST:
+        if (v->type == VALTYPE_DBL) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%.17g", v->u.dv);
+            printf("%s%s", buf, strpbrk(buf, ".en") ? "" : ".0");
+        } else if (v->type == VALTYPE_STR) {
+            printf("\"%s\"", v->u.sv->p);
+        } else if (v->u.iv == INT64_MIN) {
+            printf("(-9223372036854775807LL - 1)");
+        } else {
+            printf("%lld", (long long)v->u.iv);
+        }
+        break;
+    case IR_FUNC:
+        printf("(void *)%s", v->u.func->name->p);
+        break;
+    case IR_ARG:
+        printf("_p%lld", (long long)v->u.iv);
+        break;
+    default:
+        printf("_v%d", v->id);
+    }
+}
+
+static const char *ir_c_operator(enum ir_op op)
+{
+    switch (op) {
+    case IR_IADD: case IR_FADD: return "+";
+    case IR_ISUB: case IR_FSUB: return "-";
+    case IR_IMUL: case IR_FMUL: return "*";
+    case IR_IDIV: case IR_FDIV: return "/";
+    case IR_IMOD: return "%";
+    case IR_IEQ: case IR_FEQ: return "==";
+    case IR_INE: case IR_FNE: return "!=";
+    case IR_ILT: case IR_FLT: return "<";
+    case IR_ILE: case IR_FLE: return "<=";
+    case IR_IGT: case IR_FGT: return ">";
+    case IR_IGE: case IR_FGE: return ">=";
+    default:
+        ;
+    }
+    return NULL;
+}
+
+static void ir_c_params(type_table_t *types, int ftype, int named)
+{
+    type_t *t = type_get(types, ftype);
+    if (t->argc == 0) {
+        printf("void");
+    }
+    for (int i = 0; i < t->argc; ++i) {
+        printf("%s%s", i > 0 ? ", " : "", ir_c_type(types, t->args[i]));
+        if (named) {
+            printf(" _p%d", i);
+        }
+    }
+}
+
+static void ir_c_edge(type_table_t *types, ir_block_t *from, ir_block_t *to, int indent)
+{
+    int pred = 0;
+    while (to->pred[pred] != from) {
+        ++pred;
+    }
+    int nphi = 0;
+    for (ir_value_t *phi = to->head; phi && phi->op == IR_PHI; phi = phi->next) {
+        ++nphi;
+    }
+    if (nphi == 1) {
+        print_indent(indent, "_v%d = ", to->head->id);
+        ir_c_operand(to->head->args[pred]);
+        printf(";\n");
+    } else if (nphi > 1) {
+        print_indent(indent, "{\n");
+        for (ir_value_t *phi = to->head; phi && phi->op == IR_PHI; phi = phi->next) {
+            print_indent(indent + 1, "%s _t%d = ", ir_c_type(types, phi->type), phi->id);
+            ir_c_operand(phi->args[pred]);
+            printf(";\n");
+        }
+        for (ir_value_t *phi = to->head; phi && phi->op == IR_PHI; phi = phi->next) {
+            print_indent(indent + 1, "_v%d = _t%d;\n", phi->id, phi->id);
+        }
+        print_indent(indent, "}\n");
+    }
+    print_indent(indent, "goto _L%d;\n", to->id);
+}
+
+static void ir_c_value(type_table_t *types, int is_main, int memo, ir_value_t *v)
+{
+    const char *op = ir_c_operator(v->op);
+    switch (v->op) {
+    case IR_CONST:
+    case IR_FUNC:
+    case IR_ARG:
+    case IR_PHI:
+        return;
+    case IR_STORE:
+        print_indent(1, "%s = ", v->u.global->name->p);
+        ir_c_operand(v->args[0]);
+        printf(";\n");
+        return;
+    case IR_JMP:
+        ir_c_edge(types, v->block, v->u.target[0], 1);
+        return;
+    case IR_BR:
+        print_indent(1, "if (");
+        ir_c_operand(v->args[0]);
+        printf(") {\n");
+        ir_c_edge(types, v->block, v->u.target[0], 2);
+        print_indent(1, "}\n");
+        ir_c_edge(types, v->block, v->u.target[1], 1);
+        return;
+    case IR_RET:
+        if (memo && v->argc > 0) {
+            print_indent(1, "_mr = ");
+            ir_c_operand(v->args[0]);
+            printf(";\n");
+            print_indent(1, "goto _Lmemo;\n");
+            return;
+        }
+        print_indent(1, "return");
+        if (v->argc > 0) {
+            printf(is_main ? " (int)" : " ");
+            ir_c_operand(v->args[0]);
+        } else if (is_main) {
+            printf(" 0");
+        }
+        printf(";\n");
+        return;
+    default:
+        ;
+    }
+
+    print_indent(1, "_v%d = ", v->id);
+    if (op) {
+        if (v->args[0]->op == IR_CONST && v->args[0]->type == VALTYPE_INT && v->args[1]->op == IR_CONST) {
+            printf("(int64_t)");    // literals are int in C, and it overflows without this.
+        }
+        ir_c_operand(v->args[0]);
+        printf(" %s ", op);
+        ir_c_operand(v->args[1]);
+    } else if (v->op == IR_FMOD) {
+        printf("fmod(");
+        ir_c_operand(v->args[0]);
+        printf(", ");
+        ir_c_operand(v->args[1]);
+        printf(")");
+    } else if (v->op == IR_I2F || v->op == IR_F2I) {
+        printf("(%s)", ir_c_type(types, v->type));
+        ir_c_operand(v->args[0]);
+    } else if (v->op == IR_LOAD) {
+        printf("%s", v->u.global->name->p);
+    } else if (v->op == IR_CALL || v->op == IR_CALLB) {
+        int first = 0;
+        if (v->op == IR_CALLB) {
+            printf("%s(", v->u.sv->p);
+        } else if (v->args[0]->op == IR_FUNC) {
+            printf("%s(", v->args[0]->u.func->name->p);
+            first = 1;
+        } else {
+            printf("((%s (*)(", ir_c_type(types, v->type));
+            ir_c_params(types, v->args[0]->type, 0);
+            printf("))");
+            ir_c_operand(v->args[0]);
+            printf(")(");
+            first = 1;
+        }
+        for (int i = first; i < v->argc; ++i) {
+            if (i > first) printf(", ");
+            if (v->op == IR_CALLB && v->args[i]->op == IR_CONST && v->args[i]->type == VALTYPE_INT) {
+                printf("(int64_t)");    // an argument of variadic function is not converted.
+            }
+            ir_c_operand(v->args[i]);
+        }
+        printf(")");
+    }
+    printf(";\n");
+}
+
+/*
+    A memoized function looks up a cache before its body, and a return stores the result
+    at _Lmemo, so a recursive call caches every result on the way without another frame.
+    Arguments are keys by their bits, which are mixed by multiplying with the golden ratio,
+    and the top bits of the hash give a slot. An entry is checked on a few slots from there,
+    and a new result is stored in an empty one of them, or replaces the first one.
+    The slot is -1 while an int argument is in the range of the direct table.
+*/
+#define IR_C_MEMO_DIRECT_SIZE (4096)
+#define IR_C_MEMO_HASH_BITS (14)
+#define IR_C_MEMO_HASH_SIZE (1 << IR_C_MEMO_HASH_BITS)
+#define IR_C_MEMO_PROBES (4)
+
+static void ir_c_memo_tables(ir_module_t *m, ir_func_t *f)
+{
+    const char *name = f->name->p;
+    const char *rtype = ir_c_type(m->types, f->rtype);
+    if (f->memo == IR_MEMO_DIRECT) {
+        printf("static char %s__set[%d];\n", name, IR_C_MEMO_DIRECT_SIZE);
+        printf("static %s %s__val[%d];\n", rtype, name, IR_C_MEMO_DIRECT_SIZE);
+    }
+    printf("static struct { char set; uint64_t k[%d]; %s val; } %s__hash[%d];\n", f->argc, rtype, name, IR_C_MEMO_HASH_SIZE);
+}
+
+static void ir_c_memo_hash_lookup(ir_module_t *m, ir_func_t *f, int indent)
+{
+    const char *name = f->name->p;
+    type_t *t = type_get(m->types, f->type);
+    for (int i = 0; i < f->argc; ++i) {
+        if (t->args[i] == VALTYPE_DBL) {
+            print_indent(indent, "_mk[%d] = _memo_bits(_p%d);\n", i, i);
+        } else {
+            print_indent(indent, "_mk[%d] = (uint64_t)_p%d;\n", i, i);
+        }
+    }
+    print_indent(indent, "uint64_t h = 0;\n");
+    print_indent(indent, "for (int i = 0; i < %d; ++i) {\n", f->argc);
+    print_indent(indent + 1, "h = (h ^ _mk[i]) * 0x9E3779B97F4A7C15ULL;\n");
+    print_indent(indent + 1, "h ^= h >> 32;\n");
+    print_indent(indent, "}\n");
+    print_indent(indent, "_ms = (int)((h * 0x9E3779B97F4A7C15ULL) >> %d);\n", 64 - IR_C_MEMO_HASH_BITS);
+    print_indent(indent, "for (int i = 0; i < %d; ++i) {\n", IR_C_MEMO_PROBES);
+    print_indent(indent + 1, "int e = (_ms + i) & %d, j = 0;\n", IR_C_MEMO_HASH_SIZE - 1);
+    print_indent(indent + 1, "if (!%s__hash[e].set) break;\n", name);
+    print_indent(indent + 1, "while (j < %d && %s__hash[e].k[j] == _mk[j]) ++j;\n", f->argc, name);
+    print_indent(indent + 1, "if (j == %d) return %s__hash[e].val;\n", f->argc, name);
+    print_indent(indent, "}\n");
+}
+
+static void ir_c_memo_lookup(ir_module_t *m, ir_func_t *f)
+{
+    const char *name = f->name->p;
+    print_indent(1, "%s _mr;\n", ir_c_type(m->types, f->rtype));
+    print_indent(1, "uint64_t _mk[%d];\n", f->argc);
+    print_indent(1, "int _ms = -1;\n");
+    if (f->memo == IR_MEMO_DIRECT) {
+        print_indent(1, "if (_p0 >= 0 && _p0 < %d) {\n", IR_C_MEMO_DIRECT_SIZE);
+        print_indent(2, "if (%s__set[_p0]) return %s__val[_p0];\n", name, name);
+        print_indent(1, "} else {\n");
+        ir_c_memo_hash_lookup(m, f, 2);
+        print_indent(1, "}\n");
+    } else {
+        ir_c_memo_hash_lookup(m, f, 1);
+    }
+}
+
+static void ir_c_memo_store(ir_func_t *f)
+{
+    const char *name = f->name->p;
+    int mask = IR_C_MEMO_HASH_SIZE - 1;
+    printf("_Lmemo:\n");
+    if (f->memo == IR_MEMO_DIRECT) {
+        print_indent(1, "if (_ms < 0) {\n");
+        print_indent(2, "%s__val[_p0] = _mr;\n", name);
+        print_indent(2, "%s__set[_p0] = 1;\n", name);
+        print_indent(2, "return _mr;\n");
+        print_indent(1, "}\n");
+    }
+    print_indent(1, "for (int i = 0; i < %d; ++i) {\n", IR_C_MEMO_PROBES);
+    print_indent(2, "if (!%s__hash[(_ms + i) & %d].set) {\n", name, mask);
+    print_indent(3, "_ms = (_ms + i) & %d;\n", mask);
+    print_indent(3, "break;\n");
+    print_indent(2, "}\n");
+    print_indent(1, "}\n");
+    print_indent(1, "%s__hash[_ms].set = 1;\n", name);
+    print_indent(1, "for (int j = 0; j < %d; ++j) %s__hash[_ms].k[j] = _mk[j];\n", f->argc, name);
+    print_indent(1, "%s__hash[_ms].val = _mr;\n", name);
+    print_indent(1, "return _mr;\n");
+}
+
+static void ir_c_function(ir_module_t *m, ir_func_t *f)
+{
+    int is_main = f == m->main;
+    if (is_main) {
+        printf("int main(void)\n{\n");
+    } else {
+        printf("%s %s(", ir_c_type(m->types, f->rtype), f->name->p);
+        ir_c_params(m->types, f->type, 1);
+        printf(")\n{\n");
+    }
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (v->op == IR_CONST || v->op == IR_FUNC || v->op == IR_ARG || v->op == IR_STORE || IR_IS_TERMINATOR(v->op)) {
+                continue;
+            }
+            print_indent(1, "%s _v%d;\n", ir_c_type(m->types, v->type), v->id);
+        }
+    }
+    if (f->memo) {
+        ir_c_memo_lookup(m, f);
+    }
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        if (b != f->entry) {
+            printf("_L%d:\n", b->id);
+        }
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            ir_c_value(m->types, is_main, f->memo, v);
+        }
+    }
+    if (f->memo) {
+        ir_c_memo_store(f);
+    }
+    printf("}\n\n");
+}
+
+void ir_output_c_code(ir_module_t *m)
+{
+    int fmod_used = 0, memo_used = 0;
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ir_func_number(f);
+        memo_used |= f->memo != IR_MEMO_NONE;
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                fmod_used |= v->op == IR_FMOD;
+            }
+        }
+    }
+
+    print_indent(0, "typedef signed long long int int64_t;\n");
+    if (fmod_used) {
+        print_indent(0, "double fmod(double, double);\n");
+    }
+    if (memo_used) {
+        print_indent(0, "typedef unsigned long long int uint64_t;\n");
+        print_indent(0, "static uint64_t _memo_bits(double d) { union { double d; uint64_t u; } x; x.d = d; return x.u; }\n");
+    }
+    print_indent(0, "\n");
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        if (f == m->main) {
+            continue;
+        }
+        printf("%s %s(", ir_c_type(m->types, f->rtype), f->name->p);
+        ir_c_params(m->types, f->type, 0);
+        printf(");\n");
+        if (f->memo) {
+            ir_c_memo_tables(m, f);
+        }
+    }
+    for (ir_global_t *g = m->globals; g; g = g->next) {
+        printf("%s %s;\n", ir_c_type(m->types, g->type), g->name->p);
+    }
+    print_indent(0, "\n");
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ir_c_function(m, f);
+    }
 }
@@ -1,9 +1,11 @@
 #ifndef KISS_OUT_C_H
 #define KISS_OUT_C_H
 
-#include "xlist.h"
+#include "xvector.h"
 #include "../ast/node.h"
+#include "../ir/ir.h"
 
-extern void ast_output_c_code(list_t *funcs, node_t *root);
+extern void ast_output_c_code(type_table_t *types, vector_t *funcs, node_t *root);
+extern void ir_output_c_code(ir_module_t *m);
 
 #endif /* KISS_OUT_C_H */
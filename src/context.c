@@ -2,9 +2,42 @@
 
 static void free_context(kiss_context_t *ctx)
 {
+    if (ctx->parsectx.tokens) {
+        token_stream_free(ctx->parsectx.tokens);
+    }
+    if (ctx->funcs) {
+        vector_free(ctx->funcs);
+    }
+    if (ctx->exports) {
+        vector_free(ctx->exports);
+    }
+    lex_close(&(ctx->parsectx.lexctx));
     string_free(ctx->parsectx.s);
     string_set_free_all(&(ctx->smgr));
+    ast_pass_manager_free(&(ctx->passes));
+    ir_module_free(ctx->ir_module);
     node_free_all(&(ctx->nmgr));
+    type_table_free(&(ctx->types));
+}
+
+static int parse_source(kiss_context_t *ctx)
+{
+    kiss_parsectx_t *parsectx = &(ctx->parsectx);
+    parsectx->lazy = ctx->lazy;
+    int (*parse)(kiss_parsectx_t *) = (ctx->hand_parser || ctx->lazy) ? kiss_parse : yyparse;
+    if (!ctx->pretokenize) {
+        return parse(parsectx);
+    }
+
+    /* A big input is lexed on another thread while parsing. */
+    parsectx->tokens = token_stream_new();
+    if (parsectx->lexctx.len < KISS_TOKEN_THREAD_MIN || !token_stream_lex_async(parsectx->tokens, parsectx)) {
+        token_stream_lex(parsectx->tokens, parsectx);
+    }
+    int r = parse(parsectx);
+    token_stream_join(parsectx->tokens);
+    token_stream_rewind(parsectx->tokens);
+    return r;
 }
 
 static int parse_kiss(kiss_context_t *ctx, const char *filename)
@@ -12,40 +45,273 @@ static int parse_kiss(kiss_context_t *ctx, const char *filename)
     if (!ctx || !filename) {
         return 1;
     }
-    ctx->parsectx.lexctx.fp = fopen(filename, "r");
-    if (!ctx->parsectx.lexctx.fp) {
+    if (!lex_open_file(&(ctx->parsectx.lexctx), filename)) {
         return 1;
     }
 
-    return yyparse(&(ctx->parsectx));
+    return parse_source(ctx);
+}
+
+static int parse_kiss_buffer(kiss_context_t *ctx, const char *src, size_t len)
+{
+    if (!ctx || !src) {
+        return 1;
+    }
+    if (!lex_open_buffer(&(ctx->parsectx.lexctx), src, len)) {
+        return 1;
+    }
+
+    return parse_source(ctx);
 }
 
 static void ast_dump_hook(kiss_context_t *ctx)
 {
-    ast_dump(ctx->nmgr.root);
+    ast_dump(&(ctx->types), ctx->nmgr.root);
 }
 
-static void ast_type_hook(kiss_context_t *ctx)
+static int load_function_body(void *arg, node_t *func)
 {
-    ctx->funcs = ast_type(ctx->nmgr.root);
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    int r = kiss_parse_function_body(&(ctx->parsectx), func);
+    if (r != 0) {
+        ++ctx->load_error;
+    }
+    return r;
+}
+
+static int ast_type_hook(kiss_context_t *ctx)
+{
+    if (!ctx->lazy) {
+        ctx->funcs = ast_type(&(ctx->types), ctx->nmgr.root);
+        return 0;
+    }
+    ctx->funcs = ast_type_lazy(&(ctx->types), ctx->nmgr.root, ctx->exports, load_function_body, ctx);
+    return ctx->load_error;
 }
 
 static void ast_output_hook(kiss_context_t *ctx)
 {
-    ast_output_c_code(ctx->funcs, ctx->nmgr.root);
+    if (ctx->ir_module) {
+        ir_output_c_code(ctx->ir_module);
+        return;
+    }
+    ast_output_c_code(&(ctx->types), ctx->funcs, ctx->nmgr.root);
+}
+
+static int ir_lower_hook(kiss_context_t *ctx)
+{
+    ctx->ir_module = ir_lower(&(ctx->types), ctx->funcs, ctx->nmgr.root);
+    if (!ctx->ir_module) {
+        return 1;
+    }
+    return ir_verify(ctx->ir_module);
+}
+
+static void ir_dump_hook(kiss_context_t *ctx)
+{
+    ir_dump(ctx->ir_module);
+}
+
+static int type_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    return ctx->type_ast(ctx);
+}
+
+static int dce_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ast_dce_stats_t stats;
+    ast_dce(ctx->funcs, ctx->nmgr.root, ctx->exports, &stats);
+    fprintf(stderr, "dce: %d functions, %d statements, %d variables and %d stores removed\n",
+        stats.functions, stats.statements, stats.variables, stats.stores);
+    for (int i = 0; i < stats.names->count; ++i) {
+        fprintf(stderr, "  function %s\n", ((string_t *)vector_get(stats.names, i))->p);
+    }
+    ast_dce_stats_free(&stats);
+    return 0;
+}
+
+static int dump_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ctx->dump_ast(ctx);
+    return 0;
+}
+
+static int lower_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    return ctx->lower_ir(ctx);
+}
+
+static int dump_ir_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ctx->print_ir(ctx);
+    return 0;
+}
+
+static int tail_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ir_tail_stats_t stats;
+    ir_tail_calls(ctx->ir_module, &stats);
+    fprintf(stderr, "tail: %d self calls and %d mutual calls in %d groups turned into jumps\n",
+        stats.self, stats.mutual, stats.groups);
+    return ir_verify(ctx->ir_module);
+}
+
+static int inline_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ir_inline_stats_t stats;
+    ir_inline(ctx->ir_module, ctx->inline_threshold, ctx->exports, &stats);
+    fprintf(stderr, "inline: %d calls inlined, %d functions removed\n", stats.inlined, stats.removed);
+    return ir_verify(ctx->ir_module);
+}
+
+static int eval_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ir_eval_stats_t stats;
+    ir_eval_calls(ctx->ir_module, ctx->eval_steps, ctx->eval_depth, &stats);
+    fprintf(stderr, "eval: %d calls evaluated, %d given up\n", stats.evaluated, stats.given_up);
+    return ir_verify(ctx->ir_module);
+}
+
+static int spec_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ir_spec_stats_t stats;
+    ir_specialize(ctx->ir_module, ctx->spec_budget, ctx->exports, &stats);
+    fprintf(stderr, "specialize: %d calls to %d clones, %d values folded, %d clones discarded, %d functions removed\n",
+        stats.calls, stats.clones, stats.folded, stats.discarded, stats.removed);
+    return ir_verify(ctx->ir_module);
+}
+
+static int loop_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ir_loop_stats_t stats;
+    ir_loops(ctx->ir_module, &stats);
+    fprintf(stderr, "loops: %d values hoisted, %d loops unswitched, %d loops unrolled\n",
+        stats.hoisted, stats.unswitched, stats.unrolled);
+    return ir_verify(ctx->ir_module);
+}
+
+static int sccp_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ir_sccp_stats_t stats;
+    ir_sccp(ctx->ir_module, &stats);
+    fprintf(stderr, "sccp: %d values folded, %d branches pruned, %d blocks and %d values removed\n",
+        stats.folded, stats.pruned, stats.blocks, stats.removed);
+    return ir_verify(ctx->ir_module);
+}
+
+static int memo_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    int memoized = ir_memoize(ctx->ir_module);
+    fprintf(stderr, "memoize: %d functions memoized\n", memoized);
+    for (ir_func_t *f = ctx->ir_module->funcs; f; f = f->next) {
+        if (f->memo) {
+            fprintf(stderr, "    %s (%s)\n", f->name->p, f->memo == IR_MEMO_DIRECT ? "direct" : "hash");
+        }
+    }
+    return ir_verify(ctx->ir_module);
+}
+
+static int output_pass(void *arg)
+{
+    kiss_context_t *ctx = (kiss_context_t *)arg;
+    ctx->output(ctx);
+    return 0;
+}
+
+/* Passes from typing to output, visitor passes between them are fused by the pass manager. */
+static int compile_kiss(kiss_context_t *ctx)
+{
+    ast_pass_manager_t *pm = &(ctx->passes);
+    ast_pass_manager_init(pm, &(ctx->nmgr.root));
+
+    ast_pass_add(pm, &(ast_pass_t){ .name = "type", .provides = AST_ANALYSIS_TYPES, .run = type_pass, .arg = ctx });
+    if (ctx->dce) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "dce", .requires = AST_ANALYSIS_TYPES, .run = dce_pass, .arg = ctx });
+    }
+    if (ctx->stats) {
+        ast_pass_t stats = ast_stats_pass(&(ctx->node_stats));
+        ast_pass_add(pm, &stats);
+    }
+    if (ctx->fold) {
+        ast_pass_t fold = ast_fold_pass(&(ctx->node_fold), &(ctx->nmgr));
+        ast_pass_add(pm, &fold);
+    }
+    if (ctx->dump) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "dump", .requires = AST_ANALYSIS_TYPES, .run = dump_pass, .arg = ctx });
+    }
+    if (ctx->ir || ctx->dump_ir || ctx->sccp || ctx->tail_calls || ctx->inlining || ctx->eval_calls || ctx->specialize || ctx->memoize || ctx->loops) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "lower", .requires = AST_ANALYSIS_TYPES, .provides = AST_ANALYSIS_IR, .run = lower_pass, .arg = ctx });
+    }
+    if (ctx->eval_calls) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "eval", .requires = AST_ANALYSIS_IR, .run = eval_pass, .arg = ctx });
+    }
+    if (ctx->tail_calls) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "tail", .requires = AST_ANALYSIS_IR, .run = tail_pass, .arg = ctx });
+    }
+    if (ctx->specialize) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "specialize", .requires = AST_ANALYSIS_IR, .run = spec_pass, .arg = ctx });
+    }
+    if (ctx->inlining) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "inline", .requires = AST_ANALYSIS_IR, .run = inline_pass, .arg = ctx });
+    }
+    if (ctx->loops) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "loops", .requires = AST_ANALYSIS_IR, .run = loop_pass, .arg = ctx });
+    }
+    if (ctx->sccp) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "sccp", .requires = AST_ANALYSIS_IR, .run = sccp_pass, .arg = ctx });
+    }
+    if (ctx->memoize) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "memoize", .requires = AST_ANALYSIS_IR, .run = memo_pass, .arg = ctx });
+    }
+    if (ctx->dump_ir) {
+        ast_pass_add(pm, &(ast_pass_t){ .name = "dump-ir", .requires = AST_ANALYSIS_IR, .run = dump_ir_pass, .arg = ctx });
+    }
+    ast_pass_add(pm, &(ast_pass_t){ .name = "output", .requires = AST_ANALYSIS_TYPES, .run = output_pass, .arg = ctx });
+
+    int r = ast_pass_run(pm);
+    if (ctx->stats) {
+        int visitors = 0;
+        for (int i = 0; i < pm->count; ++i) {
+            visitors += pm->pass[i].kinds != 0;
+        }
+        fprintf(stderr, "walks: %d for %d visitor passes\n", pm->walks, visitors);
+    }
+    return r;
 }
 
 kiss_context_t *new_context(void)
 {
     kiss_context_t *ctx = calloc(1, sizeof(kiss_context_t));
+    type_table_init(&(ctx->types));
+    ctx->nmgr.types = &(ctx->types);
     ctx->parsectx.node_mgr = &(ctx->nmgr);
     ctx->parsectx.string_mgr = &(ctx->smgr);
     ctx->parsectx.s = string_new(NULL);
     ctx->parsectx.lexctx.ch = ' ';
     ctx->parse = parse_kiss;
+    ctx->parse_buffer = parse_kiss_buffer;
     ctx->type_ast = ast_type_hook;
     ctx->dump_ast = ast_dump_hook;
     ctx->output = ast_output_hook;
+    ctx->lower_ir = ir_lower_hook;
+    ctx->print_ir = ir_dump_hook;
+    ctx->compile = compile_kiss;
+    ctx->inline_threshold = IR_INLINE_THRESHOLD;
+    ctx->eval_steps = IR_EVAL_STEPS;
+    ctx->eval_depth = IR_EVAL_DEPTH;
+    ctx->spec_budget = IR_SPEC_BUDGET;
     ctx->free = free_context;
     return ctx;
 }
@@ -1,10 +1,15 @@
 #ifndef KISS_CONTEXT_H
 #define KISS_CONTEXT_H
 
-#include "xlist.h"
+#include "xvector.h"
 #include "lexer.h"
+#include "parser.h"
 #include "ast/dump.h"
 #include "ast/typep.h"
+#include "ast/pass.h"
+#include "ast/stats.h"
+#include "ast/fold.h"
+#include "ast/dce.h"
 #include "backend/out_c.h"
 
 extern int yyparse(kiss_parsectx_t *);
@@ -13,15 +18,47 @@ extern int yydebug;
 typedef struct kiss_context_ {
     string_set_t smgr;
     node_manager_t nmgr;
+    type_table_t types;
     kiss_parsectx_t parsectx;
 
     int (*parse)(struct kiss_context_ *ctx, const char *filename);
-    void (*type_ast)(struct kiss_context_ *ctx);
+    int (*parse_buffer)(struct kiss_context_ *ctx, const char *src, size_t len);
+    int (*type_ast)(struct kiss_context_ *ctx);
     void (*dump_ast)(struct kiss_context_ *ctx);
     void (*output)(struct kiss_context_ *ctx);
+    int (*lower_ir)(struct kiss_context_ *ctx);
+    void (*print_ir)(struct kiss_context_ *ctx);
+    int (*compile)(struct kiss_context_ *ctx);
     void (*free)(struct kiss_context_ *ctx);
 
-    list_t *funcs;
+    vector_t *funcs;
+    int pretokenize;    // lex the whole input into a token stream before parsing.
+    int hand_parser;    // parse by kiss_parse() instead of yyparse().
+    int lazy;           // parse and type function bodies only when reachable, this implies hand_parser.
+    vector_t *exports;  // names of functions to be emitted even if not reachable.
+    int load_error;     // the number of bodies failed to be parsed lazily.
+    int dump;           // dump the AST after typing.
+    int stats;          // print node statistics and the number of walks to stderr.
+    int fold;           // fold operations of int literals on the AST.
+    int dce;            // remove unreachable functions and statements, and unused locals.
+    int ir;             // output C from the SSA IR instead of the AST.
+    int dump_ir;        // dump the SSA IR, this implies ir.
+    int sccp;           // propagate constants on the SSA IR, this implies ir.
+    int tail_calls;     // turn tail calls into jumps on the SSA IR, this implies ir.
+    int inlining;       // inline calls on the SSA IR, this implies ir.
+    int inline_threshold;   // the cost over which a call is not inlined.
+    int eval_calls;     // evaluate calls with constant arguments on the SSA IR, this implies ir.
+    int eval_steps;     // steps of a call over which it is given up.
+    int eval_depth;     // the depth of calls over which it is given up.
+    int specialize;     // clone functions for constant arguments on the SSA IR, this implies ir.
+    int spec_budget;    // clones of a function.
+    int memoize;        // cache results of pure recursive functions, this implies ir.
+    int loops;          // hoist invariants, unswitch and unroll loops on the SSA IR, this implies ir.
+    ir_module_t *ir_module;
+
+    ast_pass_manager_t passes;
+    ast_stats_t node_stats;
+    ast_fold_t node_fold;
 } kiss_context_t;
 
 extern kiss_context_t *new_context(void);
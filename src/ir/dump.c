@@ -0,0 +1,176 @@
+#include <stdio.h>
+#include "ir.h"
+
+const char *ir_op_name(enum ir_op op)
+{
+    switch (op) {
+    case IR_NOP:   return "nop";
+    case IR_CONST: return "const";
+    case IR_FUNC:  return "func";
+    case IR_ARG:   return "arg";
+    case IR_PHI:   return "phi";
+    case IR_IADD:  return "iadd";
+    case IR_ISUB:  return "isub";
+    case IR_IMUL:  return "imul";
+    case IR_IDIV:  return "idiv";
+    case IR_IMOD:  return "imod";
+    case IR_IEQ:   return "ieq";
+    case IR_INE:   return "ine";
+    case IR_ILT:   return "ilt";
+    case IR_ILE:   return "ile";
+    case IR_IGT:   return "igt";
+    case IR_IGE:   return "ige";
+    case IR_FADD:  return "fadd";
+    case IR_FSUB:  return "fsub";
+    case IR_FMUL:  return "fmul";
+    case IR_FDIV:  return "fdiv";
+    case IR_FMOD:  return "fmod";
+    case IR_FEQ:   return "feq";
+    case IR_FNE:   return "fne";
+    case IR_FLT:   return "flt";
+    case IR_FLE:   return "fle";
+    case IR_FGT:   return "fgt";
+    case IR_FGE:   return "fge";
+    case IR_I2F:   return "i2f";
+    case IR_F2I:   return "f2i";
+    case IR_LOAD:  return "load";
+    case IR_STORE: return "store";
+    case IR_CALL:  return "call";
+    case IR_CALLB: return "callb";
+    case IR_JMP:   return "jmp";
+    case IR_BR:    return "br";
+    case IR_RET:   return "ret";
+    }
+    return "?";
+}
+
+static void print_type(type_table_t *types, int id)
+{
+    type_t *t = type_get(types, id);
+    switch (t->vtype) {
+    case VALTYPE_INT: printf("int"); return;
+    case VALTYPE_DBL: printf("dbl"); return;
+    case VALTYPE_STR: printf("str"); return;
+    case VALTYPE_VA:  printf("..."); return;
+    case VALTYPE_FUNC:
+        break;
+    default:
+        printf("unknown");
+        return;
+    }
+    printf("func(");
+    for (int i = 0; i < t->argc; ++i) {
+        if (i > 0) printf(", ");
+        print_type(types, t->args[i]);
+    }
+    printf(")");
+    if (t->rtype) {
+        printf(":");
+        print_type(types, t->rtype);
+    }
+}
+
+static const char *func_name(ir_func_t *f)
+{
+    return f->name ? f->name->p : "main";
+}
+
+static void print_value(ir_module_t *m, ir_value_t *v)
+{
+    printf("    ");
+    if (v->op != IR_STORE && !IR_IS_TERMINATOR(v->op)) {
+        printf("v%d = ", v->id);
+    }
+    printf("%s", ir_op_name(v->op));
+
+    switch (v->op) {
+    case IR_CONST:
+        if (v->type == VALTYPE_DBL) {
+            printf(" %.17g", v->u.dv);
+        } else if (v->type == VALTYPE_STR) {
+            printf(" \"%s\"", v->u.sv->p);
+        } else {
+            printf(" %lld", (long long)v->u.iv);
+        }
+        break;
+    case IR_FUNC:
+        printf(" @%s", func_name(v->u.func));
+        break;
+    case IR_ARG:
+        printf(" %lld", (long long)v->u.iv);
+        break;
+    case IR_LOAD:
+        printf(" @%s", v->u.global->name->p);
+        break;
+    case IR_STORE:
+        printf(" @%s,", v->u.global->name->p);
+        break;
+    case IR_CALLB:
+        printf(" %s", v->u.sv->p);
+        if (v->argc > 0) printf(",");
+        break;
+    default:
+        ;
+    }
+
+    for (int i = 0; i < v->argc; ++i) {
+        printf("%s v%d", i > 0 ? "," : "", v->args[i]->id);
+        if (v->op == IR_PHI) {
+            printf(" b%d", v->block->pred[i]->id);
+        }
+    }
+    if (v->op == IR_JMP) {
+        printf(" b%d", v->u.target[0]->id);
+    } else if (v->op == IR_BR) {
+        printf(", b%d, b%d", v->u.target[0]->id, v->u.target[1]->id);
+    }
+
+    if (v->op != IR_STORE && !IR_IS_TERMINATOR(v->op)) {
+        printf(" : ");
+        print_type(m->types, v->type);
+    }
+    printf("\n");
+}
+
+static void ir_dump_function(ir_module_t *m, ir_func_t *f)
+{
+    printf("function %s", func_name(f));
+    if (f->type) {
+        printf(" : ");
+        print_type(m->types, f->type);
+    }
+    if (f->memo) {
+        printf(" memo(%s)", f->memo == IR_MEMO_DIRECT ? "direct" : "hash");
+    }
+    printf(" {\n");
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        printf("b%d:", b->id);
+        for (int i = 0; i < b->npred; ++i) {
+            printf("%s b%d", i > 0 ? "," : " <-", b->pred[i]->id);
+        }
+        printf("\n");
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            print_value(m, v);
+        }
+    }
+    printf("}\n\n");
+}
+
+/*
+    One line per value, as `v<id> = <op> <operands> : <type>`.
+    An operand of a phi is followed by the block where it comes from.
+*/
+void ir_dump(ir_module_t *m)
+{
+    for (ir_global_t *g = m->globals; g; g = g->next) {
+        printf("global @%s : ", g->name->p);
+        print_type(m->types, g->type);
+        printf("\n");
+    }
+    if (m->globals) {
+        printf("\n");
+    }
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ir_dump_function(m, f);
+    }
+}
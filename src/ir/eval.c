@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Evaluation of calls with constant arguments at compile time. A call is interpreted on the IR
+    of the callee, and replaced by a constant of the result. Evaluation gives up at anything
+    with an effect or a dependence on the state, which is a builtin, a global, or a call of a value,
+    and at an operation which ir_fold() does not fold, so a call which completes is pure.
+    Steps of a call site and the depth of calls are limited, so the compilation always ends.
+    Results are cached by a callee and arguments, then a recursive function such as fib is
+    evaluated once for each argument.
+*/
+typedef struct eval_entry_ {
+    ir_func_t *func;
+    ir_scalar_t *args;
+    ir_scalar_t result;
+} eval_entry_t;
+
+typedef struct eval_context_ {
+    ir_module_t *m;
+    int steps;                      // left for the current call site.
+    int max_depth;
+    eval_entry_t *cache;            // open addressing, the size is a power of two.
+    int ncache;
+    int cachecap;
+    ir_scalar_t *phis;              // new values of phis, which are assigned at once.
+    int phicap;
+    struct eval_frame_ *frames;     // the stack of calls being interpreted.
+    int nframes;
+    int framecap;
+} eval_context_t;
+
+static uint64_t scalar_bits(const ir_scalar_t *s)
+{
+    uint64_t u;
+    memcpy(&u, &(s->u), sizeof(u));
+    return u;
+}
+
+static int cache_slot(eval_context_t *E, ir_func_t *f, const ir_scalar_t *args)
+{
+    uint64_t h = (uint64_t)(uintptr_t)f;
+    for (int i = 0; i < f->argc; ++i) {
+        h = (h ^ scalar_bits(&(args[i]))) * 0x9E3779B97F4A7C15ULL;
+        h ^= h >> 32;
+    }
+    int mask = E->cachecap - 1;
+    for (int i = (int)(h & mask); ; i = (i + 1) & mask) {
+        eval_entry_t *e = &(E->cache[i]);
+        if (!e->func) {
+            return i;
+        }
+        if (e->func == f) {
+            int k = 0;
+            while (k < f->argc && e->args[k].type == args[k].type && scalar_bits(&(e->args[k])) == scalar_bits(&(args[k]))) {
+                ++k;
+            }
+            if (k == f->argc) {
+                return i;
+            }
+        }
+    }
+}
+
+static void cache_add(eval_context_t *E, ir_func_t *f, const ir_scalar_t *args, const ir_scalar_t *result)
+{
+    if ((E->ncache + 1) * 2 > E->cachecap) {
+        eval_entry_t *old = E->cache;
+        int oldcap = E->cachecap;
+        E->cachecap = oldcap ? oldcap * 2 : 256;
+        E->cache = (eval_entry_t *)calloc(E->cachecap, sizeof(eval_entry_t));
+        for (int i = 0; i < oldcap; ++i) {
+            if (old[i].func) {
+                E->cache[cache_slot(E, old[i].func, old[i].args)] = old[i];
+            }
+        }
+        free(old);
+    }
+    eval_entry_t *e = &(E->cache[cache_slot(E, f, args)]);
+    e->func = f;
+    e->args = (ir_scalar_t *)malloc((f->argc + 1) * sizeof(ir_scalar_t));
+    memcpy(e->args, args, f->argc * sizeof(ir_scalar_t));
+    e->result = *result;
+    ++E->ncache;
+}
+
+static int is_scalar_type(int type)
+{
+    return type == VALTYPE_INT || type == VALTYPE_DBL;
+}
+
+/* A frame of the interpreter, which is resumed at v after a callee has returned. */
+typedef struct eval_frame_ {
+    ir_func_t *func;
+    ir_scalar_t *args;              // owned by the frame.
+    ir_scalar_t *vals;              // values by an id.
+    ir_block_t *from;
+    ir_block_t *block;
+    ir_value_t *v;                  // NULL when entering the block.
+} eval_frame_t;
+
+static void push_frame(eval_context_t *E, ir_func_t *f, ir_scalar_t *args)
+{
+    if (E->nframes == E->framecap) {
+        E->framecap = E->framecap ? E->framecap * 2 : 64;
+        E->frames = (eval_frame_t *)realloc(E->frames, E->framecap * sizeof(eval_frame_t));
+    }
+    eval_frame_t *F = &(E->frames[E->nframes++]);
+    F->func = f;
+    F->args = args;
+    F->vals = (ir_scalar_t *)calloc(f->nvalues + 1, sizeof(ir_scalar_t));
+    F->from = NULL;
+    F->block = f->entry;
+    F->v = NULL;
+}
+
+static void pop_frame(eval_context_t *E)
+{
+    eval_frame_t *F = &(E->frames[--E->nframes]);
+    free(F->vals);
+    free(F->args);
+}
+
+/* Phis of the block take values from the predecessor at once. */
+static ir_value_t *enter_block(eval_context_t *E, eval_frame_t *F)
+{
+    ir_block_t *b = F->block;
+    int pred = 0, nphis = 0;
+    while (F->from && b->pred[pred] != F->from) {
+        ++pred;
+    }
+    for (ir_value_t *v = b->head; v && v->op == IR_PHI; v = v->next) {
+        if (nphis == E->phicap) {
+            E->phicap = E->phicap ? E->phicap * 2 : 16;
+            E->phis = (ir_scalar_t *)realloc(E->phis, E->phicap * sizeof(ir_scalar_t));
+        }
+        E->phis[nphis++] = F->vals[v->args[pred]->id];
+    }
+    nphis = 0;
+    ir_value_t *v;
+    for (v = b->head; v && v->op == IR_PHI; v = v->next) {
+        F->vals[v->id] = E->phis[nphis++];
+    }
+    return v;
+}
+
+static int find_cache(eval_context_t *E, ir_func_t *f, const ir_scalar_t *args, ir_scalar_t *result)
+{
+    if (E->cachecap > 0) {
+        eval_entry_t *e = &(E->cache[cache_slot(E, f, args)]);
+        if (e->func) {
+            *result = e->result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+    Returns 1 with the result of f, or 0 if it is given up.
+    Frames are kept on a heap stack instead of the C stack, so the depth is bounded only by max_depth.
+*/
+static int eval_call(eval_context_t *E, ir_func_t *f, const ir_scalar_t *args, ir_scalar_t *result)
+{
+    if (find_cache(E, f, args, result)) {
+        return 1;
+    }
+    if (E->max_depth < 0) {
+        return 0;
+    }
+
+    ir_scalar_t *fargs = (ir_scalar_t *)malloc((f->argc + 1) * sizeof(ir_scalar_t));
+    memcpy(fargs, args, f->argc * sizeof(ir_scalar_t));
+    push_frame(E, f, fargs);
+    while (E->nframes > 0) {
+        eval_frame_t *F = &(E->frames[E->nframes - 1]);
+        if (!F->v) {
+            F->v = enter_block(E, F);
+        }
+        ir_value_t *v = F->v;
+        if (--E->steps < 0) {
+            goto FAIL;
+        }
+        ir_scalar_t *r = &(F->vals[v->id]);
+        switch (v->op) {
+        case IR_CONST:
+            if (!is_scalar_type(v->type)) {
+                goto FAIL;
+            }
+            r->type = v->type;
+            r->u.iv = v->u.iv;
+            if (v->type == VALTYPE_DBL) {
+                r->u.dv = v->u.dv;
+            }
+            break;
+        case IR_FUNC:
+            break;
+        case IR_ARG:
+            *r = F->args[v->u.iv];
+            break;
+        case IR_CALL: {
+            ir_func_t *g = (v->args[0]->op == IR_FUNC) ? v->args[0]->u.func : NULL;
+            if (!g || !is_scalar_type(v->type)) {
+                goto FAIL;
+            }
+            for (int i = 1; i < v->argc; ++i) {
+                if (!is_scalar_type(v->args[i]->type)) {
+                    goto FAIL;      // a result is cached by scalar arguments only.
+                }
+            }
+            ir_scalar_t *cargs = (ir_scalar_t *)malloc((g->argc + 1) * sizeof(ir_scalar_t));
+            for (int i = 0; i < g->argc; ++i) {
+                cargs[i] = F->vals[v->args[i + 1]->id];
+            }
+            if (find_cache(E, g, cargs, r)) {
+                free(cargs);
+                break;
+            }
+            if (E->nframes > E->max_depth) {
+                free(cargs);
+                goto FAIL;
+            }
+            /* the caller is resumed at this call, which takes the result when the callee returns. */
+            push_frame(E, g, cargs);
+            continue;
+        }
+        case IR_JMP:
+            F->from = F->block;
+            F->block = v->u.target[0];
+            F->v = NULL;
+            continue;
+        case IR_BR:
+            F->from = F->block;
+            F->block = v->u.target[F->vals[v->args[0]->id].u.iv ? 0 : 1];
+            F->v = NULL;
+            continue;
+        case IR_RET: {
+            if (v->argc == 0) {
+                goto FAIL;
+            }
+            ir_scalar_t ret = F->vals[v->args[0]->id];
+            cache_add(E, F->func, F->args, &ret);
+            pop_frame(E);
+            if (E->nframes == 0) {
+                *result = ret;
+                return 1;
+            }
+            F = &(E->frames[E->nframes - 1]);
+            F->vals[F->v->id] = ret;
+            F->v = F->v->next;
+            continue;
+        }
+        default:
+            if (v->argc == 0 || !ir_fold(v->op, &(F->vals[v->args[0]->id]), v->argc > 1 ? &(F->vals[v->args[1]->id]) : NULL, r)) {
+                goto FAIL;
+            }
+        }
+        F->v = v->next;
+    }
+
+FAIL:
+    while (E->nframes > 0) {
+        pop_frame(E);
+    }
+    return 0;
+}
+
+/* A call of a function with arguments all of int or dbl constants, whose result is int or dbl. */
+static int is_constant_call(ir_value_t *v)
+{
+    if (v->op != IR_CALL || v->args[0]->op != IR_FUNC || !is_scalar_type(v->type)) {
+        return 0;
+    }
+    for (int i = 1; i < v->argc; ++i) {
+        ir_value_t *a = ir_resolve(v->args[i]);
+        if (a->op != IR_CONST || !is_scalar_type(a->type)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+    Call sites are evaluated before any of them is replaced, since the function itself
+    may be interpreted for one of them. Returns the number of calls replaced, and those
+    given up are counted in failed.
+*/
+static int eval_function(eval_context_t *E, ir_func_t *f, int steps, int *failed)
+{
+    int nsites = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            nsites += is_constant_call(v);
+        }
+    }
+    *failed = 0;
+    if (nsites == 0) {
+        return 0;
+    }
+    ir_value_t **sites = (ir_value_t **)malloc(nsites * sizeof(ir_value_t *));
+    ir_scalar_t *results = (ir_scalar_t *)malloc(nsites * sizeof(ir_scalar_t));
+    nsites = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (!is_constant_call(v)) {
+                continue;
+            }
+            ir_func_t *g = v->args[0]->u.func;
+            ir_scalar_t *args = (ir_scalar_t *)malloc((g->argc + 1) * sizeof(ir_scalar_t));
+            for (int i = 0; i < g->argc; ++i) {
+                ir_value_t *a = ir_resolve(v->args[i + 1]);
+                args[i].type = a->type;
+                args[i].u.iv = a->u.iv;
+                if (a->type == VALTYPE_DBL) {
+                    args[i].u.dv = a->u.dv;
+                }
+            }
+            E->steps = steps;
+            if (eval_call(E, g, args, &(results[nsites]))) {
+                sites[nsites++] = v;
+            } else {
+                ++*failed;
+            }
+            free(args);
+        }
+    }
+
+    for (int i = 0; i < nsites; ++i) {
+        ir_value_t *v = sites[i];
+        ir_value_t *c = ir_value_new(E->m, IR_CONST, v->type, 0);
+        if (v->type == VALTYPE_DBL) {
+            c->u.dv = results[i].u.dv;
+        } else {
+            c->u.iv = results[i].u.iv;
+        }
+        ir_insert_before(v, c);
+        v->forward = c;
+        ir_remove(v);
+    }
+    if (nsites > 0) {
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                for (int i = 0; i < v->argc; ++i) {
+                    v->args[i] = ir_resolve(v->args[i]);
+                }
+            }
+        }
+        ir_func_remove_dead(f);
+    }
+    free(results);
+    free(sites);
+    return nsites;
+}
+
+int ir_eval_calls(ir_module_t *m, int steps, int depth, ir_eval_stats_t *stats)
+{
+    eval_context_t ctx = { .m = m, .max_depth = depth };
+    memset(stats, 0, sizeof(ir_eval_stats_t));
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ir_func_number(f);
+    }
+    /* a result may be an argument of another call, such as fib(fib(5)). */
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        int n, failed;
+        do {
+            n = eval_function(&ctx, f, steps, &failed);
+            stats->evaluated += n;
+        } while (n > 0);
+        stats->given_up += failed;
+    }
+
+    for (int i = 0; i < ctx.cachecap; ++i) {
+        free(ctx.cache[i].args);
+    }
+    free(ctx.cache);
+    free(ctx.phis);
+    free(ctx.frames);
+    return stats->evaluated;
+}
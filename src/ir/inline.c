@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Inlining of direct calls, bottom-up on the call graph. Strongly connected components are
+    found by Tarjan's algorithm, which gives callees before callers, so a callee has got its own
+    calls inlined when it is considered. A call within a component, which is recursive, is kept.
+
+    The cost of a call is the size of the callee, which is the number of instructions except
+    constants, minus the call itself with its arguments, and minus a bonus for each constant
+    argument which --sccp may fold. A call is inlined if the cost is not over the threshold,
+    which is doubled for a leaf function. A caller does not grow beyond IR_INLINE_MAX_SIZE.
+*/
+#define IR_INLINE_MAX_SIZE (8 * 1024)
+#define IR_INLINE_CONST_BONUS (2)
+
+typedef struct inline_context_ {
+    ir_module_t *m;
+    int threshold;
+    ir_inline_stats_t *stats;
+    ir_func_t **funcs;              // by an index in mark.
+    int nfuncs;
+    int *size;
+    int *rets;                      // the number of returns.
+    char *leaf;                     // no call but builtins.
+    int *comp;                      // a component of the call graph.
+    int *order;                     // callees first.
+} inline_context_t;
+
+#define IS_DIRECT_CALL(v) ((v)->op == IR_CALL && (v)->args[0]->op == IR_FUNC)
+
+static void measure(inline_context_t *I, ir_func_t *f)
+{
+    int size = 0, rets = 0, leaf = 1;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (v->op == IR_CONST || v->op == IR_FUNC || v->op == IR_ARG) {
+                continue;
+            }
+            ++size;
+            if (v->op == IR_RET) {
+                ++rets;
+            } else if (v->op == IR_CALL) {
+                leaf = 0;
+            }
+        }
+    }
+    I->size[f->mark] = size;
+    I->rets[f->mark] = rets;
+    I->leaf[f->mark] = leaf;
+}
+
+/* The call graph by direct calls, whose components are ordered callees first. */
+static void find_components(inline_context_t *I)
+{
+    int n = I->nfuncs;
+    int *start = (int *)calloc(n + 1, sizeof(int));    // callees of funcs[i] are callee[start[i] .. start[i + 1]).
+    for (int i = 0; i < n; ++i) {
+        for (ir_block_t *b = I->funcs[i]->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (IS_DIRECT_CALL(v)) {
+                    ++start[i + 1];
+                }
+            }
+        }
+        start[i + 1] += start[i];
+    }
+    int *callee = (int *)malloc((start[n] + 1) * sizeof(int));
+    for (int i = 0, k = 0; i < n; ++i) {
+        for (ir_block_t *b = I->funcs[i]->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (IS_DIRECT_CALL(v)) {
+                    callee[k++] = v->args[0]->u.func->mark;
+                }
+            }
+        }
+    }
+    ir_components(n, start, callee, I->comp, I->order);
+    free(callee);
+    free(start);
+}
+
+/* Successors of a block which are moved to another block refer to it as their predecessor. */
+static void replace_pred(ir_block_t *b, ir_block_t *from, ir_block_t *to)
+{
+    ir_block_t *succ[2];
+    int n = ir_successors(b, succ);
+    for (int i = 0; i < n; ++i) {
+        for (int k = 0; k < succ[i]->npred; ++k) {
+            if (succ[i]->pred[k] == from) {
+                succ[i]->pred[k] = to;
+            }
+        }
+    }
+}
+
+/*
+    The block of a call is split after the call, and a copy of the callee is placed between them.
+    An argument is replaced by the operand of the call, and a return jumps to the second half,
+    where a phi joins returned values if there are some returns.
+*/
+static void inline_call(inline_context_t *I, ir_func_t *f, ir_value_t *call)
+{
+    ir_module_t *m = I->m;
+    ir_func_t *g = call->args[0]->u.func;
+    ir_block_t *b = call->block;
+
+    ir_block_t *cont = ir_block_new(m, f);
+    if (call->next) {
+        cont->head = call->next;
+        cont->tail = b->tail;
+        cont->head->prev = NULL;
+        for (ir_value_t *v = cont->head; v; v = v->next) {
+            v->block = cont;
+        }
+        call->next = NULL;
+        b->tail = call;
+        replace_pred(cont, b, cont);
+    }
+    ir_remove(call);
+
+    ir_block_t **bmap = (ir_block_t **)malloc((g->nblocks + 1) * sizeof(ir_block_t *));
+    ir_value_t **vmap = (ir_value_t **)malloc((g->nvalues + 1) * sizeof(ir_value_t *));
+    ir_value_t **args = (ir_value_t **)malloc((g->argc + 1) * sizeof(ir_value_t *));
+    for (int i = 0; i < g->argc; ++i) {
+        args[i] = ir_resolve(call->args[i + 1]);
+    }
+    ir_func_clone(m, f, g, args, bmap, vmap);
+
+    ir_value_t **rets = (ir_value_t **)malloc((I->rets[g->mark] + 1) * sizeof(ir_value_t *));
+    int nrets = 0;
+    for (ir_block_t *gb = g->entry; gb; gb = gb->next) {
+        ir_value_t *t = ir_terminator(bmap[gb->id]);
+        if (t->op == IR_RET) {
+            rets[nrets++] = t->args[0];
+            t->op = IR_JMP;
+            t->argc = 0;
+            t->u.target[0] = cont;
+            ir_block_add_pred(m, cont, t->block);
+        }
+    }
+
+    ir_value_t *j = ir_emit(m, b, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+    j->u.target[0] = bmap[g->entry->id];
+    ir_block_add_pred(m, j->u.target[0], b);
+
+    if (nrets == 1) {
+        call->forward = rets[0];
+    } else {
+        ir_value_t *phi = ir_value_new(m, IR_PHI, call->type, nrets);
+        memcpy(phi->args, rets, nrets * sizeof(ir_value_t *));
+        call->forward = ir_insert_head(cont, phi);
+    }
+    free(rets);
+    free(args);
+    free(vmap);
+    free(bmap);
+}
+
+static int inline_cost(inline_context_t *I, ir_value_t *call)
+{
+    int k = call->args[0]->u.func->mark;
+    int cost = I->size[k] - call->argc;
+    for (int i = 1; i < call->argc; ++i) {
+        if (ir_resolve(call->args[i])->op == IR_CONST) {
+            cost -= IR_INLINE_CONST_BONUS;
+        }
+    }
+    return cost;
+}
+
+static void inline_function(inline_context_t *I, ir_func_t *f)
+{
+    int nsites = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            nsites += IS_DIRECT_CALL(v);
+        }
+    }
+    ir_value_t **sites = (ir_value_t **)malloc((nsites + 1) * sizeof(ir_value_t *));
+    nsites = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (IS_DIRECT_CALL(v)) {
+                sites[nsites++] = v;
+            }
+        }
+    }
+
+    int size = I->size[f->mark];
+    int inlined = 0;
+    for (int i = 0; i < nsites; ++i) {
+        ir_func_t *g = sites[i]->args[0]->u.func;
+        int k = g->mark;
+        if (I->comp[k] == I->comp[f->mark] || I->rets[k] == 0 || g->entry->npred > 0) {
+            continue;
+        }
+        if (inline_cost(I, sites[i]) > (I->leaf[k] ? I->threshold * 2 : I->threshold)) {
+            continue;
+        }
+        if (size + I->size[k] > IR_INLINE_MAX_SIZE) {
+            continue;
+        }
+        inline_call(I, f, sites[i]);
+        size += I->size[k] - 1;
+        ++inlined;
+    }
+    free(sites);
+
+    if (inlined > 0) {
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                for (int i = 0; i < v->argc; ++i) {
+                    v->args[i] = ir_resolve(v->args[i]);
+                }
+            }
+        }
+        ir_func_remove_dead(f);
+        ir_func_merge_blocks(f);
+        I->stats->inlined += inlined;
+    }
+    measure(I, f);
+}
+
+int ir_inline(ir_module_t *m, int threshold, vector_t *keep, ir_inline_stats_t *stats)
+{
+    inline_context_t ctx = { .m = m, .threshold = threshold, .stats = stats };
+    inline_context_t *I = &ctx;
+    memset(stats, 0, sizeof(ir_inline_stats_t));
+
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        f->mark = I->nfuncs++;
+    }
+    int n = I->nfuncs;
+    I->funcs = (ir_func_t **)malloc((n + 1) * sizeof(ir_func_t *));
+    I->size = (int *)calloc(n + 1, sizeof(int));
+    I->rets = (int *)calloc(n + 1, sizeof(int));
+    I->leaf = (char *)calloc(n + 1, 1);
+    I->comp = (int *)calloc(n + 1, sizeof(int));
+    I->order = (int *)calloc(n + 1, sizeof(int));
+    char *referred = (char *)calloc(n + 1, 1);
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        I->funcs[f->mark] = f;
+        measure(I, f);
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (v->op == IR_FUNC) {
+                    referred[v->u.func->mark] = 1;
+                }
+            }
+        }
+    }
+
+    find_components(I);
+    for (int i = 0; i < n; ++i) {
+        inline_function(I, I->funcs[I->order[i]]);
+    }
+    stats->removed = ir_module_remove_functions(m, I->funcs, n, referred, keep);
+
+    free(referred);
+    free(I->order);
+    free(I->comp);
+    free(I->leaf);
+    free(I->rets);
+    free(I->size);
+    free(I->funcs);
+    return stats->inlined;
+}
@@ -0,0 +1,959 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "ir.h"
+
+/*
+    Values, blocks and functions of a module are allocated from chunks, and released at once.
+*/
+ir_module_t *ir_module_new(type_table_t *types)
+{
+    ir_module_t *m = (ir_module_t *)calloc(1, sizeof(ir_module_t));
+    m->types = types;
+    return m;
+}
+
+void ir_module_free(ir_module_t *m)
+{
+    if (!m) {
+        return;
+    }
+    ir_chunk_t *c = m->chunk;
+    while (c) {
+        ir_chunk_t *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(m);
+}
+
+void *ir_alloc(ir_module_t *m, size_t size)
+{
+    size = (size + sizeof(int64_t) - 1) & ~(sizeof(int64_t) - 1);
+    ir_chunk_t *c = m->chunk;
+    if (!c || c->used + size > c->size) {
+        size_t cap = size > IR_CHUNK_SIZE ? size : IR_CHUNK_SIZE;
+        c = (ir_chunk_t *)malloc(offsetof(ir_chunk_t, word) + cap);
+        c->used = 0;
+        c->size = cap;
+        if (cap > IR_CHUNK_SIZE && m->chunk) {
+            /* a big one is used up at once, so the current chunk is kept. */
+            c->next = m->chunk->next;
+            m->chunk->next = c;
+        } else {
+            c->next = m->chunk;
+            m->chunk = c;
+        }
+    }
+    void *p = (char *)c->word + c->used;
+    c->used += size;
+    memset(p, 0, size);
+    return p;
+}
+
+static void *ir_grow(ir_module_t *m, void *array, int count, int *cap, size_t size)
+{
+    *cap = *cap ? *cap * 2 : 4;
+    void *p = ir_alloc(m, *cap * size);
+    if (count > 0) {
+        memcpy(p, array, count * size);
+    }
+    return p;
+}
+
+ir_func_t *ir_func_new(ir_module_t *m, string_t *name, int type)
+{
+    ir_func_t *f = (ir_func_t *)ir_alloc(m, sizeof(ir_func_t));
+    f->name = name;
+    f->type = type;
+    if (type) {
+        type_t *t = type_get(m->types, type);
+        f->rtype = t->rtype;
+        f->argc = t->argc;
+    }
+    f->entry = ir_block_new(m, f);
+    f->entry->sealed = 1;
+    if (m->lastfunc) {
+        m->lastfunc->next = f;
+    } else {
+        m->funcs = f;
+    }
+    m->lastfunc = f;
+    return f;
+}
+
+ir_global_t *ir_global_new(ir_module_t *m, string_t *name, int type)
+{
+    ir_global_t *g = (ir_global_t *)ir_alloc(m, sizeof(ir_global_t));
+    g->name = name;
+    g->type = type;
+    if (m->lastglobal) {
+        m->lastglobal->next = g;
+    } else {
+        m->globals = g;
+    }
+    m->lastglobal = g;
+    return g;
+}
+
+ir_block_t *ir_block_new(ir_module_t *m, ir_func_t *f)
+{
+    ir_block_t *b = (ir_block_t *)ir_alloc(m, sizeof(ir_block_t));
+    b->id = f->nblocks++;
+    if (f->last) {
+        f->last->next = b;
+    } else {
+        f->entry = b;
+    }
+    f->last = b;
+    return b;
+}
+
+void ir_block_add_pred(ir_module_t *m, ir_block_t *b, ir_block_t *pred)
+{
+    if (b->npred == b->predcap) {
+        b->pred = (ir_block_t **)ir_grow(m, b->pred, b->npred, &(b->predcap), sizeof(ir_block_t *));
+    }
+    b->pred[b->npred++] = pred;
+}
+
+/* An edge from pred is removed with operands of phis for it. */
+void ir_block_remove_pred(ir_block_t *b, ir_block_t *pred)
+{
+    int i = 0;
+    while (i < b->npred && b->pred[i] != pred) {
+        ++i;
+    }
+    if (i == b->npred) {
+        return;
+    }
+    for (int k = i + 1; k < b->npred; ++k) {
+        b->pred[k - 1] = b->pred[k];
+    }
+    for (ir_value_t *phi = b->head; phi && phi->op == IR_PHI; phi = phi->next) {
+        for (int k = i + 1; k < phi->argc; ++k) {
+            phi->args[k - 1] = phi->args[k];
+        }
+        --phi->argc;
+    }
+    --b->npred;
+}
+
+ir_value_t *ir_value_new(ir_module_t *m, enum ir_op op, int type, int argc)
+{
+    ir_value_t *v = (ir_value_t *)ir_alloc(m, sizeof(ir_value_t));
+    v->op = op;
+    v->type = type;
+    v->argc = v->argcap = argc;
+    if (argc > 0) {
+        v->args = (ir_value_t **)ir_alloc(m, argc * sizeof(ir_value_t *));
+    }
+    return v;
+}
+
+ir_value_t *ir_append(ir_block_t *b, ir_value_t *v)
+{
+    v->block = b;
+    v->prev = b->tail;
+    v->next = NULL;
+    if (b->tail) {
+        b->tail->next = v;
+    } else {
+        b->head = v;
+    }
+    b->tail = v;
+    return v;
+}
+
+/* A phi is placed at the top of a block, and other values after phis. */
+ir_value_t *ir_insert_head(ir_block_t *b, ir_value_t *v)
+{
+    ir_value_t *prev = NULL;
+    if (v->op != IR_PHI) {
+        for (ir_value_t *p = b->head; p && p->op == IR_PHI; p = p->next) {
+            prev = p;
+        }
+    }
+    v->block = b;
+    v->prev = prev;
+    v->next = prev ? prev->next : b->head;
+    if (v->next) {
+        v->next->prev = v;
+    } else {
+        b->tail = v;
+    }
+    if (prev) {
+        prev->next = v;
+    } else {
+        b->head = v;
+    }
+    return v;
+}
+
+ir_value_t *ir_insert_before(ir_value_t *pos, ir_value_t *v)
+{
+    ir_block_t *b = pos->block;
+    v->block = b;
+    v->prev = pos->prev;
+    v->next = pos;
+    if (pos->prev) {
+        pos->prev->next = v;
+    } else {
+        b->head = v;
+    }
+    pos->prev = v;
+    return v;
+}
+
+void ir_remove(ir_value_t *v)
+{
+    ir_block_t *b = v->block;
+    if (v->prev) {
+        v->prev->next = v->next;
+    } else {
+        b->head = v->next;
+    }
+    if (v->next) {
+        v->next->prev = v->prev;
+    } else {
+        b->tail = v->prev;
+    }
+    v->prev = v->next = NULL;
+}
+
+ir_value_t *ir_emit(ir_module_t *m, ir_block_t *b, enum ir_op op, int type, ir_value_t *a0, ir_value_t *a1)
+{
+    ir_value_t *v = ir_value_new(m, op, type, a1 ? 2 : (a0 ? 1 : 0));
+    if (a0) {
+        v->args[0] = a0;
+    }
+    if (a1) {
+        v->args[1] = a1;
+    }
+    return ir_append(b, v);
+}
+
+ir_value_t *ir_const_int(ir_module_t *m, ir_block_t *b, int64_t iv)
+{
+    ir_value_t *v = ir_value_new(m, IR_CONST, VALTYPE_INT, 0);
+    v->u.iv = iv;
+    return ir_append(b, v);
+}
+
+ir_value_t *ir_const_dbl(ir_module_t *m, ir_block_t *b, double dv)
+{
+    ir_value_t *v = ir_value_new(m, IR_CONST, VALTYPE_DBL, 0);
+    v->u.dv = dv;
+    return ir_append(b, v);
+}
+
+ir_value_t *ir_const_str(ir_module_t *m, ir_block_t *b, string_t *sv)
+{
+    ir_value_t *v = ir_value_new(m, IR_CONST, VALTYPE_STR, 0);
+    v->u.sv = sv;
+    return ir_append(b, v);
+}
+
+ir_value_t *ir_terminator(ir_block_t *b)
+{
+    return (b->tail && IR_IS_TERMINATOR(b->tail->op)) ? b->tail : NULL;
+}
+
+int ir_successors(ir_block_t *b, ir_block_t **succ)
+{
+    ir_value_t *t = ir_terminator(b);
+    if (!t || t->op == IR_RET) {
+        return 0;
+    }
+    succ[0] = t->u.target[0];
+    if (t->op == IR_JMP) {
+        return 1;
+    }
+    succ[1] = t->u.target[1];
+    return 2;
+}
+
+ir_value_t *ir_resolve(ir_value_t *v)
+{
+    ir_value_t *r = v;
+    while (r && r->forward) {
+        r = r->forward;
+    }
+    while (v && v->forward && v->forward != r) {
+        ir_value_t *next = v->forward;
+        v->forward = r;
+        v = next;
+    }
+    return r;
+}
+
+/*
+    Folds an operation of constants the same as the generated C on int64_t and double.
+    Returns 0 for an operation which is undefined in C, such as division by zero, and for fmod.
+    A double result which is not finite is not folded either, because C has no literal for it.
+*/
+static int fold_int(enum ir_op op, int64_t a, int64_t b, int64_t *r)
+{
+    uint64_t ua = (uint64_t)a, ub = (uint64_t)b;
+    switch (op) {
+    case IR_IADD: *r = (int64_t)(ua + ub); return 1;
+    case IR_ISUB: *r = (int64_t)(ua - ub); return 1;
+    case IR_IMUL: *r = (int64_t)(ua * ub); return 1;
+    case IR_IDIV:
+    case IR_IMOD:
+        if (b == 0 || (a == INT64_MIN && b == -1)) {
+            return 0;
+        }
+        *r = (op == IR_IDIV) ? a / b : a % b;
+        return 1;
+    case IR_IEQ: *r = a == b; return 1;
+    case IR_INE: *r = a != b; return 1;
+    case IR_ILT: *r = a < b; return 1;
+    case IR_ILE: *r = a <= b; return 1;
+    case IR_IGT: *r = a > b; return 1;
+    case IR_IGE: *r = a >= b; return 1;
+    default:
+        ;
+    }
+    return 0;
+}
+
+static int fold_dbl(enum ir_op op, double a, double b, ir_scalar_t *r)
+{
+    r->type = VALTYPE_DBL;
+    switch (op) {
+    case IR_FADD: r->u.dv = a + b; return isfinite(r->u.dv);
+    case IR_FSUB: r->u.dv = a - b; return isfinite(r->u.dv);
+    case IR_FMUL: r->u.dv = a * b; return isfinite(r->u.dv);
+    case IR_FDIV: r->u.dv = a / b; return isfinite(r->u.dv);
+    default:
+        ;
+    }
+    r->type = VALTYPE_INT;
+    switch (op) {
+    case IR_FEQ: r->u.iv = a == b; return 1;
+    case IR_FNE: r->u.iv = a != b; return 1;
+    case IR_FLT: r->u.iv = a < b; return 1;
+    case IR_FLE: r->u.iv = a <= b; return 1;
+    case IR_FGT: r->u.iv = a > b; return 1;
+    case IR_FGE: r->u.iv = a >= b; return 1;
+    default:
+        ;
+    }
+    return 0;
+}
+
+int ir_fold(enum ir_op op, const ir_scalar_t *a, const ir_scalar_t *b, ir_scalar_t *r)
+{
+    if (op >= IR_IADD && op <= IR_IGE) {
+        r->type = VALTYPE_INT;
+        return fold_int(op, a->u.iv, b->u.iv, &(r->u.iv));
+    }
+    if (op >= IR_FADD && op <= IR_FGE) {
+        return fold_dbl(op, a->u.dv, b->u.dv, r);
+    }
+    if (op == IR_I2F) {
+        r->type = VALTYPE_DBL;
+        r->u.dv = (double)a->u.iv;
+        return 1;
+    }
+    if (op == IR_F2I) {
+        /* out of range is undefined in C. */
+        r->type = VALTYPE_INT;
+        if (a->u.dv > -9223372036854775808.0 && a->u.dv < 9223372036854775808.0) {
+            r->u.iv = (int64_t)a->u.dv;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+    SSA construction, see "Simple and Efficient Construction of Static Single Assignment Form"
+    by Braun et al. A variable of the source is written and read per block, a read in a block
+    without a definition looks into predecessors, and a phi is placed where they join.
+    A block is sealed when all predecessors are known, and phis placed in it before that
+    get operands then. Trivial phis are removed by ir_func_finish().
+*/
+int ir_var_new(ir_func_t *f, int type)
+{
+    if (f->nvars == f->varcap) {
+        f->varcap = f->varcap ? f->varcap * 2 : 16;
+        f->vartype = (int *)realloc(f->vartype, f->varcap * sizeof(int));
+    }
+    f->vartype[f->nvars] = type;
+    return f->nvars++;
+}
+
+void ir_var_write(ir_module_t *m, ir_block_t *b, int var, ir_value_t *v)
+{
+    if (var >= b->ndefs) {
+        int ndefs = b->ndefs ? b->ndefs : 8;
+        while (ndefs <= var) {
+            ndefs *= 2;
+        }
+        ir_value_t **defs = (ir_value_t **)ir_alloc(m, ndefs * sizeof(ir_value_t *));
+        if (b->ndefs > 0) {
+            memcpy(defs, b->defs, b->ndefs * sizeof(ir_value_t *));
+        }
+        b->defs = defs;
+        b->ndefs = ndefs;
+    }
+    b->defs[var] = v;
+}
+
+static ir_value_t *ir_phi_new(ir_module_t *m, ir_func_t *f, ir_block_t *b, int var)
+{
+    ir_value_t *phi = ir_value_new(m, IR_PHI, f->vartype[var], 0);
+    phi->u.var = var;
+    return ir_insert_head(b, phi);
+}
+
+void ir_phi_add(ir_module_t *m, ir_value_t *phi, ir_value_t *v)
+{
+    if (phi->argc == phi->argcap) {
+        phi->args = (ir_value_t **)ir_grow(m, phi->args, phi->argc, &(phi->argcap), sizeof(ir_value_t *));
+    }
+    phi->args[phi->argc++] = v;
+}
+
+static ir_value_t *ir_zero(ir_module_t *m, ir_block_t *b, int type)
+{
+    ir_value_t *v = ir_value_new(m, IR_CONST, type == VALTYPE_DBL ? VALTYPE_DBL : VALTYPE_INT, 0);
+    return ir_insert_head(b, v);
+}
+
+static void ir_phi_operands(ir_module_t *m, ir_func_t *f, ir_value_t *phi)
+{
+    ir_block_t *b = phi->block;
+    for (int i = 0; i < b->npred; ++i) {
+        ir_phi_add(m, phi, ir_var_read(m, f, b->pred[i], phi->u.var));
+    }
+}
+
+ir_value_t *ir_var_read(ir_module_t *m, ir_func_t *f, ir_block_t *b, int var)
+{
+    ir_block_t *start = b;
+    ir_value_t *v = NULL;
+
+    /* a chain of single predecessors is followed without recursion. */
+    while (!(var < b->ndefs && b->defs[var])) {
+        if (!b->sealed) {
+            v = ir_phi_new(m, f, b, var);
+            if (b->nincomplete == b->incap) {
+                b->incomplete = (ir_value_t **)ir_grow(m, b->incomplete, b->nincomplete, &(b->incap), sizeof(ir_value_t *));
+            }
+            b->incomplete[b->nincomplete++] = v;
+            ir_var_write(m, b, var, v);
+        } else if (b->npred == 0) {
+            /* read before any definition, it is zero as a variable without an initializer. */
+            v = ir_zero(m, b, f->vartype[var]);
+            ir_var_write(m, b, var, v);
+        } else if (b->npred == 1) {
+            b = b->pred[0];
+            continue;
+        } else {
+            /* written before reading operands, which breaks a cycle through this block. */
+            v = ir_phi_new(m, f, b, var);
+            ir_var_write(m, b, var, v);
+            ir_phi_operands(m, f, v);
+        }
+        break;
+    }
+    if (!v) {
+        v = ir_resolve(b->defs[var]);
+    }
+    for (ir_block_t *p = start; p != b; p = p->pred[0]) {
+        ir_var_write(m, p, var, v);
+    }
+    return v;
+}
+
+void ir_block_seal(ir_module_t *m, ir_func_t *f, ir_block_t *b)
+{
+    if (b->sealed) {
+        return;
+    }
+    b->sealed = 1;
+    for (int i = 0; i < b->nincomplete; ++i) {
+        ir_phi_operands(m, f, b->incomplete[i]);
+    }
+    b->nincomplete = 0;
+}
+
+static void ir_mark_reachable(ir_func_t *f)
+{
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        b->mark = 0;
+    }
+    ir_block_t **stack = (ir_block_t **)malloc((f->nblocks + 1) * sizeof(ir_block_t *));
+    int sp = 0;
+    stack[sp++] = f->entry;
+    f->entry->mark = 1;
+    while (sp > 0) {
+        ir_block_t *succ[2];
+        ir_block_t *b = stack[--sp];
+        int n = ir_successors(b, succ);
+        for (int i = 0; i < n; ++i) {
+            if (!succ[i]->mark) {
+                succ[i]->mark = 1;
+                stack[sp++] = succ[i];
+            }
+        }
+    }
+    free(stack);
+}
+
+/* Predecessors which are not reachable are dropped with their phi operands. */
+static void ir_drop_unreachable_preds(ir_block_t *b)
+{
+    int n = 0;
+    for (int i = 0; i < b->npred; ++i) {
+        if (!b->pred[i]->mark) {
+            continue;
+        }
+        for (ir_value_t *phi = b->head; phi && phi->op == IR_PHI; phi = phi->next) {
+            phi->args[n] = phi->args[i];
+        }
+        b->pred[n++] = b->pred[i];
+    }
+    for (ir_value_t *phi = b->head; phi && phi->op == IR_PHI; phi = phi->next) {
+        phi->argc = n;
+    }
+    b->npred = n;
+}
+
+static int ir_remove_trivial_phis(ir_module_t *m, ir_func_t *f)
+{
+    int removed = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        ir_value_t *phi = b->head;
+        while (phi && phi->op == IR_PHI) {
+            ir_value_t *next = phi->next;
+            ir_value_t *same = NULL;
+            int trivial = 1;
+            for (int i = 0; i < phi->argc; ++i) {
+                ir_value_t *v = ir_resolve(phi->args[i]);
+                if (v == same || v == phi) {
+                    continue;
+                }
+                if (same) {
+                    trivial = 0;
+                    break;
+                }
+                same = v;
+            }
+            if (trivial) {
+                if (!same) {
+                    same = ir_zero(m, f->entry, phi->type);
+                }
+                phi->forward = same;
+                ir_remove(phi);
+                ++removed;
+            }
+            phi = next;
+        }
+    }
+    return removed;
+}
+
+/*
+    Finishes construction, blocks not reachable and trivial phis are removed,
+    and every operand is resolved to a value in the function.
+*/
+void ir_func_finish(ir_module_t *m, ir_func_t *f)
+{
+    ir_mark_reachable(f);
+    ir_block_t *prev = NULL;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        if (!b->mark) {
+            continue;
+        }
+        ir_drop_unreachable_preds(b);
+        if (prev) {
+            prev->next = b;
+        }
+        prev = b;
+    }
+    prev->next = NULL;
+    f->last = prev;
+
+    while (ir_remove_trivial_phis(m, f) > 0) {
+        ;
+    }
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            for (int i = 0; i < v->argc; ++i) {
+                v->args[i] = ir_resolve(v->args[i]);
+            }
+        }
+        b->defs = NULL;
+        b->ndefs = 0;
+        b->incomplete = NULL;
+        b->nincomplete = b->incap = 0;
+    }
+    free(f->vartype);
+    f->vartype = NULL;
+    f->nvars = f->varcap = 0;
+    ir_func_number(f);
+}
+
+/*
+    A block which is jumped to only from its single predecessor is merged into the predecessor,
+    and the number of merged blocks is returned. Phis must have been removed from such a block.
+*/
+int ir_func_merge_blocks(ir_func_t *f)
+{
+    int merged = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        b->mark = 0;
+    }
+    for (ir_block_t *b = f->entry; b; ) {
+        ir_value_t *t = ir_terminator(b);
+        ir_block_t *s = (t && t->op == IR_JMP) ? t->u.target[0] : NULL;
+        if (!s || s == b || s == f->entry || s->npred != 1 || (s->head && s->head->op == IR_PHI)) {
+            b = b->next;
+            continue;
+        }
+
+        ir_remove(t);
+        for (ir_value_t *v = s->head; v; v = v->next) {
+            v->block = b;
+        }
+        if (b->tail) {
+            b->tail->next = s->head;
+        } else {
+            b->head = s->head;
+        }
+        if (s->head) {
+            s->head->prev = b->tail;
+            b->tail = s->tail;
+        }
+        ir_block_t *succ[2];
+        int n = ir_successors(b, succ);
+        for (int i = 0; i < n; ++i) {
+            for (int k = 0; k < succ[i]->npred; ++k) {
+                if (succ[i]->pred[k] == s) {
+                    succ[i]->pred[k] = b;
+                }
+            }
+        }
+        s->head = s->tail = NULL;
+        s->npred = 0;
+        s->mark = 1;
+        ++merged;
+    }
+
+    ir_block_t *prev = NULL;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        if (b->mark) {
+            continue;
+        }
+        if (prev) {
+            prev->next = b;
+        }
+        prev = b;
+    }
+    prev->next = NULL;
+    f->last = prev;
+    ir_func_number(f);
+    return merged;
+}
+
+/* Values which are pure or loads and not used are removed, and the number of them is returned. */
+int ir_func_remove_dead(ir_func_t *f)
+{
+    ir_func_number(f);
+    int n = f->nvalues;
+    int *uses = (int *)calloc(n + 1, sizeof(int));
+    ir_value_t **stack = (ir_value_t **)malloc((n + 1) * sizeof(ir_value_t *));
+    int sp = 0, removed = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            for (int i = 0; i < v->argc; ++i) {
+                ++uses[v->args[i]->id];
+            }
+        }
+    }
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (uses[v->id] == 0 && (IR_IS_PURE(v->op) || v->op == IR_LOAD)) {
+                stack[sp++] = v;
+            }
+        }
+    }
+    while (sp > 0) {
+        ir_value_t *v = stack[--sp];
+        ir_remove(v);
+        ++removed;
+        for (int i = 0; i < v->argc; ++i) {
+            ir_value_t *a = v->args[i];
+            if (--uses[a->id] == 0 && a != v && (IR_IS_PURE(a->op) || a->op == IR_LOAD)) {
+                stack[sp++] = a;
+            }
+        }
+    }
+    free(stack);
+    free(uses);
+    ir_func_number(f);
+    return removed;
+}
+
+/*
+    Blocks of g are copied into f, where an argument of g is replaced by args[index].
+    Maps from ids of g to copies are filled, and terminators are copied as they are.
+*/
+void ir_func_clone(ir_module_t *m, ir_func_t *f, ir_func_t *g, ir_value_t **args, ir_block_t **bmap, ir_value_t **vmap)
+{
+    for (ir_block_t *gb = g->entry; gb; gb = gb->next) {
+        bmap[gb->id] = ir_block_new(m, f);
+        bmap[gb->id]->sealed = 1;
+    }
+    for (ir_block_t *gb = g->entry; gb; gb = gb->next) {
+        for (ir_value_t *gv = gb->head; gv; gv = gv->next) {
+            if (gv->op == IR_ARG) {
+                vmap[gv->id] = args[gv->u.iv];
+                continue;
+            }
+            ir_value_t *v = ir_value_new(m, gv->op, gv->type, gv->argc);
+            v->u = gv->u;
+            vmap[gv->id] = ir_append(bmap[gb->id], v);
+        }
+    }
+    for (ir_block_t *gb = g->entry; gb; gb = gb->next) {
+        ir_block_t *b = bmap[gb->id];
+        for (int i = 0; i < gb->npred; ++i) {
+            ir_block_add_pred(m, b, bmap[gb->pred[i]->id]);
+        }
+        for (ir_value_t *gv = gb->head; gv; gv = gv->next) {
+            if (gv->op == IR_ARG) {
+                continue;
+            }
+            ir_value_t *v = vmap[gv->id];
+            for (int i = 0; i < gv->argc; ++i) {
+                v->args[i] = vmap[gv->args[i]->id];
+            }
+            if (gv->op == IR_JMP || gv->op == IR_BR) {
+                v->u.target[0] = bmap[gv->u.target[0]->id];
+                if (gv->op == IR_BR) {
+                    v->u.target[1] = bmap[gv->u.target[1]->id];
+                }
+            }
+        }
+    }
+}
+
+/*
+    Functions are funcs[mark], all of the module. A function which was referred before a pass,
+    and is reachable no more from main and the names kept, is removed. Functions which were
+    never referred are left to --dce. Returns the number of removed functions.
+*/
+int ir_module_remove_functions(ir_module_t *m, ir_func_t **funcs, int n, const char *referred, vector_t *keep)
+{
+    int removed = 0;
+    char *live = (char *)calloc(n + 1, 1);
+    int *stack = (int *)malloc((n + 1) * sizeof(int));
+    int sp = 0;
+    for (int i = 0; i < n; ++i) {
+        ir_func_t *f = funcs[i];
+        int kept = !referred[i] || f == m->main;
+        for (int k = 0; !kept && keep && k < keep->count; ++k) {
+            kept = f->name == (string_t *)vector_get(keep, k);
+        }
+        if (kept) {
+            live[i] = 1;
+            stack[sp++] = i;
+        }
+    }
+    while (sp > 0) {
+        ir_func_t *f = funcs[stack[--sp]];
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (v->op == IR_FUNC && !live[v->u.func->mark]) {
+                    live[v->u.func->mark] = 1;
+                    stack[sp++] = v->u.func->mark;
+                }
+            }
+        }
+    }
+
+    ir_func_t *prev = NULL;
+    for (int i = 0; i < n; ++i) {
+        if (!live[i]) {
+            ++removed;
+            continue;
+        }
+        if (prev) {
+            prev->next = funcs[i];
+        } else {
+            m->funcs = funcs[i];
+        }
+        prev = funcs[i];
+    }
+    prev->next = NULL;
+    m->lastfunc = prev;
+    free(stack);
+    free(live);
+    return removed;
+}
+
+void ir_func_number(ir_func_t *f)
+{
+    int nb = 0, nv = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        b->id = nb++;
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            v->id = nv++;
+        }
+    }
+    f->nblocks = nb;
+    f->nvalues = nv;
+}
+
+static ir_block_t *ir_intersect(ir_block_t *a, ir_block_t *b)
+{
+    while (a != b) {
+        while (a->rpo > b->rpo) {
+            a = a->idom;
+        }
+        while (b->rpo > a->rpo) {
+            b = b->idom;
+        }
+    }
+    return a;
+}
+
+/*
+    Reverse post order and immediate dominators, see "A Simple, Fast Dominance Algorithm"
+    by Cooper et al. A block not reachable has rpo of -1 and no idom.
+*/
+void ir_func_dominators(ir_func_t *f)
+{
+    int n = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        b->mark = 0;
+        b->rpo = -1;
+        b->idom = NULL;
+        ++n;
+    }
+
+    ir_block_t **order = (ir_block_t **)malloc(n * sizeof(ir_block_t *));
+    ir_block_t **stack = (ir_block_t **)malloc(n * sizeof(ir_block_t *));
+    int *index = (int *)malloc(n * sizeof(int));
+    int sp = 0, count = 0;
+    stack[sp] = f->entry;
+    index[sp++] = 0;
+    f->entry->mark = 1;
+    while (sp > 0) {
+        ir_block_t *succ[2];
+        ir_block_t *b = stack[sp - 1];
+        int ns = ir_successors(b, succ);
+        if (index[sp - 1] < ns) {
+            ir_block_t *s = succ[index[sp - 1]++];
+            if (!s->mark) {
+                s->mark = 1;
+                stack[sp] = s;
+                index[sp++] = 0;
+            }
+            continue;
+        }
+        order[count++] = b;
+        --sp;
+    }
+    for (int i = 0; i < count; ++i) {
+        order[i]->rpo = count - 1 - i;
+    }
+
+    f->entry->idom = f->entry;
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = count - 2; i >= 0; --i) {
+            ir_block_t *b = order[i];
+            ir_block_t *idom = NULL;
+            for (int k = 0; k < b->npred; ++k) {
+                ir_block_t *p = b->pred[k];
+                if (p->rpo < 0 || !p->idom) {
+                    continue;
+                }
+                idom = idom ? ir_intersect(p, idom) : p;
+            }
+            if (idom != b->idom) {
+                b->idom = idom;
+                changed = 1;
+            }
+        }
+    }
+
+    free(index);
+    free(stack);
+    free(order);
+}
+
+/*
+    Strongly connected components of a graph of n nodes by Tarjan's algorithm with an explicit stack,
+    where edges of node i are edge[start[i] .. start[i + 1]). A component is numbered when it is
+    completed, so a component reached from another one comes first in order.
+    Returns the number of components.
+*/
+int ir_components(int n, const int *start, const int *edge, int *comp, int *order)
+{
+    int *index = (int *)malloc((n + 1) * sizeof(int));
+    int *low = (int *)malloc((n + 1) * sizeof(int));
+    char *onstack = (char *)calloc(n + 1, 1);
+    int *stack = (int *)malloc((n + 1) * sizeof(int));
+    int *frame = (int *)malloc((n + 1) * sizeof(int));
+    int *next = (int *)malloc((n + 1) * sizeof(int));
+    int count = 0, sp = 0, fp = 0, ncomp = 0, norder = 0;
+    for (int i = 0; i < n; ++i) {
+        index[i] = -1;
+    }
+
+    for (int root = 0; root < n; ++root) {
+        if (index[root] >= 0) {
+            continue;
+        }
+        index[root] = low[root] = count++;
+        stack[sp++] = root;
+        onstack[root] = 1;
+        frame[fp] = root;
+        next[fp++] = start[root];
+        while (fp > 0) {
+            int v = frame[fp - 1];
+            if (next[fp - 1] < start[v + 1]) {
+                int w = edge[next[fp - 1]++];
+                if (index[w] < 0) {
+                    index[w] = low[w] = count++;
+                    stack[sp++] = w;
+                    onstack[w] = 1;
+                    frame[fp] = w;
+                    next[fp++] = start[w];
+                } else if (onstack[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+            --fp;
+            if (fp > 0 && low[v] < low[frame[fp - 1]]) {
+                low[frame[fp - 1]] = low[v];
+            }
+            if (low[v] == index[v]) {
+                int w;
+                do {
+                    w = stack[--sp];
+                    onstack[w] = 0;
+                    comp[w] = ncomp;
+                    order[norder++] = w;
+                } while (w != v);
+                ++ncomp;
+            }
+        }
+    }
+
+    free(next);
+    free(frame);
+    free(stack);
+    free(onstack);
+    free(low);
+    free(index);
+    return ncomp;
+}
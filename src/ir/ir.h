@@ -0,0 +1,299 @@
+#ifndef KISS_IR_H
+#define KISS_IR_H
+
+#include <stdint.h>
+#include "xstring.h"
+#include "xvector.h"
+#include "../ast/node.h"
+
+/*
+    Typed SSA intermediate representation.
+    A function is a list of basic blocks, and a block is a list of values (instructions)
+    which starts with phis and ends with exactly one terminator. Every value has a type id
+    of the type table, and operations are explicit about int64 and double.
+*/
+enum ir_op {
+    IR_NOP,
+
+    /* constants and parameters, a constant has a type of int, dbl or str. */
+    IR_CONST,
+    IR_FUNC,                        // an address of a function.
+    IR_ARG,
+    IR_PHI,
+
+    /* int64 operations, a comparison results in int. */
+    IR_IADD,
+    IR_ISUB,
+    IR_IMUL,
+    IR_IDIV,
+    IR_IMOD,
+    IR_IEQ,
+    IR_INE,
+    IR_ILT,
+    IR_ILE,
+    IR_IGT,
+    IR_IGE,
+
+    /* double operations, a comparison results in int. */
+    IR_FADD,
+    IR_FSUB,
+    IR_FMUL,
+    IR_FDIV,
+    IR_FMOD,
+    IR_FEQ,
+    IR_FNE,
+    IR_FLT,
+    IR_FLE,
+    IR_FGT,
+    IR_FGE,
+
+    /* conversions. */
+    IR_I2F,
+    IR_F2I,
+
+    /* a global variable, which is a top level variable. */
+    IR_LOAD,
+    IR_STORE,
+
+    /* calls, args[0] of IR_CALL is a callee. */
+    IR_CALL,
+    IR_CALLB,                       // a builtin function.
+
+    /* terminators. */
+    IR_JMP,
+    IR_BR,                          // args[0] is an int condition.
+    IR_RET,                         // args[0] is a value if any.
+};
+
+#define IR_IS_TERMINATOR(op) ((op) >= IR_JMP)
+/* no side effect and no trap, division is not since it traps by zero. */
+#define IR_IS_PURE(op) \
+    ((op) == IR_CONST || (op) == IR_FUNC || (op) == IR_PHI || ((op) >= IR_IADD && (op) <= IR_IMUL) || \
+     ((op) >= IR_IEQ && (op) <= IR_F2I))
+/* a direct call whose value is returned at once. */
+#define IR_IS_TAIL_CALL(v) \
+    ((v)->op == IR_CALL && (v)->args[0]->op == IR_FUNC && (v)->next && (v)->next->op == IR_RET && \
+     (v)->next->argc == 1 && (v)->next->args[0] == (v))
+#define IR_CHUNK_SIZE (64 * 1024)
+
+struct ir_block_;
+struct ir_func_;
+struct ir_global_;
+
+typedef struct ir_value_ {
+    enum ir_op op;
+    int type;                       // type id.
+    int id;                         // number in a function.
+    struct ir_block_ *block;
+    struct ir_value_ *prev;
+    struct ir_value_ *next;
+    struct ir_value_ *forward;      // a value to be used instead of a removed one.
+    int argc;
+    int argcap;
+    struct ir_value_ **args;
+    union {
+        int64_t iv;                 // IR_CONST of int, IR_ARG as an index.
+        double dv;                  // IR_CONST of dbl
+        string_t *sv;               // IR_CONST of str, IR_CALLB as a name.
+        struct ir_func_ *func;      // IR_FUNC
+        struct ir_global_ *global;  // IR_LOAD, IR_STORE
+        struct ir_block_ *target[2];// IR_JMP, IR_BR as then and else.
+        int var;                    // IR_PHI, a variable while constructing.
+    } u;
+} ir_value_t;
+
+/* A constant of int or dbl while folding. */
+typedef struct ir_scalar_ {
+    int type;
+    union {
+        int64_t iv;
+        double dv;
+    } u;
+} ir_scalar_t;
+
+typedef struct ir_block_ {
+    int id;
+    struct ir_block_ *next;
+    ir_value_t *head;
+    ir_value_t *tail;
+    struct ir_block_ **pred;
+    int npred;
+    int predcap;
+
+    /* only while constructing. */
+    int sealed;                     // all predecessors are known.
+    ir_value_t **defs;              // the current value of each variable.
+    int ndefs;
+    ir_value_t **incomplete;        // phis to get operands when sealed.
+    int nincomplete;
+    int incap;
+
+    /* used by analyses. */
+    int mark;
+    int rpo;                        // reverse post order, -1 if not reachable.
+    struct ir_block_ *idom;
+} ir_block_t;
+
+/* How the backend caches results of a function, see memo.c. */
+enum ir_memo {
+    IR_MEMO_NONE,
+    IR_MEMO_DIRECT,                 // a table by the int argument, and a hash table out of its range.
+    IR_MEMO_HASH,                   // a hash table by all arguments.
+};
+
+typedef struct ir_func_ {
+    string_t *name;
+    int type;                       // function type id, 0 for main.
+    int rtype;
+    int argc;
+    node_t *node;                   // STMT_FUNC, or NULL for main.
+    ir_block_t *entry;
+    ir_block_t *last;
+    int nblocks;
+    int nvalues;
+    int *vartype;                   // types of variables while constructing.
+    int nvars;
+    int varcap;
+    int mark;                       // used by analyses.
+    int memo;                       // enum ir_memo.
+    struct ir_func_ *next;
+} ir_func_t;
+
+typedef struct ir_global_ {
+    string_t *name;
+    int type;
+    struct ir_global_ *next;
+} ir_global_t;
+
+typedef struct ir_chunk_ {
+    struct ir_chunk_ *next;
+    size_t used;
+    size_t size;
+    int64_t word[1];
+} ir_chunk_t;
+
+typedef struct ir_module_ {
+    type_table_t *types;
+    ir_func_t *funcs;               // functions in the order of definitions.
+    ir_func_t *lastfunc;
+    ir_func_t *main;                // the top level code.
+    ir_global_t *globals;
+    ir_global_t *lastglobal;
+    ir_chunk_t *chunk;
+} ir_module_t;
+
+/* ir.c */
+extern ir_module_t *ir_module_new(type_table_t *types);
+extern void ir_module_free(ir_module_t *m);
+extern void *ir_alloc(ir_module_t *m, size_t size);
+extern ir_func_t *ir_func_new(ir_module_t *m, string_t *name, int type);
+extern ir_global_t *ir_global_new(ir_module_t *m, string_t *name, int type);
+extern ir_block_t *ir_block_new(ir_module_t *m, ir_func_t *f);
+extern void ir_block_add_pred(ir_module_t *m, ir_block_t *b, ir_block_t *pred);
+extern void ir_block_remove_pred(ir_block_t *b, ir_block_t *pred);
+extern ir_value_t *ir_value_new(ir_module_t *m, enum ir_op op, int type, int argc);
+extern ir_value_t *ir_append(ir_block_t *b, ir_value_t *v);
+extern ir_value_t *ir_insert_head(ir_block_t *b, ir_value_t *v);
+extern ir_value_t *ir_insert_before(ir_value_t *pos, ir_value_t *v);
+extern void ir_remove(ir_value_t *v);
+extern ir_value_t *ir_emit(ir_module_t *m, ir_block_t *b, enum ir_op op, int type, ir_value_t *a0, ir_value_t *a1);
+extern ir_value_t *ir_const_int(ir_module_t *m, ir_block_t *b, int64_t iv);
+extern ir_value_t *ir_const_dbl(ir_module_t *m, ir_block_t *b, double dv);
+extern ir_value_t *ir_const_str(ir_module_t *m, ir_block_t *b, string_t *sv);
+extern ir_value_t *ir_terminator(ir_block_t *b);
+extern int ir_successors(ir_block_t *b, ir_block_t **succ);
+extern ir_value_t *ir_resolve(ir_value_t *v);
+extern int ir_fold(enum ir_op op, const ir_scalar_t *a, const ir_scalar_t *b, ir_scalar_t *r);
+
+/* SSA construction by variables, see ir.c. */
+extern int ir_var_new(ir_func_t *f, int type);
+extern void ir_var_write(ir_module_t *m, ir_block_t *b, int var, ir_value_t *v);
+extern ir_value_t *ir_var_read(ir_module_t *m, ir_func_t *f, ir_block_t *b, int var);
+extern void ir_block_seal(ir_module_t *m, ir_func_t *f, ir_block_t *b);
+extern void ir_phi_add(ir_module_t *m, ir_value_t *phi, ir_value_t *v);
+extern void ir_func_finish(ir_module_t *m, ir_func_t *f);
+extern int ir_func_merge_blocks(ir_func_t *f);
+extern int ir_func_remove_dead(ir_func_t *f);
+extern void ir_func_clone(ir_module_t *m, ir_func_t *f, ir_func_t *g, ir_value_t **args, ir_block_t **bmap, ir_value_t **vmap);
+extern void ir_func_number(ir_func_t *f);
+extern void ir_func_dominators(ir_func_t *f);
+extern int ir_components(int n, const int *start, const int *edge, int *comp, int *order);
+extern int ir_module_remove_functions(ir_module_t *m, ir_func_t **funcs, int n, const char *referred, vector_t *keep);
+
+/* lower.c */
+extern ir_module_t *ir_lower(type_table_t *types, vector_t *funcs, node_t *root);
+
+/* dump.c */
+extern const char *ir_op_name(enum ir_op op);
+extern void ir_dump(ir_module_t *m);
+
+/* sccp.c */
+typedef struct ir_sccp_stats_ {
+    int folded;                     // values replaced by constants.
+    int pruned;                     // branches turned to jumps.
+    int blocks;                     // blocks removed.
+    int removed;                    // values removed with blocks and phis.
+} ir_sccp_stats_t;
+
+extern int ir_sccp(ir_module_t *m, ir_sccp_stats_t *stats);
+extern void ir_sccp_function(ir_module_t *m, ir_func_t *f, ir_sccp_stats_t *stats);
+
+/* inline.c */
+#define IR_INLINE_THRESHOLD (12)
+
+typedef struct ir_inline_stats_ {
+    int inlined;                    // calls replaced by a copy of the callee.
+    int removed;                    // functions referred no more.
+} ir_inline_stats_t;
+
+extern int ir_inline(ir_module_t *m, int threshold, vector_t *keep, ir_inline_stats_t *stats);
+
+/* tail.c */
+typedef struct ir_tail_stats_ {
+    int self;                       // tail calls of a function itself turned into jumps.
+    int mutual;                     // tail calls between functions turned into jumps.
+    int groups;                     // functions merged into a dispatch function.
+} ir_tail_stats_t;
+
+extern int ir_tail_calls(ir_module_t *m, ir_tail_stats_t *stats);
+
+/* eval.c */
+#define IR_EVAL_STEPS (1000000)
+#define IR_EVAL_DEPTH (1000)
+
+typedef struct ir_eval_stats_ {
+    int evaluated;                  // calls replaced by a constant.
+    int given_up;                   // calls with constant arguments not evaluated.
+} ir_eval_stats_t;
+
+extern int ir_eval_calls(ir_module_t *m, int steps, int depth, ir_eval_stats_t *stats);
+
+/* spec.c */
+#define IR_SPEC_BUDGET (4)
+
+typedef struct ir_spec_stats_ {
+    int calls;                      // calls turned to call a clone.
+    int clones;                     // functions specialized for constant arguments.
+    int folded;                     // values folded in clones.
+    int discarded;                  // clones which neither pruned a branch nor got smaller.
+    int removed;                    // functions referred no more.
+} ir_spec_stats_t;
+
+extern int ir_specialize(ir_module_t *m, int budget, vector_t *keep, ir_spec_stats_t *stats);
+
+/* memo.c */
+extern int ir_memoize(ir_module_t *m);
+
+/* loop.c */
+typedef struct ir_loop_stats_ {
+    int hoisted;                    // invariant values moved to preheaders.
+    int unswitched;                 // loops copied for an invariant condition.
+    int unrolled;                   // loops fully unrolled.
+} ir_loop_stats_t;
+
+extern int ir_loops(ir_module_t *m, ir_loop_stats_t *stats);
+
+/* verify.c */
+extern int ir_verify(ir_module_t *m);
+
+#endif /* KISS_IR_H */
@@ -0,0 +1,656 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Loop optimizations on natural loops. A back edge goes to a block which dominates its source,
+    and the loop of a header is the header with the blocks reaching a back edge without it.
+    Every loop gets a preheader, which is the single block entering the header from outside.
+
+    Invariant code motion moves a value to the preheader if it neither has an effect nor traps,
+    and its operands are defined out of the loop. A loop branching on an invariant condition is
+    unswitched, the loop is copied and the preheader branches to the original for then and to
+    the copy for else, where the branch is a jump. A small innermost loop, whose trip count is
+    known from an induction variable of constants, is fully unrolled by peeling an iteration
+    as many times as the header is visited, then SCCP folds the exit tests and removes the loop.
+    Values of a loop used out of it are joined with those of the copy by the SSA construction.
+*/
+#define IR_LOOP_UNSWITCH_SIZE (64)      // instructions of a loop to be unswitched.
+#define IR_LOOP_UNSWITCH_MAX (4)        // loops unswitched in a function.
+#define IR_LOOP_UNROLL_TRIPS (16)
+#define IR_LOOP_UNROLL_SIZE (256)       // instructions of a fully unrolled loop.
+#define IR_LOOP_UNROLL_MAX (8)          // loops unrolled in a function.
+
+typedef struct loop_ {
+    ir_block_t *header;
+    ir_block_t *latch;              // the source of the back edge, NULL if there are more.
+    ir_block_t **blocks;            // in the order of the function.
+    int nblocks;
+    char *in;                       // by a block id.
+    int inner;                      // no other loop is in this one.
+} loop_t;
+
+typedef struct loop_use_ {
+    ir_value_t *user;
+    int index;                      // of an operand.
+    ir_block_t *from;               // where the operand is read.
+} loop_use_t;
+
+typedef struct loop_context_ {
+    ir_module_t *m;
+    ir_func_t *func;
+    loop_t *loops;                  // innermost first.
+    int nloops;
+    int nblocks;                    // ids of blocks when loops were found.
+    ir_loop_stats_t *stats;
+} loop_context_t;
+
+static int dominates(ir_block_t *a, ir_block_t *b)
+{
+    for ( ; ; ) {
+        if (a == b) {
+            return 1;
+        }
+        if (!b->idom || b->idom == b) {
+            return 0;
+        }
+        b = b->idom;
+    }
+}
+
+/* A block made after loops were found is out of all of them. */
+static int in_loop(loop_context_t *L, loop_t *loop, ir_block_t *b)
+{
+    return b->id < L->nblocks && loop->in[b->id];
+}
+
+static void free_loops(loop_context_t *L)
+{
+    for (int i = 0; i < L->nloops; ++i) {
+        free(L->loops[i].blocks);
+        free(L->loops[i].in);
+    }
+    free(L->loops);
+    L->loops = NULL;
+    L->nloops = 0;
+}
+
+static int compare_loops(const void *a, const void *b)
+{
+    return ((const loop_t *)a)->nblocks - ((const loop_t *)b)->nblocks;
+}
+
+/* Loops of the same header are one loop, and a loop in another one is smaller, so it comes first. */
+static void find_loops(loop_context_t *L)
+{
+    ir_func_t *f = L->func;
+    free_loops(L);
+    ir_func_number(f);
+    ir_func_dominators(f);
+    int n = L->nblocks = f->nblocks;
+    int *index = (int *)malloc((n + 1) * sizeof(int));      // of a loop by a header.
+    ir_block_t **stack = (ir_block_t **)malloc((n + 1) * sizeof(ir_block_t *));
+    for (int i = 0; i < n; ++i) {
+        index[i] = -1;
+    }
+
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        ir_block_t *succ[2];
+        int ns = (b->rpo >= 0) ? ir_successors(b, succ) : 0;
+        for (int i = 0; i < ns; ++i) {
+            ir_block_t *h = succ[i];
+            if (!dominates(h, b)) {
+                continue;
+            }
+            loop_t *loop;
+            if (index[h->id] < 0) {
+                index[h->id] = L->nloops;
+                L->loops = (loop_t *)realloc(L->loops, (L->nloops + 1) * sizeof(loop_t));
+                loop = &(L->loops[L->nloops++]);
+                memset(loop, 0, sizeof(loop_t));
+                loop->header = h;
+                loop->latch = b;
+                loop->in = (char *)calloc(n + 1, 1);
+                loop->in[h->id] = 1;
+            } else {
+                loop = &(L->loops[index[h->id]]);
+                loop->latch = (loop->latch == b) ? b : NULL;
+            }
+            int sp = 0;
+            if (!loop->in[b->id]) {
+                loop->in[b->id] = 1;
+                stack[sp++] = b;
+            }
+            while (sp > 0) {
+                ir_block_t *x = stack[--sp];
+                for (int k = 0; k < x->npred; ++k) {
+                    ir_block_t *p = x->pred[k];
+                    if (p->rpo >= 0 && !loop->in[p->id]) {
+                        loop->in[p->id] = 1;
+                        stack[sp++] = p;
+                    }
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < L->nloops; ++i) {
+        loop_t *loop = &(L->loops[i]);
+        loop->blocks = (ir_block_t **)malloc((n + 1) * sizeof(ir_block_t *));
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            if (loop->in[b->id]) {
+                loop->blocks[loop->nblocks++] = b;
+            }
+        }
+    }
+    if (L->nloops > 1) {
+        qsort(L->loops, L->nloops, sizeof(loop_t), compare_loops);
+    }
+    for (int i = 0; i < L->nloops; ++i) {
+        loop_t *loop = &(L->loops[i]);
+        loop->inner = 1;
+        for (int k = 0; k < i && loop->inner; ++k) {
+            loop->inner = !loop->in[L->loops[k].header->id];
+        }
+    }
+    free(stack);
+    free(index);
+}
+
+static int loop_size(loop_t *loop)
+{
+    int size = 0;
+    for (int i = 0; i < loop->nblocks; ++i) {
+        for (ir_value_t *v = loop->blocks[i]->head; v; v = v->next) {
+            size += v->op != IR_CONST && v->op != IR_FUNC;
+        }
+    }
+    return size;
+}
+
+/* A branch to the same block on both ways is not copied correctly, and it is not handled. */
+static int has_double_edge(loop_t *loop)
+{
+    for (int i = 0; i < loop->nblocks; ++i) {
+        ir_value_t *t = ir_terminator(loop->blocks[i]);
+        if (t && t->op == IR_BR && t->u.target[0] == t->u.target[1]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* The single predecessor out of the loop which jumps to the header, or NULL. */
+static ir_block_t *preheader(loop_context_t *L, loop_t *loop)
+{
+    ir_block_t *h = loop->header, *p = NULL;
+    for (int i = 0; i < h->npred; ++i) {
+        if (in_loop(L, loop, h->pred[i])) {
+            continue;
+        }
+        if (p) {
+            return NULL;
+        }
+        p = h->pred[i];
+    }
+    ir_value_t *t = p ? ir_terminator(p) : NULL;
+    return (t && t->op == IR_JMP) ? p : NULL;
+}
+
+/*
+    Edges from out of the loop are moved to a new block, which jumps to the header.
+    Operands of phis for them are joined by phis in the new block, and it is the last predecessor.
+    Returns 0 if the loop is not entered from outside, which is a loop of the entry.
+*/
+static int make_preheader(loop_context_t *L, loop_t *loop)
+{
+    ir_module_t *m = L->m;
+    ir_block_t *h = loop->header;
+    int nout = 0;
+    for (int i = 0; i < h->npred; ++i) {
+        nout += !in_loop(L, loop, h->pred[i]);
+    }
+    if (nout == 0) {
+        return 0;
+    }
+
+    ir_block_t *p = ir_block_new(m, L->func);
+    p->sealed = 1;
+    for (ir_value_t *phi = h->head; phi && phi->op == IR_PHI; phi = phi->next) {
+        ir_value_t *v = NULL;
+        if (nout > 1) {
+            v = ir_insert_head(p, ir_value_new(m, IR_PHI, phi->type, 0));
+        }
+        int n = 0;
+        for (int i = 0; i < h->npred; ++i) {
+            if (in_loop(L, loop, h->pred[i])) {
+                phi->args[n++] = phi->args[i];
+            } else if (nout > 1) {
+                ir_phi_add(m, v, phi->args[i]);
+            } else {
+                v = phi->args[i];
+            }
+        }
+        phi->args[n++] = v;
+        phi->argc = n;
+    }
+
+    int n = 0;
+    for (int i = 0; i < h->npred; ++i) {
+        ir_block_t *q = h->pred[i];
+        if (in_loop(L, loop, q)) {
+            h->pred[n++] = q;
+            continue;
+        }
+        ir_value_t *t = ir_terminator(q);
+        for (int k = 0; k < (t->op == IR_BR ? 2 : 1); ++k) {
+            if (t->u.target[k] == h) {
+                t->u.target[k] = p;
+            }
+        }
+        ir_block_add_pred(m, p, q);
+    }
+    h->pred[n++] = p;
+    h->npred = n;
+    ir_value_t *j = ir_emit(m, p, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+    j->u.target[0] = h;
+    return 1;
+}
+
+/* Finds loops until every loop entered from outside has a preheader. */
+static void make_preheaders(loop_context_t *L)
+{
+    for (int made = 1; made; ) {
+        made = 0;
+        find_loops(L);
+        for (int i = 0; i < L->nloops && !made; ++i) {
+            if (!preheader(L, &(L->loops[i]))) {
+                made = make_preheader(L, &(L->loops[i]));
+            }
+        }
+    }
+}
+
+/* F2I is not moved either, since it is undefined out of the range, which a condition may check. */
+static int can_hoist(ir_value_t *v)
+{
+    if (v->op == IR_PHI || v->op == IR_F2I) {
+        return 0;
+    }
+    if (IR_IS_PURE(v->op)) {
+        return 1;
+    }
+    if ((v->op == IR_IDIV || v->op == IR_IMOD) && v->args[1]->op == IR_CONST) {
+        return v->args[1]->u.iv != 0 && v->args[1]->u.iv != -1;
+    }
+    return 0;
+}
+
+/*
+    Values are moved before the terminator of the preheader in the order they are found,
+    which is after their operands. Constants are moved too, but not counted.
+*/
+static int hoist_invariants(loop_context_t *L, loop_t *loop, ir_block_t *p)
+{
+    ir_value_t *pos = ir_terminator(p);
+    int hoisted = 0;
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = 0; i < loop->nblocks; ++i) {
+            ir_value_t *next;
+            for (ir_value_t *v = loop->blocks[i]->head; v; v = next) {
+                next = v->next;
+                if (!can_hoist(v)) {
+                    continue;
+                }
+                int k = 0;
+                while (k < v->argc && !in_loop(L, loop, v->args[k]->block)) {
+                    ++k;
+                }
+                if (k < v->argc) {
+                    continue;
+                }
+                ir_remove(v);
+                ir_insert_before(pos, v);
+                hoisted += v->op != IR_CONST && v->op != IR_FUNC;
+                changed = 1;
+            }
+        }
+    }
+    return hoisted;
+}
+
+static ir_value_t *mapped(ir_value_t **vmap, ir_value_t *v)
+{
+    return (v->block->mark == 1) ? vmap[v->id] : v;
+}
+
+/*
+    A copy of the loop, whose edges out of the loop are added to their targets with operands
+    of phis copied. Predecessors of the copy of the header out of the loop are the same,
+    and the caller makes them jump to it. Marks are 1 in the loop and 2 in the copy.
+*/
+static void copy_loop(loop_context_t *L, loop_t *loop, ir_block_t **bmap, ir_value_t **vmap)
+{
+    ir_module_t *m = L->m;
+    for (ir_block_t *b = L->func->entry; b; b = b->next) {
+        b->mark = 0;
+    }
+    for (int i = 0; i < loop->nblocks; ++i) {
+        loop->blocks[i]->mark = 1;
+    }
+    for (int i = 0; i < loop->nblocks; ++i) {
+        ir_block_t *c = ir_block_new(m, L->func);
+        c->sealed = 1;
+        c->mark = 2;
+        bmap[loop->blocks[i]->id] = c;
+    }
+    for (int i = 0; i < loop->nblocks; ++i) {
+        ir_block_t *b = loop->blocks[i];
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            ir_value_t *c = ir_value_new(m, v->op, v->type, v->argc);
+            c->u = v->u;
+            vmap[v->id] = ir_append(bmap[b->id], c);
+        }
+    }
+    for (int i = 0; i < loop->nblocks; ++i) {
+        ir_block_t *b = loop->blocks[i];
+        ir_block_t *c = bmap[b->id];
+        for (int k = 0; k < b->npred; ++k) {
+            ir_block_t *q = b->pred[k];
+            ir_block_add_pred(m, c, (q->mark == 1) ? bmap[q->id] : q);
+        }
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            ir_value_t *cv = vmap[v->id];
+            for (int k = 0; k < v->argc; ++k) {
+                cv->args[k] = mapped(vmap, v->args[k]);
+            }
+            if (v->op != IR_JMP && v->op != IR_BR) {
+                continue;
+            }
+            for (int s = 0; s < (v->op == IR_BR ? 2 : 1); ++s) {
+                ir_block_t *x = v->u.target[s];
+                if (x->mark == 1) {
+                    cv->u.target[s] = bmap[x->id];
+                    continue;
+                }
+                int k = 0;
+                while (x->pred[k] != b) {
+                    ++k;
+                }
+                ir_block_add_pred(m, x, c);
+                for (ir_value_t *phi = x->head; phi && phi->op == IR_PHI; phi = phi->next) {
+                    ir_phi_add(m, phi, mapped(vmap, phi->args[k]));
+                }
+            }
+        }
+    }
+}
+
+/*
+    Uses of values of the loop out of the loop and the copy are read as variables, which
+    are written by the value and its copy, so that phis join them where both reach.
+    Uses are found before any read, since a read may place phis.
+*/
+static void repair_uses(loop_context_t *L, ir_value_t **vmap)
+{
+    ir_module_t *m = L->m;
+    ir_func_t *f = L->func;
+    int nvalues = f->nvalues;
+    loop_use_t *uses = NULL;
+    int nuses = 0, usecap = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        b->sealed = 1;
+        if (b->mark != 0) {
+            continue;
+        }
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            for (int k = 0; k < v->argc; ++k) {
+                if (v->args[k]->block->mark != 1) {
+                    continue;
+                }
+                ir_block_t *from = (v->op == IR_PHI) ? b->pred[k] : b;
+                if (from->mark != 0) {
+                    continue;               // an edge from the loop or the copy.
+                }
+                if (nuses == usecap) {
+                    usecap = usecap ? usecap * 2 : 16;
+                    uses = (loop_use_t *)realloc(uses, usecap * sizeof(loop_use_t));
+                }
+                uses[nuses++] = (loop_use_t){ .user = v, .index = k, .from = from };
+            }
+        }
+    }
+
+    int *var = (int *)malloc((nvalues + 1) * sizeof(int));
+    for (int i = 0; i < nvalues; ++i) {
+        var[i] = -1;
+    }
+    for (int i = 0; i < nuses; ++i) {
+        ir_value_t *v = uses[i].user->args[uses[i].index];
+        if (var[v->id] < 0) {
+            var[v->id] = ir_var_new(f, v->type);
+            ir_var_write(m, v->block, var[v->id], v);
+            ir_var_write(m, vmap[v->id]->block, var[v->id], vmap[v->id]);
+        }
+        uses[i].user->args[uses[i].index] = ir_var_read(m, f, uses[i].from, var[v->id]);
+    }
+    free(var);
+    free(uses);
+    ir_func_finish(m, f);
+}
+
+static void branch_to_jump(ir_value_t *br, int taken)
+{
+    ir_block_remove_pred(br->u.target[1 - taken], br->block);
+    br->op = IR_JMP;
+    br->argc = 0;
+    br->u.target[0] = br->u.target[taken];
+    br->u.target[1] = NULL;
+}
+
+/* A branch of the loop on a condition defined out of it, and both ways are in the loop. */
+static ir_value_t *invariant_branch(loop_context_t *L, loop_t *loop)
+{
+    for (int i = 0; i < loop->nblocks; ++i) {
+        ir_value_t *t = ir_terminator(loop->blocks[i]);
+        if (t && t->op == IR_BR && t->args[0]->op != IR_CONST && !in_loop(L, loop, t->args[0]->block) &&
+                in_loop(L, loop, t->u.target[0]) && in_loop(L, loop, t->u.target[1])) {
+            return t;
+        }
+    }
+    return NULL;
+}
+
+static void unswitch(loop_context_t *L, loop_t *loop, ir_block_t *p, ir_value_t *br)
+{
+    ir_func_t *f = L->func;
+    ir_block_t **bmap = (ir_block_t **)malloc((L->nblocks + 1) * sizeof(ir_block_t *));
+    ir_value_t **vmap = (ir_value_t **)malloc((f->nvalues + 1) * sizeof(ir_value_t *));
+    copy_loop(L, loop, bmap, vmap);
+
+    ir_value_t *j = ir_terminator(p);
+    ir_remove(j);
+    ir_value_t *sw = ir_emit(L->m, p, IR_BR, VALTYPE_UNKNOWN, br->args[0], NULL);
+    sw->u.target[0] = loop->header;
+    sw->u.target[1] = bmap[loop->header->id];
+    branch_to_jump(vmap[br->id], 1);
+    branch_to_jump(br, 0);
+
+    repair_uses(L, vmap);
+    ir_func_merge_blocks(f);
+    free(vmap);
+    free(bmap);
+}
+
+/*
+    The number of visits to the header of a loop counted by an induction variable, which starts
+    from a constant and steps by a constant, and is compared with a constant at the single exit
+    of the header or the latch. Returns 0 if it is not known or over IR_LOOP_UNROLL_TRIPS.
+*/
+static int trip_count(loop_context_t *L, loop_t *loop)
+{
+    ir_block_t *h = loop->header, *t = loop->latch, *x = NULL;
+    if (!t || h->npred != 2) {
+        return 0;
+    }
+    for (int i = 0; i < loop->nblocks; ++i) {
+        ir_block_t *succ[2];
+        int ns = ir_successors(loop->blocks[i], succ);
+        for (int k = 0; k < ns; ++k) {
+            if (!in_loop(L, loop, succ[k])) {
+                if (x && x != loop->blocks[i]) {
+                    return 0;
+                }
+                x = loop->blocks[i];
+            }
+        }
+    }
+    if (!x || (x != h && x != t)) {
+        return 0;
+    }
+    ir_value_t *br = ir_terminator(x);
+    if (br->op != IR_BR || br->args[0]->op < IR_IEQ || br->args[0]->op > IR_IGE) {
+        return 0;
+    }
+    ir_value_t *cmp = br->args[0];
+    int stay = in_loop(L, loop, br->u.target[0]);       // the loop goes on if the condition is true.
+    int side = (cmp->args[1]->op == IR_CONST) ? 0 : 1;  // of the induction variable.
+    ir_value_t *iv = cmp->args[side], *limit = cmp->args[1 - side];
+    if (limit->op != IR_CONST) {
+        return 0;
+    }
+
+    ir_value_t *phi = (iv->op == IR_IADD || iv->op == IR_ISUB) ? iv->args[0] : iv;
+    if (phi->op != IR_PHI || phi->block != h) {
+        return 0;
+    }
+    int entry = (h->pred[0] == t) ? 1 : 0;
+    ir_value_t *init = phi->args[entry], *next = phi->args[1 - entry];
+    if (init->op != IR_CONST || (next->op != IR_IADD && next->op != IR_ISUB) ||
+            next->args[0] != phi || next->args[1]->op != IR_CONST || (iv != phi && iv != next)) {
+        return 0;
+    }
+
+    ir_scalar_t i = { .type = VALTYPE_INT, .u.iv = init->u.iv };
+    ir_scalar_t step = { .type = VALTYPE_INT, .u.iv = next->args[1]->u.iv };
+    ir_scalar_t c = { .type = VALTYPE_INT, .u.iv = limit->u.iv };
+    for (int visits = 1; visits <= IR_LOOP_UNROLL_TRIPS; ++visits) {
+        ir_scalar_t n, r;
+        ir_fold(next->op, &i, &step, &n);
+        ir_scalar_t *a = (iv == phi) ? &i : &n;
+        ir_fold(cmp->op, side == 0 ? a : &c, side == 0 ? &c : a, &r);
+        if ((r.u.iv != 0) != stay) {
+            return visits;
+        }
+        i = n;
+    }
+    return 0;
+}
+
+/*
+    The first iteration is peeled off, the preheader enters the copy, and the back edge
+    of the copy enters the loop with the values of the next iteration.
+*/
+static void peel(loop_context_t *L, loop_t *loop, ir_block_t *p)
+{
+    ir_func_t *f = L->func;
+    ir_block_t *h = loop->header, *t = loop->latch;
+    ir_block_t **bmap = (ir_block_t **)malloc((L->nblocks + 1) * sizeof(ir_block_t *));
+    ir_value_t **vmap = (ir_value_t **)malloc((f->nvalues + 1) * sizeof(ir_value_t *));
+    int entry = (h->pred[0] == p) ? 0 : 1;
+    copy_loop(L, loop, bmap, vmap);
+
+    ir_block_t *ch = bmap[h->id], *ct = bmap[t->id];
+    for (ir_value_t *phi = h->head; phi && phi->op == IR_PHI; phi = phi->next) {
+        phi->args[entry] = mapped(vmap, phi->args[1 - entry]);
+    }
+    h->pred[entry] = ct;
+    ir_terminator(p)->u.target[0] = ch;
+    ir_value_t *j = ir_terminator(ct);
+    for (int k = 0; k < (j->op == IR_BR ? 2 : 1); ++k) {
+        if (j->u.target[k] == ch) {
+            j->u.target[k] = h;
+        }
+    }
+    ir_block_remove_pred(ch, ct);
+
+    repair_uses(L, vmap);
+    free(vmap);
+    free(bmap);
+}
+
+/* Peels the loop of header h for trips times, the loop is found again after each. */
+static void unroll(loop_context_t *L, ir_block_t *h, int trips)
+{
+    for (int i = 0; i < trips; ++i) {
+        make_preheaders(L);
+        int k = 0;
+        while (k < L->nloops && L->loops[k].header != h) {
+            ++k;
+        }
+        ir_block_t *p = (k < L->nloops) ? preheader(L, &(L->loops[k])) : NULL;
+        if (!p) {
+            break;
+        }
+        peel(L, &(L->loops[k]), p);
+    }
+    ir_sccp_stats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    ir_sccp_function(L->m, L->func, &stats);
+}
+
+static void optimize_function(loop_context_t *L)
+{
+    int unswitched = 0, unrolled = 0;
+    for ( ; ; ) {
+        make_preheaders(L);
+        for (int i = 0; i < L->nloops; ++i) {
+            ir_block_t *p = preheader(L, &(L->loops[i]));
+            if (p) {
+                L->stats->hoisted += hoist_invariants(L, &(L->loops[i]), p);
+            }
+        }
+
+        int done = 0;
+        for (int i = 0; i < L->nloops && !done; ++i) {
+            loop_t *loop = &(L->loops[i]);
+            ir_block_t *p = preheader(L, loop);
+            if (!p || has_double_edge(loop)) {
+                continue;
+            }
+            int size = loop_size(loop);
+            ir_value_t *br;
+            int trips;
+            if (unswitched < IR_LOOP_UNSWITCH_MAX && size <= IR_LOOP_UNSWITCH_SIZE &&
+                    (br = invariant_branch(L, loop))) {
+                unswitch(L, loop, p, br);
+                ++unswitched;
+                done = 1;
+            } else if (unrolled < IR_LOOP_UNROLL_MAX && loop->inner && (trips = trip_count(L, loop)) > 0 &&
+                    size * trips <= IR_LOOP_UNROLL_SIZE) {
+                unroll(L, loop->header, trips);
+                ++unrolled;
+                done = 1;
+            }
+        }
+        if (!done) {
+            break;
+        }
+    }
+    free_loops(L);
+    ir_func_number(L->func);
+    L->stats->unswitched += unswitched;
+    L->stats->unrolled += unrolled;
+}
+
+int ir_loops(ir_module_t *m, ir_loop_stats_t *stats)
+{
+    loop_context_t ctx = { .m = m, .stats = stats };
+    memset(stats, 0, sizeof(ir_loop_stats_t));
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ctx.func = f;
+        optimize_function(&ctx);
+    }
+    return stats->hoisted + stats->unswitched + stats->unrolled;
+}
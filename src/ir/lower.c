@@ -0,0 +1,672 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "ir.h"
+#include "../ast/walk.h"
+#include "../kiss.tab.h"
+
+/*
+    Lowering from the typed AST to the SSA IR.
+    A variable at the top level is a global variable accessed by load and store if a function
+    refers to it, and other variables are SSA values. A function can not refer to a local
+    variable of an enclosing function, because a function is emitted at the top level.
+*/
+enum ir_name_kind {
+    IR_NAME_NONE,
+    IR_NAME_LOCAL,
+    IR_NAME_GLOBAL,
+    IR_NAME_FUNC,
+    IR_NAME_OUTER,                  // a local variable of an enclosing function.
+};
+
+typedef struct ir_lower_context_ {
+    ir_module_t *m;
+    type_table_t *types;
+    ir_func_t *func;
+    ir_block_t *block;              // the block being lowered into.
+    symbol_table_t *global;         // the top level scope.
+    symbol_table_t *scope;
+    symbol_table_t *fscope;         // the scope of arguments of the function, NULL for the top level.
+    ir_global_t **globals;          // by a slot, NULL until a function refers to it.
+    int *gvars;                     // SSA variables of the top level code for globals not referred by functions.
+    ir_func_t **funcs;
+    int nglobals;
+    int nfuncs;
+    ir_value_t **stack;             // values of finished children of expressions.
+    int sp;
+    int spcap;
+    ast_walker_t walker;
+    int errors;
+} ir_lower_context_t;
+
+static void lower_error(ir_lower_context_t *L, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    printf("error: ");
+    vprintf(format, ap);
+    printf("\n");
+    va_end(ap);
+    ++L->errors;
+}
+
+static void push_value(ir_lower_context_t *L, ir_value_t *v)
+{
+    if (L->sp == L->spcap) {
+        L->spcap = L->spcap ? L->spcap * 2 : 64;
+        L->stack = (ir_value_t **)realloc(L->stack, L->spcap * sizeof(ir_value_t *));
+    }
+    L->stack[L->sp++] = v;
+}
+
+#define pop_value(L) ((L)->stack[--(L)->sp])
+
+static int is_builtin(ir_lower_context_t *L, node_t *node)
+{
+    if (node->ntype != EXPR_VAR) {
+        return 0;
+    }
+    type_t *t = type_get(L->types, node->type);
+    return t->vtype == VALTYPE_FUNC && t->argc == 1 && t->args[0] == VALTYPE_VA;
+}
+
+static symbol_t *lookup_name(ir_lower_context_t *L, string_t *name, enum ir_name_kind *kind)
+{
+    int local = 1;
+    for (symbol_table_t *s = L->scope; s; s = s->parent) {
+        if (s == L->global) {
+            local = 0;
+        }
+        symbol_t *sym = symbol_search_one(s, name);
+        if (sym) {
+            if (sym->func) {
+                *kind = IR_NAME_FUNC;
+                return sym;
+            }
+            if (s == L->global) {
+                *kind = IR_NAME_GLOBAL;
+                return sym;
+            }
+            if (!local) {
+                *kind = IR_NAME_OUTER;
+                return sym;
+            }
+            if (sym->slot > 0) {
+                *kind = IR_NAME_LOCAL;
+                return sym;
+            }
+            /* declared later in the scope, so an outer one is referred. */
+        }
+        if (s == L->fscope) {
+            local = 0;
+        }
+    }
+    *kind = IR_NAME_NONE;
+    return NULL;
+}
+
+static ir_value_t *convert_value(ir_lower_context_t *L, ir_value_t *v, int type)
+{
+    if (type == VALTYPE_DBL && v->type == VALTYPE_INT) {
+        return ir_emit(L->m, L->block, IR_I2F, VALTYPE_DBL, v, NULL);
+    }
+    if (type == VALTYPE_INT && v->type == VALTYPE_DBL) {
+        return ir_emit(L->m, L->block, IR_F2I, VALTYPE_INT, v, NULL);
+    }
+    return v;
+}
+
+/* Functions are lowered before the top level code, so a global is created on the first reference from them. */
+static ir_global_t *global_of(ir_lower_context_t *L, symbol_t *sym)
+{
+    int i = sym->slot - 1;
+    if (!L->globals[i] && L->func != L->m->main) {
+        L->globals[i] = ir_global_new(L->m, sym->name, sym->type);
+    }
+    return L->globals[i];
+}
+
+static ir_value_t *read_variable(ir_lower_context_t *L, node_t *node)
+{
+    enum ir_name_kind kind;
+    symbol_t *sym = lookup_name(L, node->n.e.var.name, &kind);
+    switch (kind) {
+    case IR_NAME_LOCAL:
+        return ir_var_read(L->m, L->func, L->block, sym->slot - 1);
+    case IR_NAME_GLOBAL: {
+        ir_global_t *g = global_of(L, sym);
+        if (!g) {
+            return ir_var_read(L->m, L->func, L->block, L->gvars[sym->slot - 1]);
+        }
+        ir_value_t *v = ir_emit(L->m, L->block, IR_LOAD, g->type, NULL, NULL);
+        v->u.global = g;
+        return v;
+    }
+    case IR_NAME_FUNC:
+        if (sym->slot > 0) {
+            ir_func_t *func = L->funcs[sym->slot - 1];
+            ir_value_t *v = ir_emit(L->m, L->block, IR_FUNC, func->type, NULL, NULL);
+            v->u.func = func;
+            return v;
+        }
+        lower_error(L, "function '%s' has no body", node->n.e.var.name->p);
+        break;
+    case IR_NAME_OUTER:
+        lower_error(L, "variable '%s' of an enclosing function can not be referred", node->n.e.var.name->p);
+        break;
+    default:
+        lower_error(L, "undefined name '%s'", node->n.e.var.name->p);
+        break;
+    }
+    return ir_const_int(L->m, L->block, 0);
+}
+
+static void write_variable(ir_lower_context_t *L, symbol_t *sym, enum ir_name_kind kind, ir_value_t *v)
+{
+    if (kind == IR_NAME_GLOBAL) {
+        ir_global_t *g = global_of(L, sym);
+        if (!g) {
+            ir_var_write(L->m, L->block, L->gvars[sym->slot - 1], v);
+            return;
+        }
+        ir_value_t *store = ir_emit(L->m, L->block, IR_STORE, VALTYPE_UNKNOWN, v, NULL);
+        store->u.global = g;
+    } else {
+        ir_var_write(L->m, L->block, sym->slot - 1, v);
+    }
+}
+
+static int arith_op(int op)
+{
+    switch (op) {
+    case ADDEQ: return '+';
+    case SUBEQ: return '-';
+    case MULEQ: return '*';
+    case DIVEQ: return '/';
+    case MODEQ: return '%';
+    }
+    return op;
+}
+
+#define IS_ASSIGN_OP(op) ((op) == '=' || (op) == ADDEQ || (op) == SUBEQ || (op) == MULEQ || (op) == DIVEQ || (op) == MODEQ)
+
+static ir_value_t *lower_arith(ir_lower_context_t *L, int op, ir_value_t *a, ir_value_t *b)
+{
+    int ta = a->type, tb = b->type;
+    if ((ta != VALTYPE_INT && ta != VALTYPE_DBL) || (tb != VALTYPE_INT && tb != VALTYPE_DBL)) {
+        lower_error(L, "invalid operands of a binary operator");
+        return ir_const_int(L->m, L->block, 0);
+    }
+
+    /* an int operand is converted to dbl if the other is dbl. */
+    int dbl = ta == VALTYPE_DBL || tb == VALTYPE_DBL;
+    if (dbl) {
+        a = convert_value(L, a, VALTYPE_DBL);
+        b = convert_value(L, b, VALTYPE_DBL);
+    }
+    int type = dbl ? VALTYPE_DBL : VALTYPE_INT;
+    enum ir_op iop;
+    switch (op) {
+    case '+':  iop = dbl ? IR_FADD : IR_IADD; break;
+    case '-':  iop = dbl ? IR_FSUB : IR_ISUB; break;
+    case '*':  iop = dbl ? IR_FMUL : IR_IMUL; break;
+    case '/':  iop = dbl ? IR_FDIV : IR_IDIV; break;
+    case '%':  iop = dbl ? IR_FMOD : IR_IMOD; break;
+    case EQEQ: iop = dbl ? IR_FEQ : IR_IEQ; type = VALTYPE_INT; break;
+    case NEQ:  iop = dbl ? IR_FNE : IR_INE; type = VALTYPE_INT; break;
+    case '<':  iop = dbl ? IR_FLT : IR_ILT; type = VALTYPE_INT; break;
+    case LEQ:  iop = dbl ? IR_FLE : IR_ILE; type = VALTYPE_INT; break;
+    case '>':  iop = dbl ? IR_FGT : IR_IGT; type = VALTYPE_INT; break;
+    case GEQ:  iop = dbl ? IR_FGE : IR_IGE; type = VALTYPE_INT; break;
+    default:
+        lower_error(L, "unknown operator %d", op);
+        return ir_const_int(L->m, L->block, 0);
+    }
+    return ir_emit(L->m, L->block, iop, type, a, b);
+}
+
+static ir_value_t *lower_assign(ir_lower_context_t *L, node_t *node, ir_value_t *rhs)
+{
+    node_t *lhs = node->n.e.binary.lhs;
+    enum ir_name_kind kind = IR_NAME_NONE;
+    symbol_t *sym = (lhs->ntype == EXPR_VAR) ? lookup_name(L, lhs->n.e.var.name, &kind) : NULL;
+    if (kind != IR_NAME_LOCAL && kind != IR_NAME_GLOBAL) {
+        lower_error(L, "invalid left hand side of an assignment");
+        return rhs;
+    }
+
+    int op = node->n.e.binary.op;
+    if (op != '=') {
+        rhs = lower_arith(L, arith_op(op), read_variable(L, lhs), rhs);
+    }
+    ir_value_t *v = convert_value(L, rhs, sym->type);
+    write_variable(L, sym, kind, v);
+    return v;
+}
+
+/* Values of a callee and arguments are on the stack from base. */
+static ir_value_t *lower_call(ir_lower_context_t *L, node_t *node, int base)
+{
+    int builtin = is_builtin(L, node->n.e.call.func);
+    int argc = L->sp - base - (builtin ? 0 : 1);
+    ir_value_t **args = L->stack + base + (builtin ? 0 : 1);
+    if (builtin) {
+        ir_value_t *v = ir_value_new(L->m, IR_CALLB, VALTYPE_INT, argc);
+        v->u.sv = node->n.e.call.func->n.e.var.name;
+        for (int i = 0; i < argc; ++i) {
+            v->args[i] = args[i];
+        }
+        return ir_append(L->block, v);
+    }
+
+    ir_value_t *callee = L->stack[base];
+    type_t *t = type_get(L->types, callee->type);
+    if (t->vtype != VALTYPE_FUNC || callee->type == VALTYPE_FUNC) {
+        lower_error(L, "call of a value which is not a function");
+        return ir_const_int(L->m, L->block, 0);
+    }
+    if (t->argc != argc) {
+        lower_error(L, "%d arguments are given to a function of %d arguments", argc, t->argc);
+        return ir_const_int(L->m, L->block, 0);
+    }
+
+    int rtype = t->rtype;
+    ir_value_t *v = ir_value_new(L->m, IR_CALL, rtype, argc + 1);
+    v->args[0] = callee;
+    for (int i = 0; i < argc; ++i) {
+        v->args[i + 1] = convert_value(L, args[i], type_get(L->types, callee->type)->args[i]);
+    }
+    return ir_append(L->block, v);
+}
+
+static ir_value_t *lower_expression(ir_lower_context_t *L, node_t *root)
+{
+    ast_walker_t *w = &(L->walker);
+    int base = w->count;
+    ast_walker_push(w, root, 0);
+
+    while (w->count > base) {
+        ast_frame_t *f = ast_walker_top(w);
+        node_t *node = f->node;
+
+        switch (node->ntype) {
+        case EXPR_INT:
+            push_value(L, ir_const_int(L->m, L->block, node->n.ivalue));
+            break;
+        case EXPR_DBL:
+            push_value(L, ir_const_dbl(L->m, L->block, node->n.dvalue));
+            break;
+        case EXPR_STR:
+            push_value(L, ir_const_str(L->m, L->block, node->n.svalue));
+            break;
+        case EXPR_VAR:
+            if (is_builtin(L, node)) {
+                lower_error(L, "builtin function '%s' is not a value", node->n.e.var.name->p);
+                push_value(L, ir_const_int(L->m, L->block, 0));
+                break;
+            }
+            push_value(L, read_variable(L, node));
+            break;
+        case EXPR_CALL: {
+            switch (f->state) {
+            case 0:
+                f->value = L->sp;
+                if (!is_builtin(L, node->n.e.call.func)) {
+                    WALK(1, node->n.e.call.func, 0);
+                }
+                /* fallthrough */
+            case 1:
+                f->saved = node->n.e.call.args;
+                /* fallthrough */
+            default:
+                if (f->saved) {
+                    node_t *arg = (node_t *)f->saved;
+                    f->saved = arg->next;
+                    WALK(2, arg, 0);
+                }
+                ir_value_t *v = lower_call(L, node, f->value);
+                L->sp = f->value;
+                push_value(L, v);
+            }
+            break;
+        }
+        case EXPR_BINARY: {
+            int op = node->n.e.binary.op;
+            if (IS_ASSIGN_OP(op)) {
+                if (f->state == 0) {
+                    WALK(1, node->n.e.binary.rhs, 0);
+                }
+                ir_value_t *rhs = pop_value(L);
+                push_value(L, lower_assign(L, node, rhs));
+                break;
+            }
+            switch (f->state) {
+            case 0:
+                WALK(1, node->n.e.binary.lhs, 0);
+            case 1:
+                WALK(2, node->n.e.binary.rhs, 0);
+            default: {
+                ir_value_t *b = pop_value(L);
+                ir_value_t *a = pop_value(L);
+                push_value(L, lower_arith(L, op, a, b));
+            }
+            }
+            break;
+        }
+        default:
+            lower_error(L, "unsupported expression");
+            push_value(L, ir_const_int(L->m, L->block, 0));
+            break;
+        }
+
+        ast_walker_pop(w);
+NEXT:;
+    }
+
+    return pop_value(L);
+}
+
+/* A condition is an int, which is true if not zero. */
+static ir_value_t *lower_condition(ir_lower_context_t *L, node_t *expr)
+{
+    ir_value_t *v = lower_expression(L, expr);
+    if (v->type == VALTYPE_DBL) {
+        return ir_emit(L->m, L->block, IR_FNE, VALTYPE_INT, v, ir_const_dbl(L->m, L->block, 0.0));
+    }
+    if (v->type != VALTYPE_INT) {
+        lower_error(L, "condition must be a number");
+    }
+    return v;
+}
+
+static void declare_variable(ir_lower_context_t *L, node_t *decl, ir_value_t *v)
+{
+    symbol_t *sym = symbol_search_one(L->scope, decl->n.e.decl.name);
+    if (!sym) {
+        lower_error(L, "variable '%s' is not typed", decl->n.e.decl.name->p);
+        return;
+    }
+    if (L->scope == L->global) {
+        if (v) {
+            write_variable(L, sym, IR_NAME_GLOBAL, convert_value(L, v, sym->type));
+        }
+        return;
+    }
+    if (sym->slot == 0) {
+        sym->slot = ir_var_new(L->func, sym->type) + 1;
+    }
+    if (!v) {
+        v = (sym->type == VALTYPE_DBL) ? ir_const_dbl(L->m, L->block, 0.0) : ir_const_int(L->m, L->block, 0);
+    }
+    write_variable(L, sym, IR_NAME_LOCAL, convert_value(L, v, sym->type));
+}
+
+static void lower_declarations(ir_lower_context_t *L, node_t *decl)
+{
+    for ( ; decl; decl = decl->next) {
+        node_t *init = decl->n.e.decl.initializer;
+        declare_variable(L, decl, init ? lower_expression(L, init) : NULL);
+    }
+}
+
+static void lower_expression_or_declarations(ir_lower_context_t *L, node_t *expr)
+{
+    if (expr->ntype == EXPR_DECL) {
+        lower_declarations(L, expr);
+    } else {
+        lower_expression(L, expr);
+    }
+}
+
+static void jump_to(ir_lower_context_t *L, ir_block_t *target)
+{
+    ir_value_t *j = ir_emit(L->m, L->block, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+    j->u.target[0] = target;
+    ir_block_add_pred(L->m, target, L->block);
+}
+
+static void branch_to(ir_lower_context_t *L, ir_value_t *cond, ir_block_t *then_block, ir_block_t *else_block)
+{
+    ir_value_t *br = ir_emit(L->m, L->block, IR_BR, VALTYPE_UNKNOWN, cond, NULL);
+    br->u.target[0] = then_block;
+    br->u.target[1] = else_block;
+    ir_block_add_pred(L->m, then_block, L->block);
+    ir_block_add_pred(L->m, else_block, L->block);
+}
+
+static void lower_statement(ir_lower_context_t *L, node_t *node);
+
+static void lower_branch(ir_lower_context_t *L, node_t *node)
+{
+    ir_module_t *m = L->m;
+    ir_value_t *cond = lower_condition(L, node->n.s.branch.expr);
+    ir_block_t *then_block = ir_block_new(m, L->func);
+    ir_block_t *else_block = node->n.s.branch.else_cloause ? ir_block_new(m, L->func) : NULL;
+    ir_block_t *join = ir_block_new(m, L->func);
+    branch_to(L, cond, then_block, else_block ? else_block : join);
+
+    ir_block_seal(m, L->func, then_block);
+    L->block = then_block;
+    lower_statement(L, node->n.s.branch.then_cloause);
+    jump_to(L, join);
+    if (else_block) {
+        ir_block_seal(m, L->func, else_block);
+        L->block = else_block;
+        lower_statement(L, node->n.s.branch.else_cloause);
+        jump_to(L, join);
+    }
+    ir_block_seal(m, L->func, join);
+    L->block = join;
+}
+
+static void lower_preloop(ir_lower_context_t *L, node_t *node)
+{
+    ir_module_t *m = L->m;
+    if (node->n.s.loop.e1) {
+        lower_expression_or_declarations(L, node->n.s.loop.e1);
+    }
+    ir_block_t *header = ir_block_new(m, L->func);
+    ir_block_t *body = ir_block_new(m, L->func);
+    ir_block_t *exit = ir_block_new(m, L->func);
+    jump_to(L, header);
+
+    /* the header is sealed after the back edge is added. */
+    L->block = header;
+    if (node->n.s.loop.e2) {
+        branch_to(L, lower_condition(L, node->n.s.loop.e2), body, exit);
+    } else {
+        jump_to(L, body);
+    }
+    ir_block_seal(m, L->func, body);
+    L->block = body;
+    lower_statement(L, node->n.s.loop.then_cloause);
+    if (node->n.s.loop.e3) {
+        lower_expression(L, node->n.s.loop.e3);
+    }
+    jump_to(L, header);
+    ir_block_seal(m, L->func, header);
+    ir_block_seal(m, L->func, exit);
+    L->block = exit;
+}
+
+static void lower_pstloop(ir_lower_context_t *L, node_t *node)
+{
+    ir_module_t *m = L->m;
+    ir_block_t *body = ir_block_new(m, L->func);
+    ir_block_t *exit = ir_block_new(m, L->func);
+    jump_to(L, body);
+
+    L->block = body;
+    lower_statement(L, node->n.s.loop.then_cloause);
+    branch_to(L, lower_condition(L, node->n.s.loop.e2), body, exit);
+    ir_block_seal(m, L->func, body);
+    ir_block_seal(m, L->func, exit);
+    L->block = exit;
+}
+
+static void lower_return(ir_lower_context_t *L, node_t *node)
+{
+    ir_value_t *v = node->n.s.ret.expr ? lower_expression(L, node->n.s.ret.expr) : NULL;
+    if (v && L->func != L->m->main) {
+        v = convert_value(L, v, L->func->rtype);
+    }
+    ir_emit(L->m, L->block, IR_RET, VALTYPE_UNKNOWN, v, NULL);
+
+    /* code after return is not reachable, and it is removed by ir_func_finish(). */
+    L->block = ir_block_new(L->m, L->func);
+    L->block->sealed = 1;
+}
+
+/* Statements nest only as deep as the parser allows, so they are lowered recursively. */
+static void lower_statement(ir_lower_context_t *L, node_t *node)
+{
+    for ( ; node; node = node->next) {
+        switch (node->ntype) {
+        case STMT_EXPR:
+            lower_expression_or_declarations(L, node->n.s.expr);
+            break;
+        case STMT_BLOCK: {
+            symbol_table_t *scope = L->scope;
+            if (node->n.s.block.symtbl) {
+                L->scope = node->n.s.block.symtbl;
+            }
+            lower_statement(L, node->n.s.block.stmt);
+            L->scope = scope;
+            break;
+        }
+        case STMT_BRANCH:
+            lower_branch(L, node);
+            break;
+        case STMT_PRELOOP:
+            lower_preloop(L, node);
+            break;
+        case STMT_PSTLOOP:
+            lower_pstloop(L, node);
+            break;
+        case STMT_RET:
+            lower_return(L, node);
+            break;
+        case STMT_FUNC:
+            /* lowered by itself. */
+            break;
+        default:
+            lower_error(L, "unsupported statement");
+            break;
+        }
+    }
+}
+
+/* Falling off the end returns zero, or nothing from the top level code. */
+static void lower_body(ir_lower_context_t *L, ir_func_t *f, node_t *block)
+{
+    L->func = f;
+    L->block = f->entry;
+    lower_statement(L, block);
+    ir_value_t *v = NULL;
+    if (f != L->m->main) {
+        v = (f->rtype == VALTYPE_DBL) ? ir_const_dbl(L->m, L->block, 0.0) : ir_const_int(L->m, L->block, 0);
+    }
+    ir_emit(L->m, L->block, IR_RET, VALTYPE_UNKNOWN, v, NULL);
+    ir_func_finish(L->m, f);
+}
+
+static void lower_function(ir_lower_context_t *L, ir_func_t *f)
+{
+    node_t *node = f->node;
+    L->scope = L->fscope = node->n.s.func.symtbl;
+    L->func = f;
+    L->block = f->entry;
+    int i = 0;
+    for (node_t *arg = node->n.s.func.args; arg; arg = arg->next, ++i) {
+        ir_value_t *v = ir_emit(L->m, f->entry, IR_ARG, arg->type, NULL, NULL);
+        v->u.iv = i;
+        declare_variable(L, arg, v);
+    }
+    lower_body(L, f, node->n.s.func.block);
+}
+
+/*
+    Globals and functions are created first, so that any function can refer to them.
+    A function without a body, which is not reachable in the lazy mode, is not lowered.
+*/
+ir_module_t *ir_lower(type_table_t *types, vector_t *funcs, node_t *root)
+{
+    ir_lower_context_t ctx = { .m = ir_module_new(types), .types = types };
+    ir_lower_context_t *L = &ctx;
+    L->global = root->n.s.block.symtbl;
+
+    /* symbols are listed from the latest one, and globals are kept in the order of declarations. */
+    for (symbol_t *sym = L->global ? L->global->symbol : NULL; sym; sym = sym->next) {
+        if (!sym->func) {
+            ++L->nglobals;
+        }
+    }
+    symbol_t **syms = (symbol_t **)calloc(L->nglobals + 1, sizeof(symbol_t *));
+    int n = L->nglobals;
+    for (symbol_t *sym = L->global ? L->global->symbol : NULL; sym; sym = sym->next) {
+        if (!sym->func) {
+            syms[--n] = sym;
+        }
+    }
+    L->globals = (ir_global_t **)calloc(L->nglobals + 1, sizeof(ir_global_t *));
+    L->gvars = (int *)calloc(L->nglobals + 1, sizeof(int));
+    for (int i = 0; i < L->nglobals; ++i) {
+        syms[i]->slot = i + 1;
+    }
+
+    L->funcs = (ir_func_t **)calloc(funcs->count + 1, sizeof(ir_func_t *));
+    for (int i = 0; i < funcs->count; ++i) {
+        node_t *node = (node_t *)vector_get(funcs, i);
+        symbol_t *sym = node->n.s.func.sym;
+        if (!node->n.s.func.block || sym->func != node) {
+            continue;
+        }
+        ir_func_t *f = ir_func_new(L->m, node->n.s.func.name, node->type);
+        f->node = node;
+        L->funcs[L->nfuncs++] = f;
+        sym->slot = L->nfuncs;
+    }
+    L->m->main = ir_func_new(L->m, NULL, 0);
+
+    for (int i = 0; i < L->nfuncs; ++i) {
+        lower_function(L, L->funcs[i]);
+    }
+
+    /*
+        The rest of globals are variables of the top level code, which starts with zeros as a global does.
+        Globals are kept in the order of declarations.
+    */
+    ir_func_t *top = L->m->main;
+    L->m->globals = L->m->lastglobal = NULL;
+    for (int i = 0; i < L->nglobals; ++i) {
+        ir_global_t *g = L->globals[i];
+        if (g) {
+            g->next = NULL;
+            if (L->m->lastglobal) {
+                L->m->lastglobal->next = g;
+            } else {
+                L->m->globals = g;
+            }
+            L->m->lastglobal = g;
+            continue;
+        }
+        int type = syms[i]->type;
+        L->gvars[i] = ir_var_new(top, type);
+        ir_value_t *zero = (type == VALTYPE_DBL) ? ir_const_dbl(L->m, top->entry, 0.0) : ir_const_int(L->m, top->entry, 0);
+        ir_var_write(L->m, top->entry, L->gvars[i], zero);
+    }
+    free(syms);
+    L->scope = L->global;
+    L->fscope = NULL;
+    lower_body(L, top, root->n.s.block.stmt);
+
+    free(L->gvars);
+    free(L->globals);
+    free(L->funcs);
+    free(L->stack);
+    ast_walker_free(&(L->walker));
+    if (L->errors > 0) {
+        ir_module_free(L->m);
+        return NULL;
+    }
+    return L->m;
+}
@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Memoization of pure recursive functions, whose results the backend caches.
+    A function is pure if it neither calls a builtin, which has an effect, nor touches a global,
+    nor calls a value, and all functions it calls are pure. This is the greatest fixed point,
+    so functions calling each other can be pure. A function is memoized if it takes and returns
+    only numbers, and its recursion has overlapping subproblems, see has_overlapping_calls().
+    A single int parameter is looked up in a direct table first, and others in a hash table.
+*/
+#define IS_NUMBER_TYPE(type) ((type) == VALTYPE_INT || (type) == VALTYPE_DBL)
+
+static int is_locally_pure(ir_func_t *f)
+{
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (v->op == IR_CALLB || v->op == IR_LOAD || v->op == IR_STORE ||
+                    (v->op == IR_CALL && v->args[0]->op != IR_FUNC)) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+    Calls into the component of the call graph which has the function. A call can repeat arguments
+    of another only if it makes two of them or more, and at most one tail call runs in a call.
+    A chain of single calls, such as an accumulator or functions calling each other in turn,
+    never hits a cache, so it is not memoized.
+*/
+static int has_overlapping_calls(ir_func_t *f, const int *comp)
+{
+    int calls = 0, tails = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (v->op == IR_CALL && v->args[0]->op == IR_FUNC && comp[v->args[0]->u.func->mark] == comp[f->mark]) {
+                ++calls;
+                tails += IR_IS_TAIL_CALL(v);
+            }
+        }
+    }
+    return calls > 1 && tails < calls;
+}
+
+static enum ir_memo memo_kind(ir_module_t *m, ir_func_t *f)
+{
+    type_t *t = type_get(m->types, f->type);
+    if (t->argc == 0 || !IS_NUMBER_TYPE(t->rtype)) {
+        return IR_MEMO_NONE;
+    }
+    for (int i = 0; i < t->argc; ++i) {
+        if (!IS_NUMBER_TYPE(t->args[i])) {
+            return IR_MEMO_NONE;
+        }
+    }
+    return (t->argc == 1 && t->args[0] == VALTYPE_INT) ? IR_MEMO_DIRECT : IR_MEMO_HASH;
+}
+
+int ir_memoize(ir_module_t *m)
+{
+    int n = 0;
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        f->mark = n++;
+    }
+    ir_func_t **funcs = (ir_func_t **)malloc((n + 1) * sizeof(ir_func_t *));
+    int *start = (int *)calloc(n + 1, sizeof(int));     // callees of funcs[i] are callee[start[i] .. start[i + 1]).
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        funcs[f->mark] = f;
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (v->op == IR_CALL && v->args[0]->op == IR_FUNC) {
+                    ++start[f->mark + 1];
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        start[i + 1] += start[i];
+    }
+    int *callee = (int *)calloc(start[n] + 1, sizeof(int));
+    char *pure = (char *)calloc(n + 1, 1);
+    for (int i = 0, k = 0; i < n; ++i) {
+        for (ir_block_t *b = funcs[i]->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (v->op == IR_CALL && v->args[0]->op == IR_FUNC) {
+                    callee[k++] = v->args[0]->u.func->mark;
+                }
+            }
+        }
+        pure[i] = funcs[i] != m->main && is_locally_pure(funcs[i]);
+    }
+
+    for (int changed = 1; changed; ) {
+        changed = 0;
+        for (int i = 0; i < n; ++i) {
+            for (int k = start[i]; pure[i] && k < start[i + 1]; ++k) {
+                if (!pure[callee[k]]) {
+                    pure[i] = 0;
+                    changed = 1;
+                }
+            }
+        }
+    }
+
+    int *comp = (int *)malloc((n + 1) * sizeof(int));
+    int *order = (int *)malloc((n + 1) * sizeof(int));
+    ir_components(n, start, callee, comp, order);
+
+    int memoized = 0;
+    for (int i = 0; i < n; ++i) {
+        ir_func_t *f = funcs[i];
+        f->memo = IR_MEMO_NONE;
+        if (pure[i] && has_overlapping_calls(f, comp)) {
+            f->memo = memo_kind(m, f);
+            memoized += f->memo != IR_MEMO_NONE;
+        }
+    }
+
+    free(order);
+    free(comp);
+    free(pure);
+    free(callee);
+    free(start);
+    free(funcs);
+    return memoized;
+}
@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Sparse conditional constant propagation, see "Constant Propagation with Conditional Branches"
+    by Wegman and Zadeck. A value starts as not known yet (TOP), and is lowered to a constant
+    or to BOTTOM. Only blocks reached through edges found executable are evaluated, so a value
+    defined only on a path not taken does not break a constant.
+    Folding is by ir_fold(), which follows the generated C on int64_t and double, so an operation
+    which is undefined in C, such as division by zero, is not folded.
+*/
+enum sccp_state {
+    SCCP_TOP,
+    SCCP_CONST,
+    SCCP_BOTTOM,
+};
+
+typedef struct sccp_lattice_ {
+    enum sccp_state state;
+    ir_scalar_t c;
+} sccp_lattice_t;
+
+typedef struct sccp_context_ {
+    ir_module_t *m;
+    ir_func_t *func;
+    ir_value_t **values;            // by an id.
+    sccp_lattice_t *lattice;        // by an id.
+    int *use_start;                 // users of a value are user[use_start[id] .. use_start[id + 1]).
+    ir_value_t **user;
+    int *edge_start;                // executable flags of incoming edges of a block by an id.
+    char *edge;
+    char *executable;               // by a block id.
+    ir_block_t **blocks;            // by an id.
+    ir_block_t **flow;              // blocks to be visited.
+    int nflow;
+    ir_value_t **ssa;               // values to be evaluated again.
+    int nssa;
+    int ssacap;
+} sccp_context_t;
+
+static void push_ssa(sccp_context_t *S, ir_value_t *v)
+{
+    if (S->nssa == S->ssacap) {
+        S->ssacap = S->ssacap ? S->ssacap * 2 : 64;
+        S->ssa = (ir_value_t **)realloc(S->ssa, S->ssacap * sizeof(ir_value_t *));
+    }
+    S->ssa[S->nssa++] = v;
+}
+
+static int same_constant(sccp_lattice_t *a, sccp_lattice_t *b)
+{
+    if (a->c.type != b->c.type) {
+        return 0;
+    }
+    /* bits are compared, so that 0.0 and -0.0 are not merged. */
+    return a->c.type == VALTYPE_DBL ? !memcmp(&(a->c.u.dv), &(b->c.u.dv), sizeof(double)) : a->c.u.iv == b->c.u.iv;
+}
+
+static void update(sccp_context_t *S, ir_value_t *v, sccp_lattice_t *l)
+{
+    sccp_lattice_t *cur = &(S->lattice[v->id]);
+    if (cur->state == SCCP_BOTTOM) {
+        return;
+    }
+    if (cur->state == l->state && (l->state != SCCP_CONST || same_constant(cur, l))) {
+        return;
+    }
+    if (cur->state == SCCP_CONST && l->state == SCCP_CONST) {
+        l->state = SCCP_BOTTOM;     // a lattice only goes down.
+    }
+    *cur = *l;
+    for (int i = S->use_start[v->id]; i < S->use_start[v->id + 1]; ++i) {
+        push_ssa(S, S->user[i]);
+    }
+}
+
+static void meet(sccp_lattice_t *acc, sccp_lattice_t *l)
+{
+    if (l->state == SCCP_TOP || acc->state == SCCP_BOTTOM) {
+        return;
+    }
+    if (acc->state == SCCP_TOP || l->state == SCCP_BOTTOM) {
+        *acc = *l;
+        return;
+    }
+    if (!same_constant(acc, l)) {
+        acc->state = SCCP_BOTTOM;
+    }
+}
+
+#define IS_INT_OP(op) ((op) >= IR_IADD && (op) <= IR_IGE)
+#define IS_DBL_OP(op) ((op) >= IR_FADD && (op) <= IR_FGE)
+
+static void evaluate_operation(sccp_context_t *S, ir_value_t *v, sccp_lattice_t *r)
+{
+    r->state = SCCP_BOTTOM;
+    r->c.type = v->type;
+    for (int i = 0; i < v->argc; ++i) {
+        sccp_lattice_t *a = &(S->lattice[v->args[i]->id]);
+        if (a->state == SCCP_BOTTOM) {
+            return;
+        }
+        if (a->state == SCCP_TOP) {
+            r->state = SCCP_TOP;
+        }
+    }
+    if (r->state == SCCP_TOP) {
+        return;
+    }
+
+    sccp_lattice_t *a = &(S->lattice[v->args[0]->id]);
+    sccp_lattice_t *b = (v->argc > 1) ? &(S->lattice[v->args[1]->id]) : NULL;
+    if (ir_fold(v->op, &(a->c), b ? &(b->c) : NULL, &(r->c))) {
+        r->state = SCCP_CONST;
+    }
+    r->c.type = v->type;
+}
+
+static void mark_edge(sccp_context_t *S, ir_block_t *from, ir_block_t *to)
+{
+    int changed = 0;
+    for (int i = 0; i < to->npred; ++i) {
+        char *e = &(S->edge[S->edge_start[to->id] + i]);
+        if (to->pred[i] == from && !*e) {
+            *e = 1;
+            changed = 1;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    if (!S->executable[to->id]) {
+        S->executable[to->id] = 1;
+        S->flow[S->nflow++] = to;
+        return;
+    }
+    for (ir_value_t *phi = to->head; phi && phi->op == IR_PHI; phi = phi->next) {
+        push_ssa(S, phi);
+    }
+}
+
+static void visit(sccp_context_t *S, ir_value_t *v)
+{
+    ir_block_t *b = v->block;
+    sccp_lattice_t r = { .state = SCCP_BOTTOM, .c.type = v->type };
+    switch (v->op) {
+    case IR_CONST:
+        if (v->type == VALTYPE_INT || v->type == VALTYPE_DBL) {
+            r.state = SCCP_CONST;
+            r.c.u.iv = v->u.iv;
+            if (v->type == VALTYPE_DBL) {
+                r.c.u.dv = v->u.dv;
+            }
+        }
+        break;
+    case IR_PHI:
+        r.state = SCCP_TOP;
+        for (int i = 0; i < v->argc; ++i) {
+            if (S->edge[S->edge_start[b->id] + i]) {
+                meet(&r, &(S->lattice[v->args[i]->id]));
+            }
+        }
+        break;
+    case IR_JMP:
+        mark_edge(S, b, v->u.target[0]);
+        return;
+    case IR_BR: {
+        sccp_lattice_t *c = &(S->lattice[v->args[0]->id]);
+        if (c->state == SCCP_CONST) {
+            mark_edge(S, b, v->u.target[c->c.u.iv ? 0 : 1]);
+        } else if (c->state == SCCP_BOTTOM) {
+            mark_edge(S, b, v->u.target[0]);
+            mark_edge(S, b, v->u.target[1]);
+        }
+        return;
+    }
+    case IR_RET:
+    case IR_STORE:
+        return;
+    default:
+        if (IS_INT_OP(v->op) || IS_DBL_OP(v->op) || v->op == IR_I2F || v->op == IR_F2I) {
+            evaluate_operation(S, v, &r);
+        }
+    }
+    update(S, v, &r);
+}
+
+static void build_uses(sccp_context_t *S, ir_func_t *f)
+{
+    int n = f->nvalues;
+    S->use_start = (int *)calloc(n + 2, sizeof(int));
+    for (int i = 0; i < n; ++i) {
+        ir_value_t *v = S->values[i];
+        for (int k = 0; k < v->argc; ++k) {
+            ++S->use_start[v->args[k]->id + 2];
+        }
+    }
+    for (int i = 2; i <= n + 1; ++i) {
+        S->use_start[i] += S->use_start[i - 1];
+    }
+    S->user = (ir_value_t **)malloc((S->use_start[n + 1] + 1) * sizeof(ir_value_t *));
+    for (int i = 0; i < n; ++i) {
+        ir_value_t *v = S->values[i];
+        for (int k = 0; k < v->argc; ++k) {
+            S->user[S->use_start[v->args[k]->id + 1]++] = v;
+        }
+    }
+}
+
+static ir_value_t *new_constant(ir_module_t *m, sccp_lattice_t *l)
+{
+    ir_value_t *c = ir_value_new(m, IR_CONST, l->c.type, 0);
+    if (l->c.type == VALTYPE_DBL) {
+        c->u.dv = l->c.u.dv;
+    } else {
+        c->u.iv = l->c.u.iv;
+    }
+    return c;
+}
+
+/* Values found constant are replaced, and branches are turned to jumps to the only executable target. */
+static void rewrite(sccp_context_t *S, ir_func_t *f, ir_sccp_stats_t *stats)
+{
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        if (!S->executable[b->id]) {
+            continue;
+        }
+        ir_value_t *v = b->head;
+        while (v) {
+            ir_value_t *next = v->next;
+            sccp_lattice_t *l = &(S->lattice[v->id]);
+            if (v->op != IR_CONST && l->state == SCCP_CONST) {
+                ir_value_t *c = new_constant(S->m, l);
+                if (v->op == IR_PHI) {
+                    ir_insert_head(b, c);
+                } else {
+                    ir_insert_before(v, c);
+                }
+                v->forward = c;
+                ir_remove(v);
+                ++stats->folded;
+            } else if (v->op == IR_BR && S->lattice[v->args[0]->id].state == SCCP_CONST) {
+                int taken = S->lattice[v->args[0]->id].c.u.iv ? 0 : 1;
+                ir_block_t *target = v->u.target[taken];
+                ir_block_remove_pred(v->u.target[1 - taken], b);
+                v->op = IR_JMP;
+                v->argc = 0;
+                v->u.target[0] = target;
+                v->u.target[1] = NULL;
+                ++stats->pruned;
+            }
+            v = next;
+        }
+    }
+}
+
+void ir_sccp_function(ir_module_t *m, ir_func_t *f, ir_sccp_stats_t *stats)
+{
+    sccp_context_t ctx = { .m = m, .func = f };
+    sccp_context_t *S = &ctx;
+    ir_func_number(f);
+
+    int nedges = 0;
+    S->values = (ir_value_t **)malloc((f->nvalues + 1) * sizeof(ir_value_t *));
+    S->blocks = (ir_block_t **)malloc((f->nblocks + 1) * sizeof(ir_block_t *));
+    S->edge_start = (int *)malloc((f->nblocks + 1) * sizeof(int));
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        S->blocks[b->id] = b;
+        S->edge_start[b->id] = nedges;
+        nedges += b->npred;
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            S->values[v->id] = v;
+        }
+    }
+    S->lattice = (sccp_lattice_t *)calloc(f->nvalues + 1, sizeof(sccp_lattice_t));
+    S->edge = (char *)calloc(nedges + 1, 1);
+    S->executable = (char *)calloc(f->nblocks + 1, 1);
+    S->flow = (ir_block_t **)malloc((f->nblocks + 1) * sizeof(ir_block_t *));
+    build_uses(S, f);
+
+    S->executable[f->entry->id] = 1;
+    S->flow[S->nflow++] = f->entry;
+    while (S->nflow > 0 || S->nssa > 0) {
+        if (S->nflow > 0) {
+            /* a block is pushed only once, when it becomes executable. */
+            ir_block_t *b = S->flow[--S->nflow];
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                visit(S, v);
+            }
+            continue;
+        }
+        ir_value_t *v = S->ssa[--S->nssa];
+        if (S->executable[v->block->id]) {
+            visit(S, v);
+        }
+    }
+
+    /* a folded value is replaced by a constant, so the difference is what is removed. */
+    int before = f->nvalues, blocks = f->nblocks;
+    rewrite(S, f, stats);
+    ir_func_finish(m, f);
+    ir_func_merge_blocks(f);
+    stats->blocks += blocks - f->nblocks;
+    stats->removed += before - f->nvalues;
+
+    free(S->values);
+    free(S->blocks);
+    free(S->edge_start);
+    free(S->lattice);
+    free(S->edge);
+    free(S->executable);
+    free(S->flow);
+    free(S->use_start);
+    free(S->user);
+    free(S->ssa);
+}
+
+int ir_sccp(ir_module_t *m, ir_sccp_stats_t *stats)
+{
+    memset(stats, 0, sizeof(ir_sccp_stats_t));
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ir_sccp_function(m, f, stats);
+    }
+    return stats->folded + stats->pruned + stats->blocks;
+}
@@ -0,0 +1,304 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Specialization of functions for constant arguments. A direct call passing constants
+    or functions as some arguments calls a clone, which takes only the other arguments,
+    and has the constants in place of the parameters, folded by SCCP. A clone is shared by
+    calls of the same constants, so a recursive call passing a parameter through calls
+    the clone itself. A call with all arguments constant is left to the evaluation of calls.
+    A clone is kept only if SCCP pruned a branch or made it smaller than the function,
+    otherwise it is discarded and the constants are remembered not to be cloned again.
+    Kept clones of a function are limited by a budget, and a function larger than
+    IR_SPEC_MAX_SIZE is not cloned.
+*/
+#define IR_SPEC_MAX_SIZE (1024)
+
+typedef struct spec_clone_ {
+    ir_func_t *func;                // the function specialized.
+    ir_value_t **consts;            // by a parameter, NULL if not constant.
+    ir_func_t *clone;               // NULL if discarded.
+    struct spec_clone_ *next;
+} spec_clone_t;
+
+typedef struct spec_context_ {
+    ir_module_t *m;
+    int budget;
+    ir_spec_stats_t *stats;
+    spec_clone_t *clones;
+} spec_context_t;
+
+#define IS_SPEC_CONSTANT(v) ((v)->op == IR_FUNC || ((v)->op == IR_CONST && (v)->type != VALTYPE_STR))
+
+static int same_constant(ir_value_t *a, ir_value_t *b)
+{
+    if (!a || !b) {
+        return a == b;
+    }
+    if (a->op != b->op || a->type != b->type) {
+        return 0;
+    }
+    if (a->op == IR_FUNC) {
+        return a->u.func == b->u.func;
+    }
+    /* bits are compared, so that 0.0 and -0.0 are not merged. */
+    return a->type == VALTYPE_DBL ? !memcmp(&(a->u.dv), &(b->u.dv), sizeof(double)) : a->u.iv == b->u.iv;
+}
+
+static int function_size(ir_func_t *f)
+{
+    int size = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            size += v->op != IR_CONST && v->op != IR_FUNC && v->op != IR_ARG;
+        }
+    }
+    return size;
+}
+
+static string_t *clone_name(ir_module_t *m, ir_func_t *f, int index)
+{
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "__spec%d", index);
+    string_t *s = (string_t *)ir_alloc(m, sizeof(string_t));
+    s->len = f->name->len + (int)strlen(suffix);
+    s->p = (char *)ir_alloc(m, s->len + 1);
+    snprintf(s->p, s->len + 1, "%s%s", f->name->p, suffix);
+    return s;
+}
+
+/* A copy of a constant in the entry of a clone. */
+static ir_value_t *copy_constant(ir_module_t *m, ir_block_t *b, ir_value_t *c)
+{
+    ir_value_t *v = ir_value_new(m, c->op, c->type, 0);
+    v->u = c->u;
+    return ir_append(b, v);
+}
+
+/*
+    A clone has an entry block with its parameters and the constants, which jumps to a copy
+    of the function. The copy is folded and merged into the entry.
+*/
+static ir_func_t *make_clone(spec_context_t *S, ir_func_t *g, ir_value_t **consts, int index, ir_sccp_stats_t *stats)
+{
+    ir_module_t *m = S->m;
+    type_t *t = type_get(m->types, g->type);
+    ir_func_number(g);
+    int *types = (int *)malloc((g->argc + 1) * sizeof(int));
+    int argc = 0;
+    for (int i = 0; i < g->argc; ++i) {
+        if (!consts[i]) {
+            types[argc++] = t->args[i];
+        }
+    }
+    ir_func_t *f = ir_func_new(m, clone_name(m, g, index), type_function(m->types, g->rtype, argc, types));
+
+    ir_value_t **args = (ir_value_t **)malloc((g->argc + 1) * sizeof(ir_value_t *));
+    argc = 0;
+    for (int i = 0; i < g->argc; ++i) {
+        if (consts[i]) {
+            args[i] = copy_constant(m, f->entry, consts[i]);
+        } else {
+            args[i] = ir_emit(m, f->entry, IR_ARG, t->args[i], NULL, NULL);
+            args[i]->u.iv = argc++;
+        }
+    }
+    ir_block_t **bmap = (ir_block_t **)malloc((g->nblocks + 1) * sizeof(ir_block_t *));
+    ir_value_t **vmap = (ir_value_t **)malloc((g->nvalues + 1) * sizeof(ir_value_t *));
+    ir_func_clone(m, f, g, args, bmap, vmap);
+    ir_value_t *j = ir_emit(m, f->entry, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+    j->u.target[0] = bmap[g->entry->id];
+    ir_block_add_pred(m, j->u.target[0], f->entry);
+
+    memset(stats, 0, sizeof(ir_sccp_stats_t));
+    ir_func_number(f);
+    ir_sccp_function(m, f, stats);
+
+    free(vmap);
+    free(bmap);
+    free(args);
+    free(types);
+    return f;
+}
+
+/* A clone is the last function in the module, since nothing is added after it. */
+static void discard_clone(ir_module_t *m, ir_func_t *clone)
+{
+    ir_func_t *prev = m->funcs;
+    while (prev->next != clone) {
+        prev = prev->next;
+    }
+    prev->next = NULL;
+    m->lastfunc = prev;
+}
+
+/* Returns a clone of g for constants, or NULL if g is over the budget or the clone does not pay. */
+static ir_func_t *find_clone(spec_context_t *S, ir_func_t *g, ir_value_t **consts)
+{
+    int count = 0;
+    for (spec_clone_t *c = S->clones; c; c = c->next) {
+        if (c->func != g) {
+            continue;
+        }
+        count += c->clone != NULL;
+        int i = 0;
+        while (i < g->argc && same_constant(c->consts[i], consts[i])) {
+            ++i;
+        }
+        if (i == g->argc) {
+            return c->clone;
+        }
+    }
+    if (count >= S->budget || function_size(g) > IR_SPEC_MAX_SIZE) {
+        return NULL;
+    }
+
+    spec_clone_t *c = (spec_clone_t *)calloc(1, sizeof(spec_clone_t));
+    c->func = g;
+    c->consts = (ir_value_t **)malloc((g->argc + 1) * sizeof(ir_value_t *));
+    memcpy(c->consts, consts, g->argc * sizeof(ir_value_t *));
+    ir_sccp_stats_t stats;
+    c->clone = make_clone(S, g, consts, count + 1, &stats);
+    if (stats.pruned == 0 && function_size(c->clone) >= function_size(g)) {
+        discard_clone(S->m, c->clone);
+        c->clone = NULL;
+        ++S->stats->discarded;
+    } else {
+        c->clone->mark = 1;             // referred by the call.
+        S->stats->folded += stats.folded;
+        ++S->stats->clones;
+    }
+    c->next = S->clones;
+    S->clones = c;
+    return c->clone;
+}
+
+/*
+    A call is replaced by a call of the clone with the arguments which are not constant.
+    Uses are replaced at once, since f may be cloned for a later call in it.
+*/
+static void specialize_call(spec_context_t *S, ir_func_t *f, ir_value_t *call, ir_func_t *clone, ir_value_t **consts)
+{
+    ir_module_t *m = S->m;
+    ir_func_t *g = call->args[0]->u.func;
+    ir_value_t *v = ir_value_new(m, IR_CALL, call->type, 1 + clone->argc);
+    v->args[0] = ir_insert_before(call, ir_value_new(m, IR_FUNC, clone->type, 0));
+    v->args[0]->u.func = clone;
+    for (int i = 0, k = 1; i < g->argc; ++i) {
+        if (!consts[i]) {
+            v->args[k++] = ir_resolve(call->args[i + 1]);
+        }
+    }
+    ir_insert_before(call, v);
+    ir_remove(call);
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *u = b->head; u; u = u->next) {
+            for (int i = 0; i < u->argc; ++i) {
+                if (u->args[i] == call) {
+                    u->args[i] = v;
+                }
+            }
+        }
+    }
+}
+
+static int specialize_function(spec_context_t *S, ir_func_t *f)
+{
+    int nsites = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            nsites += v->op == IR_CALL && v->args[0]->op == IR_FUNC;
+        }
+    }
+    if (nsites == 0) {
+        return 0;
+    }
+    ir_value_t **sites = (ir_value_t **)malloc(nsites * sizeof(ir_value_t *));
+    nsites = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (v->op == IR_CALL && v->args[0]->op == IR_FUNC) {
+                sites[nsites++] = v;
+            }
+        }
+    }
+
+    int specialized = 0;
+    for (int s = 0; s < nsites; ++s) {
+        ir_value_t *call = sites[s];
+        ir_func_t *g = call->args[0]->u.func;
+        if (g == S->m->main || call->argc != g->argc + 1) {
+            continue;
+        }
+        ir_value_t **consts = (ir_value_t **)calloc(g->argc + 1, sizeof(ir_value_t *));
+        int nconsts = 0;
+        for (int i = 0; i < g->argc; ++i) {
+            ir_value_t *a = ir_resolve(call->args[i + 1]);
+            if (IS_SPEC_CONSTANT(a)) {
+                consts[i] = a;
+                ++nconsts;
+            }
+        }
+        ir_func_t *clone = (nconsts > 0 && nconsts < g->argc) ? find_clone(S, g, consts) : NULL;
+        if (clone) {
+            specialize_call(S, f, call, clone, consts);
+            ++specialized;
+        }
+        free(consts);
+    }
+    free(sites);
+
+    if (specialized > 0) {
+        ir_func_remove_dead(f);
+    }
+    return specialized;
+}
+
+int ir_specialize(ir_module_t *m, int budget, vector_t *keep, ir_spec_stats_t *stats)
+{
+    spec_context_t ctx = { .m = m, .budget = budget, .stats = stats };
+    memset(stats, 0, sizeof(ir_spec_stats_t));
+
+    /* mark is whether a function is referred, clones are added to the list, and visited too. */
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        f->mark = 0;
+        ir_func_number(f);
+    }
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (v->op == IR_FUNC) {
+                    v->u.func->mark = 1;
+                }
+            }
+        }
+    }
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        stats->calls += specialize_function(&ctx, f);
+    }
+
+    int n = 0;
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        ++n;
+    }
+    ir_func_t **funcs = (ir_func_t **)malloc((n + 1) * sizeof(ir_func_t *));
+    char *referred = (char *)calloc(n + 1, 1);
+    n = 0;
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        referred[n] = (char)f->mark;
+        funcs[n] = f;
+        f->mark = n++;
+    }
+    stats->removed = ir_module_remove_functions(m, funcs, n, referred, keep);
+
+    while (ctx.clones) {
+        spec_clone_t *next = ctx.clones->next;
+        free(ctx.clones->consts);
+        free(ctx.clones);
+        ctx.clones = next;
+    }
+    free(referred);
+    free(funcs);
+    return stats->calls;
+}
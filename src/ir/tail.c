@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <string.h>
+#include "ir.h"
+
+/*
+    Tail calls into jumps, so that recursion in tail positions runs in constant stack.
+    A tail call is a direct call whose value is returned at once, see IR_IS_TAIL_CALL().
+
+    A function calling itself in tail positions gets a header after its entry, with a phi
+    for each parameter, and such a call assigns arguments to the phis and jumps to the header.
+
+    Functions calling each other in tail positions, a component of the graph of tail calls,
+    are merged into a dispatch function. It takes a selector and parameters of all of them,
+    and branches to a copy of the selected function, where a tail call to another one jumps to
+    the header of its copy. Each function becomes a wrapper which calls the dispatch function.
+    A group is merged only if all of them return the same type and take numbers.
+*/
+
+/* Arguments of the call are given to phis of the header, and the call and the return are replaced by a jump. */
+static void jump_to_header(ir_module_t *m, ir_value_t *call, ir_block_t *header, ir_value_t **phis)
+{
+    ir_block_t *b = call->block;
+    for (int i = 1; i < call->argc; ++i) {
+        ir_phi_add(m, phis[i - 1], call->args[i]);
+    }
+    ir_remove(call->next);
+    ir_remove(call);
+    ir_value_t *j = ir_emit(m, b, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+    j->u.target[0] = header;
+    ir_block_add_pred(m, header, b);
+}
+
+static int collect_tail_calls(ir_func_t *f, ir_func_t *callee, ir_value_t ***sites, int *cap)
+{
+    int n = 0;
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            if (!IR_IS_TAIL_CALL(v) || (callee && v->args[0]->u.func != callee)) {
+                continue;
+            }
+            if (n == *cap) {
+                *cap = *cap ? *cap * 2 : 16;
+                *sites = (ir_value_t **)realloc(*sites, *cap * sizeof(ir_value_t *));
+            }
+            (*sites)[n++] = v;
+        }
+    }
+    return n;
+}
+
+/* The entry keeps arguments and jumps to the old entry, which becomes the header. */
+static int eliminate_self_calls(ir_module_t *m, ir_func_t *f)
+{
+    ir_value_t **sites = NULL;
+    int cap = 0;
+    int n = (f == m->main || f->entry->npred > 0) ? 0 : collect_tail_calls(f, f, &sites, &cap);
+    if (n == 0) {
+        free(sites);
+        return 0;
+    }
+
+    type_t *t = type_get(m->types, f->type);
+    ir_block_t *header = f->entry;
+    ir_block_t *last = f->last;
+    ir_block_t *entry = ir_block_new(m, f);
+    entry->sealed = 1;
+    last->next = NULL;
+    f->last = last;
+    entry->next = header;
+    f->entry = entry;
+
+    ir_value_t **args = (ir_value_t **)calloc(f->argc + 1, sizeof(ir_value_t *));
+    ir_value_t **phis = (ir_value_t **)calloc(f->argc + 1, sizeof(ir_value_t *));
+    for (ir_value_t *v = header->head; v; v = v->next) {
+        if (v->op == IR_ARG) {
+            args[v->u.iv] = v;
+        }
+    }
+    for (int i = 0; i < f->argc; ++i) {
+        if (args[i]) {
+            ir_remove(args[i]);
+            ir_append(entry, args[i]);
+        } else {
+            args[i] = ir_emit(m, entry, IR_ARG, t->args[i], NULL, NULL);
+            args[i]->u.iv = i;
+        }
+        phis[i] = ir_value_new(m, IR_PHI, args[i]->type, 0);
+    }
+    for (ir_block_t *b = header; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            for (int i = 0; i < v->argc; ++i) {
+                if (v->args[i]->op == IR_ARG) {
+                    v->args[i] = phis[v->args[i]->u.iv];
+                }
+            }
+        }
+    }
+    for (int i = f->argc - 1; i >= 0; --i) {
+        ir_insert_head(header, phis[i]);
+        ir_phi_add(m, phis[i], args[i]);
+    }
+    ir_value_t *j = ir_emit(m, entry, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+    j->u.target[0] = header;
+    ir_block_add_pred(m, header, entry);
+
+    for (int i = 0; i < n; ++i) {
+        jump_to_header(m, sites[i], header, phis);
+    }
+    ir_func_remove_dead(f);
+
+    free(phis);
+    free(args);
+    free(sites);
+    return n;
+}
+
+static string_t *dispatch_name(ir_module_t *m, ir_func_t *f)
+{
+    string_t *s = (string_t *)ir_alloc(m, sizeof(string_t));
+    s->len = f->name->len + (int)strlen("__tail");
+    s->p = (char *)ir_alloc(m, s->len + 1);
+    snprintf(s->p, s->len + 1, "%s__tail", f->name->p);
+    return s;
+}
+
+static int can_merge(ir_module_t *m, ir_func_t **group, int n)
+{
+    for (int i = 0; i < n; ++i) {
+        ir_func_t *f = group[i];
+        if (f == m->main || f->entry->npred > 0 || f->rtype != group[0]->rtype) {
+            return 0;
+        }
+        type_t *t = type_get(m->types, f->type);
+        for (int k = 0; k < t->argc; ++k) {
+            if (t->args[k] != VALTYPE_INT && t->args[k] != VALTYPE_DBL) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Returns the number of tail calls turned into jumps. */
+static int merge_group(ir_module_t *m, ir_func_t **group, int n)
+{
+    int total = 1;
+    int *base = (int *)malloc((n + 1) * sizeof(int));   // the first parameter of each function.
+    for (int i = 0; i < n; ++i) {
+        base[i] = total;
+        total += group[i]->argc;
+    }
+    int *types = (int *)malloc(total * sizeof(int));
+    types[0] = VALTYPE_INT;
+    for (int i = 0; i < n; ++i) {
+        type_t *t = type_get(m->types, group[i]->type);
+        for (int k = 0; k < t->argc; ++k) {
+            types[base[i] + k] = t->args[k];
+        }
+    }
+    ir_func_t *d = ir_func_new(m, dispatch_name(m, group[0]), type_function(m->types, group[0]->rtype, total, types));
+
+    ir_value_t **params = (ir_value_t **)malloc(total * sizeof(ir_value_t *));
+    for (int i = 0; i < total; ++i) {
+        params[i] = ir_emit(m, d->entry, IR_ARG, types[i], NULL, NULL);
+        params[i]->u.iv = i;
+    }
+
+    /* a header has a phi for each parameter, and jumps to a copy of the function. */
+    ir_block_t **headers = (ir_block_t **)malloc(n * sizeof(ir_block_t *));
+    ir_value_t ***phis = (ir_value_t ***)malloc(n * sizeof(ir_value_t **));
+    ir_block_t *b = d->entry;
+    for (int i = 0; i < n; ++i) {
+        ir_func_t *f = group[i];
+        headers[i] = ir_block_new(m, d);
+        headers[i]->sealed = 1;
+        phis[i] = (ir_value_t **)malloc((f->argc + 1) * sizeof(ir_value_t *));
+        for (int k = 0; k < f->argc; ++k) {
+            phis[i][k] = ir_append(headers[i], ir_value_new(m, IR_PHI, types[base[i] + k], 0));
+            ir_phi_add(m, phis[i][k], params[base[i] + k]);
+        }
+
+        ir_block_t **bmap = (ir_block_t **)malloc((f->nblocks + 1) * sizeof(ir_block_t *));
+        ir_value_t **vmap = (ir_value_t **)malloc((f->nvalues + 1) * sizeof(ir_value_t *));
+        ir_func_clone(m, d, f, phis[i], bmap, vmap);
+        ir_value_t *j = ir_emit(m, headers[i], IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+        j->u.target[0] = bmap[f->entry->id];
+        ir_block_add_pred(m, j->u.target[0], headers[i]);
+        free(vmap);
+        free(bmap);
+
+        /* the selector is compared in a chain of branches, the last one is not compared. */
+        if (i == n - 1) {
+            j = ir_emit(m, b, IR_JMP, VALTYPE_UNKNOWN, NULL, NULL);
+            j->u.target[0] = headers[i];
+            ir_block_add_pred(m, headers[i], b);
+            break;
+        }
+        ir_value_t *eq = ir_emit(m, b, IR_IEQ, VALTYPE_INT, params[0], ir_const_int(m, b, i));
+        ir_block_t *next = ir_block_new(m, d);
+        next->sealed = 1;
+        ir_value_t *br = ir_emit(m, b, IR_BR, VALTYPE_UNKNOWN, eq, NULL);
+        br->u.target[0] = headers[i];
+        br->u.target[1] = next;
+        ir_block_add_pred(m, headers[i], b);
+        ir_block_add_pred(m, next, b);
+        b = next;
+    }
+
+    int jumps = 0;
+    ir_value_t **sites = NULL;
+    int cap = 0;
+    int nsites = collect_tail_calls(d, NULL, &sites, &cap);
+    for (int s = 0; s < nsites; ++s) {
+        for (int i = 0; i < n; ++i) {
+            if (sites[s]->args[0]->u.func == group[i]) {
+                jump_to_header(m, sites[s], headers[i], phis[i]);
+                ++jumps;
+                break;
+            }
+        }
+    }
+    free(sites);
+    ir_func_remove_dead(d);
+    ir_func_merge_blocks(d);
+
+    /* the functions pass the selector and their own arguments, and zeros for the others. */
+    for (int i = 0; i < n; ++i) {
+        ir_func_t *f = group[i];
+        f->entry = f->last = NULL;
+        f->nblocks = 0;
+        b = ir_block_new(m, f);
+        b->sealed = 1;
+        ir_value_t *call = ir_value_new(m, IR_CALL, f->rtype, total + 1);
+        call->args[0] = ir_emit(m, b, IR_FUNC, d->type, NULL, NULL);
+        call->args[0]->u.func = d;
+        call->args[1] = ir_const_int(m, b, i);
+        for (int k = 1; k < total; ++k) {
+            if (k >= base[i] && k < base[i] + f->argc) {
+                call->args[k + 1] = ir_emit(m, b, IR_ARG, types[k], NULL, NULL);
+                call->args[k + 1]->u.iv = k - base[i];
+            } else if (types[k] == VALTYPE_DBL) {
+                call->args[k + 1] = ir_const_dbl(m, b, 0.0);
+            } else {
+                call->args[k + 1] = ir_const_int(m, b, 0);
+            }
+        }
+        ir_append(b, call);
+        ir_emit(m, b, IR_RET, VALTYPE_UNKNOWN, call, NULL);
+        ir_func_number(f);
+    }
+
+    for (int i = 0; i < n; ++i) {
+        free(phis[i]);
+    }
+    free(phis);
+    free(headers);
+    free(params);
+    free(types);
+    free(base);
+    return jumps;
+}
+
+/* Components of the graph of tail calls between different functions. */
+static void merge_mutual_calls(ir_module_t *m, ir_tail_stats_t *stats)
+{
+    int n = 0;
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        f->mark = n++;
+    }
+    ir_func_t **funcs = (ir_func_t **)malloc((n + 1) * sizeof(ir_func_t *));
+    int *start = (int *)calloc(n + 1, sizeof(int));
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        funcs[f->mark] = f;
+        for (ir_block_t *b = f->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (IR_IS_TAIL_CALL(v) && v->args[0]->u.func != f) {
+                    ++start[f->mark + 1];
+                }
+            }
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        start[i + 1] += start[i];
+    }
+    int *edge = (int *)malloc((start[n] + 1) * sizeof(int));
+    for (int i = 0, k = 0; i < n; ++i) {
+        for (ir_block_t *b = funcs[i]->entry; b; b = b->next) {
+            for (ir_value_t *v = b->head; v; v = v->next) {
+                if (IR_IS_TAIL_CALL(v) && v->args[0]->u.func != funcs[i]) {
+                    edge[k++] = v->args[0]->u.func->mark;
+                }
+            }
+        }
+    }
+
+    int *comp = (int *)malloc((n + 1) * sizeof(int));
+    int *order = (int *)malloc((n + 1) * sizeof(int));
+    ir_components(n, start, edge, comp, order);
+    ir_func_t **group = (ir_func_t **)malloc((n + 1) * sizeof(ir_func_t *));
+    for (int i = 0; i < n; ) {
+        int k = 0;
+        for (int c = comp[order[i]]; i < n && comp[order[i]] == c; ++i) {
+            group[k++] = funcs[order[i]];
+        }
+        if (k < 2 || !can_merge(m, group, k)) {
+            continue;
+        }
+        /* functions are kept in the order of definitions in a group. */
+        for (int x = 1; x < k; ++x) {
+            for (int y = x; y > 0 && group[y - 1]->mark > group[y]->mark; --y) {
+                ir_func_t *tmp = group[y];
+                group[y] = group[y - 1];
+                group[y - 1] = tmp;
+            }
+        }
+        stats->mutual += merge_group(m, group, k);
+        ++stats->groups;
+    }
+
+    free(group);
+    free(order);
+    free(comp);
+    free(edge);
+    free(start);
+    free(funcs);
+}
+
+int ir_tail_calls(ir_module_t *m, ir_tail_stats_t *stats)
+{
+    memset(stats, 0, sizeof(ir_tail_stats_t));
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        stats->self += eliminate_self_calls(m, f);
+    }
+    merge_mutual_calls(m, stats);
+    return stats->self + stats->mutual;
+}
@@ -0,0 +1,237 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include "ir.h"
+
+typedef struct ir_verify_context_ {
+    ir_module_t *m;
+    ir_func_t *func;
+    ir_value_t **values;            // by an id.
+    int errors;
+} ir_verify_context_t;
+
+static void verify_error(ir_verify_context_t *V, ir_block_t *b, ir_value_t *v, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    printf("ir: %s: b%d", V->func->name ? V->func->name->p : "main", b->id);
+    if (v) {
+        printf(": v%d %s", v->id, ir_op_name(v->op));
+    }
+    printf(": ");
+    vprintf(format, ap);
+    printf("\n");
+    va_end(ap);
+    ++V->errors;
+}
+
+static int dominates(ir_block_t *a, ir_block_t *b)
+{
+    for ( ; ; ) {
+        if (a == b) {
+            return 1;
+        }
+        if (!b->idom || b->idom == b) {
+            return 0;
+        }
+        b = b->idom;
+    }
+}
+
+static int has_edge(ir_block_t *from, ir_block_t *to)
+{
+    ir_block_t *succ[2];
+    int n = ir_successors(from, succ);
+    for (int i = 0; i < n; ++i) {
+        if (succ[i] == to) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int has_pred(ir_block_t *b, ir_block_t *pred)
+{
+    for (int i = 0; i < b->npred; ++i) {
+        if (b->pred[i] == pred) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void verify_operands(ir_verify_context_t *V, ir_block_t *b, ir_value_t *v)
+{
+    for (int i = 0; i < v->argc; ++i) {
+        ir_value_t *a = v->args[i];
+        if (!a || a->id < 0 || a->id >= V->func->nvalues || V->values[a->id] != a) {
+            verify_error(V, b, v, "operand %d is not a value of the function", i);
+            continue;
+        }
+        if (a->op == IR_STORE || IR_IS_TERMINATOR(a->op)) {
+            verify_error(V, b, v, "operand %d has no value", i);
+        }
+        if (v->op == IR_PHI) {
+            if (i < b->npred && !dominates(a->block, b->pred[i])) {
+                verify_error(V, b, v, "operand v%d does not dominate b%d", a->id, b->pred[i]->id);
+            }
+        } else if (a->block == b ? a->id >= v->id : !dominates(a->block, b)) {
+            verify_error(V, b, v, "operand v%d does not dominate the use", a->id);
+        }
+    }
+}
+
+#define EXPECT(cond, msg) if (!(cond)) verify_error(V, b, v, msg)
+
+static void verify_types(ir_verify_context_t *V, ir_block_t *b, ir_value_t *v)
+{
+    type_table_t *types = V->m->types;
+    switch (v->op) {
+    case IR_CONST:
+        EXPECT(v->type == VALTYPE_INT || v->type == VALTYPE_DBL || v->type == VALTYPE_STR, "invalid type of a constant");
+        break;
+    case IR_FUNC:
+        EXPECT(v->u.func && v->type == v->u.func->type, "type differs from the function");
+        break;
+    case IR_ARG:
+        if (v->u.iv < 0 || v->u.iv >= V->func->argc) {
+            verify_error(V, b, v, "index out of arguments");
+        } else {
+            EXPECT(v->type == type_get(types, V->func->type)->args[v->u.iv], "type differs from the argument");
+        }
+        EXPECT(b == V->func->entry, "not in the entry block");
+        break;
+    case IR_PHI:
+        EXPECT(v->argc == b->npred, "operands differ from predecessors");
+        for (int i = 0; i < v->argc; ++i) {
+            EXPECT(v->args[i]->type == v->type, "operand of another type");
+        }
+        break;
+    case IR_IADD: case IR_ISUB: case IR_IMUL: case IR_IDIV: case IR_IMOD:
+    case IR_IEQ: case IR_INE: case IR_ILT: case IR_ILE: case IR_IGT: case IR_IGE:
+        EXPECT(v->argc == 2 && v->args[0]->type == VALTYPE_INT && v->args[1]->type == VALTYPE_INT, "operands are not int");
+        EXPECT(v->type == VALTYPE_INT, "result is not int");
+        break;
+    case IR_FADD: case IR_FSUB: case IR_FMUL: case IR_FDIV: case IR_FMOD:
+        EXPECT(v->type == VALTYPE_DBL, "result is not dbl");
+        EXPECT(v->argc == 2 && v->args[0]->type == VALTYPE_DBL && v->args[1]->type == VALTYPE_DBL, "operands are not dbl");
+        break;
+    case IR_FEQ: case IR_FNE: case IR_FLT: case IR_FLE: case IR_FGT: case IR_FGE:
+        EXPECT(v->type == VALTYPE_INT, "result is not int");
+        EXPECT(v->argc == 2 && v->args[0]->type == VALTYPE_DBL && v->args[1]->type == VALTYPE_DBL, "operands are not dbl");
+        break;
+    case IR_I2F:
+        EXPECT(v->argc == 1 && v->args[0]->type == VALTYPE_INT && v->type == VALTYPE_DBL, "not from int to dbl");
+        break;
+    case IR_F2I:
+        EXPECT(v->argc == 1 && v->args[0]->type == VALTYPE_DBL && v->type == VALTYPE_INT, "not from dbl to int");
+        break;
+    case IR_LOAD:
+        EXPECT(v->u.global && v->type == v->u.global->type, "type differs from the global");
+        break;
+    case IR_STORE:
+        EXPECT(v->u.global && v->argc == 1 && v->args[0]->type == v->u.global->type, "type differs from the global");
+        break;
+    case IR_CALL: {
+        if (v->argc < 1) {
+            verify_error(V, b, v, "no callee");
+            break;
+        }
+        type_t *t = type_get(types, v->args[0]->type);
+        if (t->vtype != VALTYPE_FUNC || t->argc != v->argc - 1) {
+            verify_error(V, b, v, "callee does not take %d arguments", v->argc - 1);
+            break;
+        }
+        for (int i = 1; i < v->argc; ++i) {
+            EXPECT(v->args[i]->type == t->args[i - 1], "argument of another type");
+        }
+        EXPECT(v->type == t->rtype, "type differs from the returned type");
+        break;
+    }
+    case IR_BR:
+        EXPECT(v->argc == 1 && v->args[0]->type == VALTYPE_INT, "condition is not int");
+        EXPECT(v->u.target[0] && v->u.target[1], "no target");
+        break;
+    case IR_JMP:
+        EXPECT(v->u.target[0], "no target");
+        break;
+    case IR_RET:
+        if (V->func != V->m->main) {
+            EXPECT(v->argc == 1 && v->args[0]->type == V->func->rtype, "returned value of another type");
+        }
+        break;
+    default:
+        ;
+    }
+}
+
+static void verify_block(ir_verify_context_t *V, ir_block_t *b)
+{
+    if (b->rpo < 0) {
+        verify_error(V, b, NULL, "not reachable");
+        return;
+    }
+    if (!ir_terminator(b)) {
+        verify_error(V, b, NULL, "no terminator");
+    }
+    int phis = 1;
+    for (ir_value_t *v = b->head; v; v = v->next) {
+        if (v->block != b) {
+            verify_error(V, b, v, "linked to another block");
+        }
+        if (v->op == IR_PHI && !phis) {
+            verify_error(V, b, v, "phi after another value");
+        }
+        phis = v->op == IR_PHI;
+        if (IR_IS_TERMINATOR(v->op) && v->next) {
+            verify_error(V, b, v, "terminator in the middle");
+        }
+        verify_operands(V, b, v);
+        verify_types(V, b, v);
+    }
+
+    ir_block_t *succ[2];
+    int n = ir_successors(b, succ);
+    for (int i = 0; i < n; ++i) {
+        if (!has_pred(succ[i], b)) {
+            verify_error(V, b, NULL, "b%d does not list it as a predecessor", succ[i]->id);
+        }
+    }
+    for (int i = 0; i < b->npred; ++i) {
+        if (!has_edge(b->pred[i], b)) {
+            verify_error(V, b, NULL, "predecessor b%d does not jump to it", b->pred[i]->id);
+        }
+    }
+}
+
+static void verify_function(ir_verify_context_t *V, ir_func_t *f)
+{
+    V->func = f;
+    ir_func_number(f);
+    ir_func_dominators(f);
+    V->values = (ir_value_t **)malloc((f->nvalues + 1) * sizeof(ir_value_t *));
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        for (ir_value_t *v = b->head; v; v = v->next) {
+            V->values[v->id] = v;
+        }
+    }
+    if (f->entry->npred > 0) {
+        verify_error(V, f->entry, NULL, "entry block has predecessors");
+    }
+    for (ir_block_t *b = f->entry; b; b = b->next) {
+        verify_block(V, b);
+    }
+    free(V->values);
+}
+
+/*
+    Checks structure, SSA dominance and types of every function, errors are printed
+    and the number of them is returned.
+*/
+int ir_verify(ir_module_t *m)
+{
+    ir_verify_context_t ctx = { .m = m };
+    for (ir_func_t *f = m->funcs; f; f = f->next) {
+        verify_function(&ctx, f);
+    }
+    return ctx.errors;
+}
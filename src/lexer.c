@@ -1,4 +1,14 @@
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#include <io.h>
+#include <sys/stat.h>
+#undef ERROR    /* conflicts with the token name. */
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 #include "lexer.h"
+#include "lexscan.h"
 #include "kiss.tab.h"
 
 #define lex_is_whitespace(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
@@ -6,6 +16,130 @@
 #define lex_is_name1(c) (isalpha(c) || (c) == '$' || (c) == '_')
 #define lex_is_name2(c) (isalnum(c) || (c) == '$' || (c) == '_')
 
+/*
+    Source reader, the whole source is placed on memory before lexing.
+    A regular file is mapped into memory, and other streams like a pipe are read into a buffer.
+*/
+static int lex_map_file(kiss_lexctx_t *lexctx, FILE *fp)
+{
+#if defined(_WIN32) || defined(_WIN64)
+    struct _stat64 st;
+    if (_fstat64(_fileno(fp), &st) != 0 || !(st.st_mode & _S_IFREG) || st.st_size <= 0) {
+        return 0;
+    }
+    HANDLE maph = CreateFileMapping((HANDLE)_get_osfhandle(_fileno(fp)), NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!maph) {
+        return 0;
+    }
+    void *p = MapViewOfFile(maph, FILE_MAP_READ, 0, 0, 0);
+    if (!p) {
+        CloseHandle(maph);
+        return 0;
+    }
+    lexctx->maph = (void *)maph;
+#else
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+        return 0;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (p == MAP_FAILED) {
+        return 0;
+    }
+#endif
+    lexctx->mode = LEX_SOURCE_MMAP;
+    lexctx->buf = (const char *)p;
+    lexctx->len = (size_t)st.st_size;
+    return 1;
+}
+
+static int lex_read_file(kiss_lexctx_t *lexctx, FILE *fp)
+{
+    size_t cap = LEX_READ_UNIT;
+    size_t len = 0;
+    char *buf = (char *)malloc(cap);
+    if (!buf) {
+        return 0;
+    }
+    while (1) {
+        size_t r = fread(buf + len, 1, cap - len, fp);
+        len += r;
+        if (len < cap) {
+            if (ferror(fp)) {
+                free(buf);
+                return 0;
+            }
+            break;
+        }
+        cap *= 2;
+        char *np = (char *)realloc(buf, cap);
+        if (!np) {
+            free(buf);
+            return 0;
+        }
+        buf = np;
+    }
+    lexctx->mode = LEX_SOURCE_BUFFER;
+    lexctx->buf = buf;
+    lexctx->len = len;
+    return 1;
+}
+
+int lex_open_file(kiss_lexctx_t *lexctx, const char *filename)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        return 0;
+    }
+    lex_scan_init();
+    int r = lex_map_file(lexctx, fp) || lex_read_file(lexctx, fp);
+    fclose(fp);
+    if (!r) {
+        return 0;
+    }
+    lexctx->p = lexctx->buf;
+    lexctx->end = lexctx->buf + lexctx->len;
+    return 1;
+}
+
+int lex_open_buffer(kiss_lexctx_t *lexctx, const char *src, size_t len)
+{
+    if (!src) {
+        return 0;
+    }
+    lex_scan_init();
+    lexctx->mode = LEX_SOURCE_MEMORY;
+    lexctx->buf = src;
+    lexctx->len = len;
+    lexctx->p = lexctx->buf;
+    lexctx->end = lexctx->buf + lexctx->len;
+    return 1;
+}
+
+void lex_close(kiss_lexctx_t *lexctx)
+{
+    switch (lexctx->mode) {
+    case LEX_SOURCE_MMAP:
+#if defined(_WIN32) || defined(_WIN64)
+        UnmapViewOfFile((void *)lexctx->buf);
+        CloseHandle((HANDLE)lexctx->maph);
+#else
+        munmap((void *)lexctx->buf, lexctx->len);
+#endif
+        break;
+    case LEX_SOURCE_BUFFER:
+        free((void *)lexctx->buf);
+        break;
+    default:
+        ;
+    }
+    lexctx->mode = LEX_SOURCE_NONE;
+    lexctx->buf = NULL;
+    lexctx->len = 0;
+    lexctx->maph = NULL;
+    lexctx->p = lexctx->end = NULL;
+}
+
 static int lex_curr(kiss_lexctx_t *lexctx)
 {
     return lexctx->ch;
@@ -13,54 +147,81 @@ static int lex_curr(kiss_lexctx_t *lexctx)
 
 static int lex_next(kiss_lexctx_t *lexctx)
 {
-    if (lexctx->ch == EOF) {
-        return EOF;
-    }
-    int ch = fgetc(lexctx->fp);
-    if (ch == EOF) {
+    if (lexctx->p >= lexctx->end) {
         return lexctx->ch = EOF;
     }
-    return lexctx->ch = ch;
+    return lexctx->ch = (unsigned char)*(lexctx->p++);
 }
 
-static int get_token_of_keyword(string_t *s)
+/* The offset of the last token, which can be passed to lex_seek() to read it again. */
+size_t lex_tell(kiss_lexctx_t *lexctx)
 {
-    char *buf = s->p;
-    char ch = buf[0];
-    if (ch == '_') {
-        if (!strcmp(buf, "_printf")) return _PRINTF;
-    } else if (ch == 'd') {
-        if (!strcmp(buf, "dbl")) return DBL_TYPE;
-    } else if (ch == 'e') {
-        if (!strcmp(buf, "else")) return ELSE;
-    } else if (ch == 'f') {
-        if (!strcmp(buf, "for")) return FOR;
-        if (!strcmp(buf, "function")) return FUNCTION;
-    } else if (ch == 'i') {
-        if (!strcmp(buf, "if")) return IF;
-        if (!strcmp(buf, "int")) return INT_TYPE;
-    } else if (ch == 'r') {
-        if (!strcmp(buf, "return")) return RETURN;
-    } else if (ch == 'v') {
-        if (!strcmp(buf, "var")) return VAR;
-    } else if (ch == 'w') {
-        if (!strcmp(buf, "while")) return WHILE;
+    return (size_t)(lexctx->token - lexctx->buf);
+}
+
+void lex_seek(kiss_lexctx_t *lexctx, size_t offset)
+{
+    lexctx->p = lexctx->buf + offset;
+    lexctx->ch = ' ';
+}
+
+/* The position of the current character in the source. */
+static const char *lex_pos(kiss_lexctx_t *lexctx)
+{
+    return lexctx->ch == EOF ? lexctx->end : lexctx->p - 1;
+}
+
+/*
+    Keywords are found by a perfect hash, which is the low bits of the same hash as the string set.
+    The table is generated by searching the smallest power of 2 which has no collision of keywords.
+*/
+#define LEX_KEYWORD_HASHMASK (63)
+#define LEX_KEYWORD_MINLEN (2)
+#define LEX_KEYWORD_MAXLEN (8)
+
+static const struct lex_keyword {
+    const char *name;
+    int len;
+    int token;
+} lex_keywords[LEX_KEYWORD_HASHMASK + 1] = {
+    [6] = { "if", 2, IF },
+    [9] = { "function", 8, FUNCTION },
+    [13] = { "_printf", 7, _PRINTF },
+    [14] = { "while", 5, WHILE },
+    [16] = { "for", 3, FOR },
+    [30] = { "int", 3, INT_TYPE },
+    [48] = { "else", 4, ELSE },
+    [61] = { "dbl", 3, DBL_TYPE },
+    [62] = { "var", 3, VAR },
+    [63] = { "return", 6, RETURN },
+};
+
+static int get_token_of_keyword(const char *p, int len, unsigned hash)
+{
+    if (len < LEX_KEYWORD_MINLEN || LEX_KEYWORD_MAXLEN < len) {
+        return NAME;
+    }
+    const struct lex_keyword *kw = &lex_keywords[hash & LEX_KEYWORD_HASHMASK];
+    if (kw->len == len && !memcmp(kw->name, p, len)) {
+        return kw->token;
     }
     return NAME;
 }
 
 #define LEX_BUFMAX (256)
-int yylex(YYSTYPE *yylval, kiss_parsectx_t *parsectx)
+int lex_read_token(YYSTYPE *yylval, kiss_parsectx_t *parsectx)
 {
     kiss_lexctx_t *lexctx = &(parsectx->lexctx);
     int ch = lex_curr(lexctx);
 
 RETRY:;
     // skip whitespaces.
-    while (lex_is_whitespace(ch)) {
+    if (lex_is_whitespace(ch)) {
+        lexctx->p = lex_scan_space(lexctx->p, lexctx->end);
         ch = lex_next(lexctx);
     }
 
+    lexctx->token = lex_pos(lexctx);
     if (ch == EOF) {
         return EOF;
     }
@@ -91,9 +252,25 @@ RETRY:;
     LEX_CASE('(');
     LEX_CASE(')');
     case '"': {
-        string_t *s = string_clear(parsectx->s);
+        /* A literal without any format specifier is interned directly from the source. */
+        const char *start = lexctx->p;
         ch = lex_next(lexctx);
-        while (ch != '"') {
+        while (ch != '"' && ch != '%' && ch != EOF) {
+            if (ch == '\\') {
+                ch = lex_next(lexctx);
+            } else {
+                lexctx->p = lex_scan_string(lexctx->p, lexctx->end);
+            }
+            ch = lex_next(lexctx);
+        }
+        if (ch != '%') {
+            yylval->sv = string_set_insert_len(parsectx->string_mgr, start, lex_pos(lexctx) - start);
+            lex_next(lexctx);
+            return STR_VALUE;
+        }
+        string_t *s = string_clear(parsectx->s);
+        string_append_len(s, start, lex_pos(lexctx) - start);
+        while (ch != '"' && ch != EOF) {
             if (ch == '%') {
                 string_append_char(s, '%');
                 ch = lex_next(lexctx);
@@ -107,7 +284,9 @@ RETRY:;
                 ch = lex_next(lexctx);
                 string_append_char(s, ch);
             } else {
-                string_append_char(s, ch);
+                const char *start = lex_pos(lexctx);
+                lexctx->p = lex_scan_string(lexctx->p, lexctx->end);
+                string_append_len(s, start, lexctx->p - start);
             }
             ch = lex_next(lexctx);
         }
@@ -123,7 +302,8 @@ RETRY:;
         }
         if (ch == '/') {    // line comment.
             ch = lex_next(lexctx);
-            while (ch != '\n' && ch != EOF) {
+            if (ch != '\n' && ch != EOF) {
+                lexctx->p = lex_scan_newline(lexctx->p, lexctx->end);
                 ch = lex_next(lexctx);
             }
             ch = lex_next(lexctx);
@@ -133,6 +313,10 @@ RETRY:;
             int nested = 1;
             ch = lex_next(lexctx);
             while (ch != EOF) {
+                if (ch != '*' && ch != '/') {
+                    lexctx->p = lex_scan_comment(lexctx->p, lexctx->end);
+                    ch = lex_next(lexctx);
+                }
                 int c = ch;
                 ch = lex_next(lexctx);
                 if (c == '/' && ch == '*') {
@@ -205,15 +389,19 @@ RETRY:;
     }
 
     if (lex_is_name1(ch)) {
-        string_t *s = string_clear(parsectx->s);
-        string_append_char(s, ch);
+        const char *start = lex_pos(lexctx);
+        unsigned hash = STRING_SET_HASH_STEP(STRING_SET_HASH_INIT, ch);
         ch = lex_next(lexctx);
         while (lex_is_name2(ch)) {
-            string_append_char(s, ch);
+            hash = STRING_SET_HASH_STEP(hash, ch);
             ch = lex_next(lexctx);
         }
-        yylval->sv = string_set_insert(parsectx->string_mgr, s);
-        return get_token_of_keyword(s);
+        int len = lex_pos(lexctx) - start;
+        int token = get_token_of_keyword(start, len, hash);
+        if (token == NAME) {
+            yylval->sv = string_set_insert_hash(parsectx->string_mgr, start, len, hash);
+        }
+        return token;
     }
 
     if (isgraph(ch)) {
@@ -223,3 +411,30 @@ RETRY:;
 
     return ERROR;
 }
+
+int yylex(YYSTYPE *yylval, kiss_parsectx_t *parsectx)
+{
+    if (!parsectx->tokens) {
+        return lex_read_token(yylval, parsectx);
+    }
+
+    const kiss_token_t *t = token_stream_next(parsectx->tokens);
+    if (!t) {
+        return EOF;
+    }
+    switch (t->kind) {
+    case INT_VALUE:
+        yylval->iv = t->value.iv;
+        break;
+    case DBL_VALUE:
+        yylval->dv = t->value.dv;
+        break;
+    case STR_VALUE:
+    case NAME:
+        yylval->sv = t->value.sv;
+        break;
+    default:
+        ;
+    }
+    return t->kind;
+}
@@ -11,10 +11,27 @@
 #include "ast/node.h"
 #include "xstring.h"
 #include "xstring_set.h"
+#include "tokens.h"
+
+#define LEX_READ_UNIT (64 * 1024)
+
+enum lex_source_mode {
+    LEX_SOURCE_NONE,
+    LEX_SOURCE_MMAP,                // a regular file mapped into memory.
+    LEX_SOURCE_BUFFER,              // a whole stream read into an owned buffer.
+    LEX_SOURCE_MEMORY,              // a caller's memory, not owned.
+};
 
 typedef struct kiss_lexctx_t_ {
     int ch;
-    FILE *fp;
+    const char *p;                  // current read position.
+    const char *end;                // end of source.
+    const char *token;              // start of the last token.
+
+    enum lex_source_mode mode;
+    const char *buf;                // start of the source.
+    size_t len;                     // length of the source.
+    void *maph;                     // mapping handle, only for Windows.
 } kiss_lexctx_t;
 
 typedef struct kiss_parsectx_t_ {
@@ -22,6 +39,14 @@ typedef struct kiss_parsectx_t_ {
     node_manager_t *node_mgr;
     string_set_t *string_mgr;
     string_t *s;
+    kiss_token_stream_t *tokens;    // replayed by yylex() if available.
+    int lazy;                       // skip function bodies, see kiss_parse_function_body().
 } kiss_parsectx_t;
 
+extern int lex_open_file(kiss_lexctx_t *lexctx, const char *filename);
+extern int lex_open_buffer(kiss_lexctx_t *lexctx, const char *src, size_t len);
+extern void lex_close(kiss_lexctx_t *lexctx);
+extern size_t lex_tell(kiss_lexctx_t *lexctx);
+extern void lex_seek(kiss_lexctx_t *lexctx, size_t offset);
+
 #endif /* KISS_LEXER_H */
@@ -0,0 +1,152 @@
+#include <stddef.h>
+#include "lexscan.h"
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#define LEX_SCAN_X64
+#define LEX_SCAN_TARGET_AVX2
+#include <intrin.h>
+#include <immintrin.h>
+static int lex_scan_ctz(unsigned m)
+{
+    unsigned long i;
+    _BitScanForward(&i, m);
+    return (int)i;
+}
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define LEX_SCAN_X64
+#define LEX_SCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#define lex_scan_ctz(m) __builtin_ctz(m)
+#endif
+
+/*
+    A kernel finds the first character which is (or is not, when negate is 1) one of set[0..3].
+*/
+typedef const char *(*lex_scan_kernel_t)(const char *p, const char *end, const char *set, int negate);
+
+static int lex_scan_in_set(char c, const char *set)
+{
+    return c == set[0] || c == set[1] || c == set[2] || c == set[3];
+}
+
+static const char *lex_scan_scalar(const char *p, const char *end, const char *set, int negate)
+{
+    while (p < end && lex_scan_in_set(*p, set) == negate) {
+        ++p;
+    }
+    return p;
+}
+
+#if defined(LEX_SCAN_X64)
+static const char *lex_scan_sse2(const char *p, const char *end, const char *set, int negate)
+{
+    __m128i s0 = _mm_set1_epi8(set[0]);
+    __m128i s1 = _mm_set1_epi8(set[1]);
+    __m128i s2 = _mm_set1_epi8(set[2]);
+    __m128i s3 = _mm_set1_epi8(set[3]);
+    unsigned flip = negate ? 0xFFFF : 0;
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i eq = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(v, s0), _mm_cmpeq_epi8(v, s1)),
+            _mm_or_si128(_mm_cmpeq_epi8(v, s2), _mm_cmpeq_epi8(v, s3)));
+        unsigned m = ((unsigned)_mm_movemask_epi8(eq)) ^ flip;
+        if (m) {
+            return p + lex_scan_ctz(m);
+        }
+        p += 16;
+    }
+    return lex_scan_scalar(p, end, set, negate);
+}
+
+LEX_SCAN_TARGET_AVX2
+static const char *lex_scan_avx2(const char *p, const char *end, const char *set, int negate)
+{
+    __m256i s0 = _mm256_set1_epi8(set[0]);
+    __m256i s1 = _mm256_set1_epi8(set[1]);
+    __m256i s2 = _mm256_set1_epi8(set[2]);
+    __m256i s3 = _mm256_set1_epi8(set[3]);
+    unsigned flip = negate ? 0xFFFFFFFF : 0;
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i eq = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, s0), _mm256_cmpeq_epi8(v, s1)),
+            _mm256_or_si256(_mm256_cmpeq_epi8(v, s2), _mm256_cmpeq_epi8(v, s3)));
+        unsigned m = ((unsigned)_mm256_movemask_epi8(eq)) ^ flip;
+        if (m) {
+            return p + lex_scan_ctz(m);
+        }
+        p += 32;
+    }
+    return lex_scan_sse2(p, end, set, negate);
+}
+
+static int lex_scan_has_avx2(void)
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return 0;
+    }
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) {
+        return 0;   /* no OSXSAVE or no AVX. */
+    }
+    if ((_xgetbv(0) & 0x6) != 0x6) {
+        return 0;   /* YMM state is not enabled by OS. */
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+static lex_scan_kernel_t lex_scan_kernel = NULL;
+
+void lex_scan_init(void)
+{
+    if (lex_scan_kernel) {
+        return;
+    }
+#if defined(LEX_SCAN_X64)
+    lex_scan_kernel = lex_scan_has_avx2() ? lex_scan_avx2 : lex_scan_sse2;
+#else
+    lex_scan_kernel = lex_scan_scalar;
+#endif
+}
+
+/*
+    Runs are often very short like a single space between tokens,
+    so the first character is checked before entering a kernel.
+*/
+static const char *lex_scan(const char *p, const char *end, const char *set, int negate)
+{
+    if (p >= end || lex_scan_in_set(*p, set) != negate) {
+        return p;
+    }
+    return lex_scan_kernel(p + 1, end, set, negate);
+}
+
+const char *lex_scan_space(const char *p, const char *end)
+{
+    return lex_scan(p, end, " \t\n\r", 1);
+}
+
+const char *lex_scan_newline(const char *p, const char *end)
+{
+    return lex_scan(p, end, "\n\n\n\n", 0);
+}
+
+const char *lex_scan_comment(const char *p, const char *end)
+{
+    return lex_scan(p, end, "*/**", 0);
+}
+
+const char *lex_scan_string(const char *p, const char *end)
+{
+    return lex_scan(p, end, "\"\\%%", 0);
+}
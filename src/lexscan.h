@@ -0,0 +1,16 @@
+#ifndef KISS_LEXSCAN_H
+#define KISS_LEXSCAN_H
+
+/*
+    Fast scanners for long runs of characters which the lexer just skips or copies.
+    Each function returns the position of the first character which stops the run, or end.
+    SSE2/AVX2 kernels are used when the cpu supports them, and a scalar one is used otherwise.
+*/
+
+extern void lex_scan_init(void);
+extern const char *lex_scan_space(const char *p, const char *end);
+extern const char *lex_scan_newline(const char *p, const char *end);
+extern const char *lex_scan_comment(const char *p, const char *end);
+extern const char *lex_scan_string(const char *p, const char *end);
+
+#endif /* KISS_LEXSCAN_H */
@@ -5,17 +5,73 @@ int main(int ac, char **av)
     #if YYDEBUG == 1
     // yydebug = 1;
     #endif
-    if (ac != 2) {
+    kiss_context_t *ctx = new_context();
+    const char *filename = NULL;
+    for (int i = 1; i < ac; ++i) {
+        if (!strcmp(av[i], "--pretokenize")) {
+            ctx->pretokenize = 1;
+        } else if (!strcmp(av[i], "--hand-parser")) {
+            ctx->hand_parser = 1;
+        } else if (!strcmp(av[i], "--dump")) {
+            ctx->dump = 1;
+        } else if (!strcmp(av[i], "--stats")) {
+            ctx->stats = 1;
+        } else if (!strcmp(av[i], "--fold")) {
+            ctx->fold = 1;
+        } else if (!strcmp(av[i], "--dce")) {
+            ctx->dce = 1;
+        } else if (!strcmp(av[i], "--ir")) {
+            ctx->ir = 1;
+        } else if (!strcmp(av[i], "--dump-ir")) {
+            ctx->dump_ir = 1;
+        } else if (!strcmp(av[i], "--sccp")) {
+            ctx->sccp = 1;
+        } else if (!strcmp(av[i], "--tail-calls")) {
+            ctx->tail_calls = 1;
+        } else if (!strcmp(av[i], "--inline")) {
+            ctx->inlining = 1;
+        } else if (!strcmp(av[i], "--inline-threshold") && i + 1 < ac) {
+            ctx->inlining = 1;
+            ctx->inline_threshold = atoi(av[++i]);
+        } else if (!strcmp(av[i], "--eval-calls")) {
+            ctx->eval_calls = 1;
+        } else if (!strcmp(av[i], "--eval-steps") && i + 1 < ac) {
+            ctx->eval_calls = 1;
+            ctx->eval_steps = atoi(av[++i]);
+        } else if (!strcmp(av[i], "--eval-depth") && i + 1 < ac) {
+            ctx->eval_calls = 1;
+            ctx->eval_depth = atoi(av[++i]);
+        } else if (!strcmp(av[i], "--specialize")) {
+            ctx->specialize = 1;
+        } else if (!strcmp(av[i], "--specialize-budget") && i + 1 < ac) {
+            ctx->specialize = 1;
+            ctx->spec_budget = atoi(av[++i]);
+        } else if (!strcmp(av[i], "--memoize")) {
+            ctx->memoize = 1;
+        } else if (!strcmp(av[i], "--loops")) {
+            ctx->loops = 1;
+        } else if (!strcmp(av[i], "--lazy")) {
+            ctx->lazy = 1;
+        } else if (!strcmp(av[i], "--export") && i + 1 < ac) {
+            if (!ctx->exports) {
+                ctx->exports = vector_new();
+            }
+            ++i;
+            vector_push(ctx->exports, string_set_insert_len(&(ctx->smgr), av[i], (int)strlen(av[i])), NULL);
+        } else if (!filename) {
+            filename = av[i];
+        }
+    }
+    if (!filename) {
+        ctx->free(ctx);
         return 1;
     }
 
-    kiss_context_t *ctx = new_context();
-    int r = ctx->parse(ctx, av[1]);
+    int r = ctx->parse(ctx, filename);
     if (r == 0) {
-        ctx->type_ast(ctx);
-        // ctx->dump_ast(ctx);
-        ctx->output(ctx);
-    } else {
+        r = ctx->compile(ctx);
+    }
+    if (r != 0) {
         printf("failed: %d\n", r);
     }
 
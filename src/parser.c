@@ -0,0 +1,444 @@
+#include <setjmp.h>
+#include "parser.h"
+#include "kiss.tab.h"
+
+extern int yylex(YYSTYPE *yylval, kiss_parsectx_t *parsectx);
+extern int yyerror(const char *format, ...);
+
+/*
+    Recursive descent for statements and precedence climbing for binary operators.
+    A chain of single-child rules like expression -> assign_expression -> ... -> factor
+    in kiss.y is not reduced one by one, an operand is parsed directly as a postfix expression.
+*/
+enum parser_precedence {
+    PREC_NONE,
+    PREC_ASSIGN,            // assign_expression, built by ast_binary_right().
+    PREC_COMPARE,           // compare_expression
+    PREC_ADD_SUB,           // add_sub_expression
+    PREC_MUL_DIV_MOD,       // mul_div_mod_expression
+};
+
+typedef struct kiss_parser_ {
+    kiss_parsectx_t *parsectx;
+    node_manager_t *mgr;
+    int tok;                // lookahead token.
+    YYSTYPE val;            // value of the lookahead token.
+    int depth;
+    jmp_buf error;
+} kiss_parser_t;
+
+static node_t *parse_statement(kiss_parser_t *p);
+static node_t *parse_expression(kiss_parser_t *p);
+
+static void parser_error(kiss_parser_t *p, const char *message)
+{
+    yyerror(message);
+    longjmp(p->error, 1);
+}
+
+static void parser_next(kiss_parser_t *p)
+{
+    p->tok = yylex(&(p->val), p->parsectx);
+}
+
+static int parser_accept(kiss_parser_t *p, int tok)
+{
+    if (p->tok != tok) {
+        return 0;
+    }
+    parser_next(p);
+    return 1;
+}
+
+static void parser_expect(kiss_parser_t *p, int tok)
+{
+    if (!parser_accept(p, tok)) {
+        parser_error(p, "syntax error");
+    }
+}
+
+static string_t *parser_expect_name(kiss_parser_t *p)
+{
+    if (p->tok != NAME) {
+        parser_error(p, "syntax error");
+    }
+    string_t *name = p->val.sv;
+    parser_next(p);
+    return name;
+}
+
+/* The position of the lookahead token, a token index if pre-tokenized or a source offset. */
+static size_t parser_tell(kiss_parser_t *p)
+{
+    if (p->parsectx->tokens) {
+        return (size_t)token_stream_tell(p->parsectx->tokens) - 1;
+    }
+    return lex_tell(&(p->parsectx->lexctx));
+}
+
+static void parser_seek(kiss_parser_t *p, size_t pos)
+{
+    if (p->parsectx->tokens) {
+        token_stream_seek(p->parsectx->tokens, (int)pos);
+    } else {
+        lex_seek(&(p->parsectx->lexctx), pos);
+    }
+    parser_next(p);
+}
+
+static void parser_enter(kiss_parser_t *p)
+{
+    if (++p->depth > KISS_PARSER_MAX_DEPTH) {
+        parser_error(p, "parser stack overflow");
+    }
+}
+
+static int binary_precedence(int tok)
+{
+    switch (tok) {
+    case '=': case ADDEQ: case SUBEQ: case MULEQ: case DIVEQ: case MODEQ:
+        return PREC_ASSIGN;
+    case EQEQ: case NEQ: case '<': case LEQ: case '>': case GEQ:
+        return PREC_COMPARE;
+    case '+': case '-':
+        return PREC_ADD_SUB;
+    case '*': case '/': case '%':
+        return PREC_MUL_DIV_MOD;
+    default:
+        ;
+    }
+    return PREC_NONE;
+}
+
+/* expression. */
+
+static node_t *parse_call_argument_list(kiss_parser_t *p)
+{
+    node_t *args = parse_expression(p);
+    while (parser_accept(p, ',')) {
+        args = node_connect(args, parse_expression(p));
+    }
+    return args;
+}
+
+static node_t *parse_factor(kiss_parser_t *p)
+{
+    node_t *n = NULL;
+    switch (p->tok) {
+    case NAME:
+        n = ast_variable(p->mgr, p->val.sv);
+        break;
+    case INT_VALUE:
+        n = ast_value_int(p->mgr, p->val.iv);
+        break;
+    case DBL_VALUE:
+        n = ast_value_dbl(p->mgr, p->val.dv);
+        break;
+    case STR_VALUE:
+        n = ast_value_str(p->mgr, p->val.sv);
+        break;
+    case '(':
+        parser_next(p);
+        n = parse_expression(p);
+        parser_expect(p, ')');
+        return n;
+    default:
+        parser_error(p, "syntax error");
+    }
+    parser_next(p);
+    return n;
+}
+
+static node_t *parse_postfix_expression(kiss_parser_t *p)
+{
+    node_t *n;
+    parser_enter(p);
+    if (p->tok == _PRINTF) {
+        parser_next(p);
+        if (p->tok != '(') {
+            parser_error(p, "syntax error");
+        }
+        n = ast_builtin_function(p->mgr, "printf");
+    } else {
+        n = parse_factor(p);
+    }
+    while (parser_accept(p, '(')) {
+        node_t *args = parse_call_argument_list(p);
+        parser_expect(p, ')');
+        n = ast_call(p->mgr, n, args);
+    }
+    --p->depth;
+    return n;
+}
+
+static node_t *parse_binary_expression(kiss_parser_t *p, int min)
+{
+    node_t *lhs = parse_postfix_expression(p);
+    int prec;
+    while ((prec = binary_precedence(p->tok)) >= min && prec != PREC_NONE) {
+        int op = p->tok;
+        parser_next(p);
+        node_t *rhs = parse_binary_expression(p, prec + 1);
+        if (prec == PREC_ASSIGN) {
+            lhs = ast_binary_right(p->mgr, op, lhs, rhs);
+        } else {
+            lhs = ast_binary(p->mgr, op, lhs, rhs);
+        }
+    }
+    return lhs;
+}
+
+static node_t *parse_expression(kiss_parser_t *p)
+{
+    return parse_binary_expression(p, PREC_ASSIGN);
+}
+
+/* declaration. */
+
+static int parse_type_info_Opt(kiss_parser_t *p)
+{
+    if (!parser_accept(p, ':')) {
+        return VALTYPE_INT;
+    }
+    switch (p->tok) {
+    case INT_TYPE:
+        parser_next(p);
+        return VALTYPE_INT;
+    case DBL_TYPE:
+        parser_next(p);
+        return VALTYPE_DBL;
+    default:
+        parser_error(p, "syntax error");
+    }
+    return VALTYPE_UNKNOWN;
+}
+
+static node_t *parse_declaration_expression(kiss_parser_t *p)
+{
+    string_t *name = parser_expect_name(p);
+    int type = parse_type_info_Opt(p);
+    node_t *initializer = NULL;
+    if (parser_accept(p, '=')) {
+        initializer = parse_expression(p);
+    }
+    return ast_decl_expression(p->mgr, name, type, initializer);
+}
+
+static node_t *parse_var_declaration(kiss_parser_t *p)
+{
+    parser_expect(p, VAR);
+    node_t *list = parse_declaration_expression(p);
+    while (parser_accept(p, ',')) {
+        list = node_connect(list, parse_declaration_expression(p));
+    }
+    return list;
+}
+
+static node_t *parse_argument_list(kiss_parser_t *p)
+{
+    node_t *list = NULL;
+    do {
+        string_t *name = parser_expect_name(p);
+        int type = parse_type_info_Opt(p);
+        node_t *arg = ast_decl_expression(p->mgr, name, type, NULL);
+        list = list ? node_connect(list, arg) : arg;
+    } while (parser_accept(p, ','));
+    return list;
+}
+
+/* statement. */
+
+static node_t *parse_statement_list(kiss_parser_t *p)
+{
+    node_t *list = parse_statement(p);
+    while (p->tok > 0 && p->tok != '}') {
+        list = node_connect(list, parse_statement(p));
+    }
+    return list;
+}
+
+static node_t *parse_block(kiss_parser_t *p)
+{
+    parser_expect(p, '{');
+    node_t *list = parse_statement_list(p);
+    parser_expect(p, '}');
+    return ast_block_statement(p->mgr, list);
+}
+
+static node_t *parse_paren_expression(kiss_parser_t *p)
+{
+    parser_expect(p, '(');
+    node_t *expr = parse_expression(p);
+    parser_expect(p, ')');
+    return expr;
+}
+
+static node_t *parse_if_statement(kiss_parser_t *p)
+{
+    parser_expect(p, IF);
+    node_t *expr = parse_paren_expression(p);
+    node_t *then_clause = parse_statement(p);
+    node_t *else_clause = NULL;
+    if (parser_accept(p, ELSE)) {
+        else_clause = parse_statement(p);
+    }
+    return ast_branch_statement(p->mgr, expr, then_clause, else_clause);
+}
+
+static node_t *parse_for_statement(kiss_parser_t *p)
+{
+    node_t *e1 = NULL, *e2 = NULL, *e3 = NULL;
+    parser_expect(p, FOR);
+    parser_expect(p, '(');
+    if (p->tok == VAR) {
+        e1 = parse_var_declaration(p);
+    } else if (p->tok != ';') {
+        e1 = parse_expression(p);
+    }
+    parser_expect(p, ';');
+    if (p->tok != ';') {
+        e2 = parse_expression(p);
+    }
+    parser_expect(p, ';');
+    if (p->tok != ')') {
+        e3 = parse_expression(p);
+    }
+    parser_expect(p, ')');
+    node_t *then_clause = parse_statement(p);
+    return ast_for_loop_statement(p->mgr, e1, e2, e3, then_clause);
+}
+
+static node_t *parse_while_statement(kiss_parser_t *p)
+{
+    parser_expect(p, WHILE);
+    node_t *expr = parse_paren_expression(p);
+    node_t *then_clause = parse_statement(p);
+    return ast_precond_loop_statement(p->mgr, expr, then_clause);
+}
+
+static node_t *parse_do_while_statement(kiss_parser_t *p)
+{
+    parser_expect(p, DO);
+    node_t *then_clause = parse_statement(p);
+    parser_expect(p, WHILE);
+    node_t *expr = parse_paren_expression(p);
+    parser_expect(p, ';');
+    return ast_postcond_loop_statement(p->mgr, expr, then_clause);
+}
+
+static node_t *parse_return_statement(kiss_parser_t *p)
+{
+    parser_expect(p, RETURN);
+    node_t *expr = parse_expression(p);
+    node_t *if_modifier = NULL;
+    if (parser_accept(p, IF)) {
+        if_modifier = parse_paren_expression(p);
+    }
+    parser_expect(p, ';');
+    return ast_return_statement(p->mgr, expr, if_modifier);
+}
+
+/* Tokens are still read to find the end of a skipped body, since a brace can be in a string. */
+static void parser_skip_block(kiss_parser_t *p)
+{
+    int depth = 0;
+    do {
+        if (p->tok == '{') {
+            ++depth;
+        } else if (p->tok == '}') {
+            --depth;
+        } else if (p->tok <= 0 || p->tok == ERROR) {
+            parser_error(p, "syntax error");
+        }
+        parser_next(p);
+    } while (depth > 0);
+}
+
+static node_t *parse_function_definition(kiss_parser_t *p)
+{
+    parser_expect(p, FUNCTION);
+    int rtype = parse_type_info_Opt(p);
+    string_t *name = parser_expect_name(p);
+    parser_expect(p, '(');
+    node_t *args = parse_argument_list(p);
+    parser_expect(p, ')');
+    if (p->parsectx->lazy) {
+        if (p->tok != '{') {
+            parser_error(p, "syntax error");
+        }
+        size_t body = parser_tell(p);
+        parser_skip_block(p);
+        return ast_lazy_function_statement(p->mgr, rtype, name, args, body);
+    }
+    node_t *block = parse_block(p);
+    return ast_function_statement(p->mgr, rtype, name, args, block);
+}
+
+static node_t *parse_statement(kiss_parser_t *p)
+{
+    node_t *n;
+    parser_enter(p);
+    switch (p->tok) {
+    case VAR:
+        n = ast_expr_statement(p->mgr, parse_var_declaration(p));
+        parser_expect(p, ';');
+        break;
+    case IF:
+        n = parse_if_statement(p);
+        break;
+    case FOR:
+        n = parse_for_statement(p);
+        break;
+    case WHILE:
+        n = parse_while_statement(p);
+        break;
+    case DO:
+        n = parse_do_while_statement(p);
+        break;
+    case RETURN:
+        n = parse_return_statement(p);
+        break;
+    case FUNCTION:
+        n = parse_function_definition(p);
+        break;
+    case '{':
+        n = parse_block(p);
+        break;
+    default:
+        n = ast_expr_statement(p->mgr, parse_expression(p));
+        parser_expect(p, ';');
+        break;
+    }
+    --p->depth;
+    return n;
+}
+
+int kiss_parse(kiss_parsectx_t *parsectx)
+{
+    kiss_parser_t p = { .parsectx = parsectx, .mgr = parsectx->node_mgr };
+    if (setjmp(p.error)) {
+        return 1;
+    }
+
+    parser_next(&p);
+    node_t *list = parse_statement_list(&p);
+    if (p.tok > 0) {
+        parser_error(&p, "syntax error");
+    }
+    ast_set_root(p.mgr, list);
+    return 0;
+}
+
+/* Parses a body skipped by the lazy mode, functions inside it are skipped again. */
+int kiss_parse_function_body(kiss_parsectx_t *parsectx, node_t *func)
+{
+    kiss_parser_t p = { .parsectx = parsectx, .mgr = parsectx->node_mgr };
+    if (setjmp(p.error)) {
+        return 1;
+    }
+
+    parser_seek(&p, func->n.s.func.body);
+    func->n.s.func.block = parse_block(&p);
+    func->n.s.func.state = FUNC_BODY_PARSED;
+    return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef KISS_PARSER_H
+#define KISS_PARSER_H
+
+#include "lexer.h"
+
+/*
+    Hand-written predictive parser, an alternative of yyparse() generated from kiss.y.
+    It builds the same AST through the same constructors and also reads tokens by yylex().
+*/
+#define KISS_PARSER_MAX_DEPTH (1024)
+
+extern int kiss_parse(kiss_parsectx_t *parsectx);
+extern int kiss_parse_function_body(kiss_parsectx_t *parsectx, node_t *func);
+
+#endif /* KISS_PARSER_H */
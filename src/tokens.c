@@ -0,0 +1,253 @@
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#undef ERROR    /* conflicts with the token name. */
+#else
+#include <pthread.h>
+#endif
+#include "lexer.h"
+#include "tokens.h"
+#include "kiss.tab.h"
+
+extern int lex_read_token(YYSTYPE *yylval, kiss_parsectx_t *parsectx);
+
+/*
+    Synchronization between a lexer thread and the parser.
+*/
+typedef struct token_thread_ {
+    kiss_token_stream_t *ts;
+    kiss_parsectx_t *parsectx;
+#if defined(_WIN32) || defined(_WIN64)
+    HANDLE handle;
+    CRITICAL_SECTION lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_t handle;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+} token_thread_t;
+
+#if defined(_WIN32) || defined(_WIN64)
+#define token_lock(th) EnterCriticalSection(&((th)->lock))
+#define token_unlock(th) LeaveCriticalSection(&((th)->lock))
+#define token_wait(th) SleepConditionVariableCS(&((th)->cond), &((th)->lock), INFINITE)
+#define token_signal(th) WakeConditionVariable(&((th)->cond))
+#else
+#define token_lock(th) pthread_mutex_lock(&((th)->lock))
+#define token_unlock(th) pthread_mutex_unlock(&((th)->lock))
+#define token_wait(th) pthread_cond_wait(&((th)->cond), &((th)->lock))
+#define token_signal(th) pthread_cond_signal(&((th)->cond))
+#endif
+
+kiss_token_stream_t *token_stream_new(void)
+{
+    return (kiss_token_stream_t *)calloc(1, sizeof(kiss_token_stream_t));
+}
+
+void token_stream_free(kiss_token_stream_t *ts)
+{
+    token_stream_join(ts);
+    kiss_token_chunk_t *c = ts->head;
+    while (c) {
+        kiss_token_chunk_t *next = c->next;
+        free(c);
+        c = next;
+    }
+    free(ts);
+}
+
+static kiss_token_t *token_stream_append(kiss_token_stream_t *ts)
+{
+    kiss_token_chunk_t *c = ts->tail;
+    if (!c || c->count == KISS_TOKEN_CHUNK) {
+        kiss_token_chunk_t *nc = (kiss_token_chunk_t *)malloc(sizeof(kiss_token_chunk_t));
+        nc->next = NULL;
+        nc->count = 0;
+        if (c) {
+            c->next = nc;
+        } else {
+            ts->head = nc;
+        }
+        ts->tail = c = nc;
+    }
+    ++ts->count;
+    return &(c->token[c->count++]);
+}
+
+static void token_publish(token_thread_t *th, int done)
+{
+    token_lock(th);
+    th->ts->published = th->ts->count;
+    th->ts->done = done;
+    token_signal(th);
+    token_unlock(th);
+}
+
+static void token_stream_lex_all(kiss_token_stream_t *ts, kiss_parsectx_t *parsectx, token_thread_t *th)
+{
+    kiss_lexctx_t *lexctx = &(parsectx->lexctx);
+    YYSTYPE yylval;
+    int kind;
+    do {
+        kind = lex_read_token(&yylval, parsectx);
+        kiss_token_t *t = token_stream_append(ts);
+        t->kind = kind;
+        t->offset = (uint32_t)(lexctx->token - lexctx->buf);
+        switch (kind) {
+        case INT_VALUE:
+            t->value.iv = yylval.iv;
+            break;
+        case DBL_VALUE:
+            t->value.dv = yylval.dv;
+            break;
+        case STR_VALUE:
+        case NAME:
+            t->value.sv = yylval.sv;
+            break;
+        default:
+            t->value.iv = 0;
+            break;
+        }
+        if (th && (ts->count % KISS_TOKEN_PUBLISH) == 0) {
+            token_publish(th, 0);
+        }
+        /* the lexer does not proceed at an error, the parser will stop there. */
+    } while (kind != EOF && kind != ERROR);
+    if (th) {
+        token_publish(th, 1);
+    }
+}
+
+void token_stream_lex(kiss_token_stream_t *ts, kiss_parsectx_t *parsectx)
+{
+    token_stream_lex_all(ts, parsectx, NULL);
+    ts->done = 1;
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+static DWORD WINAPI token_thread_main(LPVOID arg)
+#else
+static void *token_thread_main(void *arg)
+#endif
+{
+    token_thread_t *th = (token_thread_t *)arg;
+    token_stream_lex_all(th->ts, th->parsectx, th);
+    return 0;
+}
+
+int token_stream_lex_async(kiss_token_stream_t *ts, kiss_parsectx_t *parsectx)
+{
+    token_thread_t *th = (token_thread_t *)calloc(1, sizeof(token_thread_t));
+    th->ts = ts;
+    th->parsectx = parsectx;
+#if defined(_WIN32) || defined(_WIN64)
+    InitializeCriticalSection(&(th->lock));
+    InitializeConditionVariable(&(th->cond));
+    th->handle = CreateThread(NULL, 0, token_thread_main, th, 0, NULL);
+    if (!th->handle) {
+        DeleteCriticalSection(&(th->lock));
+        free(th);
+        return 0;
+    }
+#else
+    pthread_mutex_init(&(th->lock), NULL);
+    pthread_cond_init(&(th->cond), NULL);
+    if (pthread_create(&(th->handle), NULL, token_thread_main, th) != 0) {
+        pthread_cond_destroy(&(th->cond));
+        pthread_mutex_destroy(&(th->lock));
+        free(th);
+        return 0;
+    }
+#endif
+    ts->thread = th;
+    return 1;
+}
+
+void token_stream_join(kiss_token_stream_t *ts)
+{
+    token_thread_t *th = (token_thread_t *)ts->thread;
+    if (!th) {
+        return;
+    }
+#if defined(_WIN32) || defined(_WIN64)
+    WaitForSingleObject(th->handle, INFINITE);
+    CloseHandle(th->handle);
+    DeleteCriticalSection(&(th->lock));
+#else
+    pthread_join(th->handle, NULL);
+    pthread_cond_destroy(&(th->cond));
+    pthread_mutex_destroy(&(th->lock));
+#endif
+    free(th);
+    ts->thread = NULL;
+    ts->published = ts->count;
+}
+
+void token_stream_rewind(kiss_token_stream_t *ts)
+{
+    ts->rchunk = NULL;
+    ts->rindex = 0;
+    ts->ravail = 0;
+}
+
+static int token_stream_refresh(kiss_token_stream_t *ts)
+{
+    token_thread_t *th = (token_thread_t *)ts->thread;
+    if (!th) {
+        ts->ravail = ts->count;
+        return ts->rindex < ts->ravail;
+    }
+    token_lock(th);
+    while (ts->published == ts->ravail && !ts->done) {
+        token_wait(th);
+    }
+    ts->ravail = ts->published;
+    token_unlock(th);
+    return ts->rindex < ts->ravail;
+}
+
+const kiss_token_t *token_stream_next(kiss_token_stream_t *ts)
+{
+    if (ts->rindex >= ts->ravail && !token_stream_refresh(ts)) {
+        return NULL;
+    }
+    int i = ts->rindex % KISS_TOKEN_CHUNK;
+    if (i == 0) {
+        ts->rchunk = ts->rchunk ? ts->rchunk->next : ts->head;
+    }
+    ++ts->rindex;
+    return &(ts->rchunk->token[i]);
+}
+
+/* The index of the token which will be returned next. */
+int token_stream_tell(kiss_token_stream_t *ts)
+{
+    return ts->rindex;
+}
+
+/* Moves the reader position, this must be used after lexing has been completed. */
+void token_stream_seek(kiss_token_stream_t *ts, int index)
+{
+    kiss_token_chunk_t *c = NULL;
+    if (index > 0) {
+        c = ts->head;
+        for (int i = (index - 1) / KISS_TOKEN_CHUNK; i > 0; --i) {
+            c = c->next;
+        }
+    }
+    ts->rchunk = c;
+    ts->rindex = index;
+}
+
+/* Random access for tools, this must be used after lexing has been completed. */
+const kiss_token_t *token_stream_get(kiss_token_stream_t *ts, int index)
+{
+    if (index < 0 || ts->count <= index) {
+        return NULL;
+    }
+    kiss_token_chunk_t *c = ts->head;
+    for (int i = index / KISS_TOKEN_CHUNK; i > 0; --i) {
+        c = c->next;
+    }
+    return &(c->token[index % KISS_TOKEN_CHUNK]);
+}
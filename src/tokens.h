@@ -0,0 +1,61 @@
+#ifndef KISS_TOKENS_H
+#define KISS_TOKENS_H
+
+#include <stdint.h>
+#include "xstring.h"
+
+/*
+    Pre-tokenized stream, the whole input is lexed into arrays of compact tokens
+    and the parser replays them through yylex(). Tokens are stored in chunks so that
+    a lexer thread can keep appending while the parser is reading.
+*/
+#define KISS_TOKEN_CHUNK (4096)
+#define KISS_TOKEN_PUBLISH (256)            // tokens published to a reader at once.
+#define KISS_TOKEN_THREAD_MIN (1024 * 1024) // source size to lex on another thread.
+
+struct kiss_parsectx_t_;
+
+typedef struct kiss_token_ {
+    int kind;
+    uint32_t offset;                        // offset in the source.
+    union {
+        int64_t iv;                         // INT_VALUE
+        double dv;                          // DBL_VALUE
+        string_t *sv;                       // STR_VALUE, NAME, interned.
+    } value;
+} kiss_token_t;
+
+typedef struct kiss_token_chunk_ {
+    struct kiss_token_chunk_ *next;
+    int count;
+    kiss_token_t token[KISS_TOKEN_CHUNK];
+} kiss_token_chunk_t;
+
+typedef struct kiss_token_stream_ {
+    kiss_token_chunk_t *head;
+    kiss_token_chunk_t *tail;
+    int count;                              // total number of tokens.
+
+    /* reader position. */
+    kiss_token_chunk_t *rchunk;
+    int rindex;
+    int ravail;                             // tokens available in total without a lock.
+
+    /* used only when lexing on another thread. */
+    void *thread;
+    int published;
+    int done;
+} kiss_token_stream_t;
+
+extern kiss_token_stream_t *token_stream_new(void);
+extern void token_stream_free(kiss_token_stream_t *ts);
+extern void token_stream_lex(kiss_token_stream_t *ts, struct kiss_parsectx_t_ *parsectx);
+extern int token_stream_lex_async(kiss_token_stream_t *ts, struct kiss_parsectx_t_ *parsectx);
+extern void token_stream_join(kiss_token_stream_t *ts);
+extern void token_stream_rewind(kiss_token_stream_t *ts);
+extern const kiss_token_t *token_stream_next(kiss_token_stream_t *ts);
+extern const kiss_token_t *token_stream_get(kiss_token_stream_t *ts, int index);
+extern int token_stream_tell(kiss_token_stream_t *ts);
+extern void token_stream_seek(kiss_token_stream_t *ts, int index);
+
+#endif /* KISS_TOKENS_H */
@@ -0,0 +1,107 @@
+#!/bin/sh
+#
+# Regression check of the SSA IR passes, usage: test/check.sh [count] [first seed]
+#
+# Each sample in test/samples is compiled with --ir and with each set of pass flags below,
+# and the output of the program must be the same as the .out file next to it.
+# Then count random programs by test/gen.py are compared in the same way with the output
+# by --ir. A failing program is kept in the work directory, which is printed at the end.
+#
+# KISS is the compiler (./kiss by default), CC and CFLAGS compile the generated C.
+KISS=${KISS:-./kiss}
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--w -include stdio.h}
+count=${1:-100}
+seed=${2:-1}
+dir=$(dirname "$0")
+work=$(mktemp -d)
+
+FLAGS="--lazy --ir
+--dce --ir
+--fold --ir
+--sccp
+--inline
+--inline --sccp
+--tail-calls
+--memoize
+--eval-calls
+--specialize
+--loops
+--loops --sccp
+--dce --inline --tail-calls --memoize --eval-calls --specialize --loops --sccp
+--hand-parser --lazy --dce --ir
+--pretokenize --ir"
+
+if command -v timeout >/dev/null 2>&1; then
+    TIMEOUT="timeout 10"
+fi
+
+# run file flags, prints the output of the compiled program.
+run() {
+    $KISS "$1" $2 > "$work/a.c" 2>/dev/null || { echo "(kiss failed)"; return; }
+    $CC $CFLAGS -o "$work/a" "$work/a.c" 2>/dev/null || { echo "(cc failed)"; return; }
+    $TIMEOUT "$work/a" || echo "(exit $?)"
+}
+
+# failures so far, they are counted in a file since compare() runs in a subshell.
+nfailed() {
+    if [ -f "$work/failed" ]; then
+        wc -l < "$work/failed"
+    else
+        echo 0
+    fi
+}
+
+# compare file expected name, checks all sets of flags.
+compare() {
+    echo "$FLAGS" | while read -r flags; do
+        out=$(run "$1" "$flags")
+        if [ "$out" != "$2" ]; then
+            echo "$3: $flags differs"
+            echo "$out" | head -3
+            echo x >> "$work/failed"
+        fi
+    done
+}
+
+for src in "$dir"/samples/*.kiss; do
+    name=$(basename "$src" .kiss)
+    expected=$(cat "$dir/samples/$name.out")
+    out=$(run "$src" --ir)
+    if [ "$out" != "$expected" ]; then
+        echo "$name: --ir differs"
+        echo "$out" | head -3
+        echo x >> "$work/failed"
+    fi
+    compare "$src" "$expected" "$name"
+done
+
+end=$((seed + count))
+while [ "$seed" -lt "$end" ]; do
+    src="$work/p$seed.kiss"
+    python3 "$dir/gen.py" "$seed" > "$src"
+    before=$(nfailed)
+    expected=$(run "$src" --ir)
+    case "$expected" in
+    *"(kiss failed)"*|*"(cc failed)"*|*"(exit "*)
+        echo "seed $seed: --ir failed"
+        echo x >> "$work/failed"
+        ;;
+    *)
+        compare "$src" "$expected" "seed $seed"
+        ;;
+    esac
+    if [ "$(nfailed)" -eq "$before" ]; then
+        rm -f "$src"
+    fi
+    seed=$((seed + 1))
+done
+
+failed=$(nfailed)
+rm -f "$work/a" "$work/a.c" "$work/failed"
+echo "failures: $failed"
+if [ "$failed" -ne 0 ]; then
+    echo "failing programs are in $work"
+    exit 1
+fi
+rmdir "$work"
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+#
+# Generates a random kiss program which prints ints, for check.sh.
+# The same seed gives the same program, usage: gen.py [seed]
+#
+# A program has functions calling later ones, recursion of the kinds optimized by the passes,
+# a function never called, loops with local variables, nested scopes shadowing a name,
+# globals referred by functions, and top level flags which are constant.
+# Loop counters are never assigned in a body, and values are kept small, so a program ends
+# and does not overflow.
+import random
+import sys
+
+R = random.Random(int(sys.argv[1]) if len(sys.argv) > 1 else 1)
+
+
+class Gen:
+    def __init__(self, nfuncs):
+        self.nfuncs = nfuncs
+        self.argc = [R.randint(1, 3) for _ in range(nfuncs)]
+        self.count = 0
+
+    def name(self, prefix='v'):
+        self.count += 1
+        return '%s%d' % (prefix, self.count)
+
+    # fi is the index of the function being generated, None for the top level.
+    def expr(self, names, fi, depth=0):
+        r = R.random()
+        if depth > 2 or r < 0.3 or not names:
+            if names and R.random() < 0.7:
+                return R.choice(names)
+            return str(R.randint(1, 20))
+        if r < 0.45 and fi is not None and fi + 1 < self.nfuncs and depth < 2:
+            j = R.randint(fi + 1, self.nfuncs - 1)
+            return 'f%d(%s)' % (j, ', '.join(self.expr(names, fi, depth + 1) for _ in range(self.argc[j])))
+        op = R.choice(['+', '-', '*', '%', '/', '+', '-'])
+        a = self.expr(names, fi, depth + 1)
+        if op in '%/':
+            return '(%s) %s %d' % (a, op, R.randint(2, 9))
+        b = self.expr(names, fi, depth + 1)
+        if op == '*':
+            return '((%s) %% 100) * ((%s) %% 100)' % (a, b)
+        return '(%s) %s (%s)' % (a, op, b)
+
+    def cond(self, names, fi):
+        op = R.choice(['<', '<=', '>', '>=', '==', '!='])
+        return '%s %s %s' % (self.expr(names, fi, 2), op, self.expr(names, fi, 2))
+
+    # vars can be assigned, and counters of enclosing loops can only be read.
+    def stmts(self, vars, counters, fi, depth, n):
+        out = []
+        vars = list(vars)
+        for _ in range(n):
+            names = vars + counters
+            r = R.random()
+            if r < 0.25:
+                v = self.name()
+                out.append('var %s = %s;' % (v, self.expr(names, fi)))
+                vars.append(v)
+            elif r < 0.45 and vars:
+                v = R.choice(vars)
+                out.append('%s %s %s;' % (v, R.choice(['=', '+=', '-=']), self.expr(names, fi)))
+            elif r < 0.55:
+                out.append('var %s = %s;' % (self.name('d'), self.expr(names, fi)))
+            elif r < 0.7 and depth < 2:
+                c = self.name('i')
+                body = self.stmts(vars, counters + [c], fi, depth + 1, R.randint(1, 3))
+                if R.random() < 0.5:
+                    out.append('var %s = 0; while (%s < %d) { var %s = %s; %s %s += 1; }' % (
+                        c, c, R.randint(1, 4), self.name('k'), self.expr(names + [c], fi), body, c))
+                else:
+                    out.append('for (var %s = 0; %s < %d; %s += 1) { %s }' % (c, c, R.randint(1, 4), c, body))
+            elif r < 0.8 and depth < 2:
+                out.append('if (%s) { %s } else { %s }' % (
+                    self.cond(names, fi), self.stmts(vars, counters, fi, depth + 1, 2),
+                    self.stmts(vars, counters, fi, depth + 1, 2)))
+            elif r < 0.88 and depth < 2 and vars:
+                v = R.choice(vars)
+                out.append('{ var %s = %s; %s += 1; %s }' % (
+                    v, self.expr(names, fi), v, self.stmts(vars, counters, fi, depth + 1, 1)))
+            elif vars:
+                v = R.choice(vars)
+                out.append('%s = (%s) %% 1000;' % (v, v))
+        return ' '.join(out)
+
+    def program(self):
+        lines = []
+        for i in range(self.nfuncs):
+            args = ['a%d' % k for k in range(self.argc[i])]
+            body = self.stmts(args + ['g0'], [], i, 0, R.randint(2, 5))
+            lines.append('function f%d(%s) { %s return (%s) %% 100000; }' % (
+                i, ', '.join(args), body, self.expr(args + ['g0'], i)))
+        lines.append('function fib(n) { if (n < 2) return n; return fib(n - 1) + fib(n - 2); }')
+        lines.append('function acc(n, a) { if (n == 0) return a; return acc(n - 1, a + n); }')
+        lines.append('function ev(n) { if (n == 0) return 1; return od(n - 1); }')
+        lines.append('function od(n) { if (n == 0) return 0; return ev(n - 1); }')
+        lines.append('function unused%d(x) { return x; }' % R.randint(0, 9))
+        lines.append('var g0 = %d;' % R.randint(1, 9))
+        lines.append('var debug = %d;' % R.choice([0, 0, 1]))
+        lines.append('if (debug) { g0 += 1; } while (debug > 1) { debug -= 1; }')
+        lines.append(self.stmts(['g0'], [], None, 0, 3))
+        calls = ['f%d(%s)' % (i, ', '.join(str(R.randint(0, 9)) for _ in range(self.argc[i])))
+                 for i in range(self.nfuncs)]
+        calls += ['fib(%d)' % R.randint(5, 20), 'acc(%d, 0)' % R.randint(10, 3000),
+                  'ev(%d)' % R.randint(10, 3000), 'g0', 'debug']
+        for c in calls:
+            lines.append('_printf("%%lld\\n", %s);' % c)
+        return '\n'.join(lines) + '\n'
+
+
+print(Gen(R.randint(1, 5)).program(), end='')